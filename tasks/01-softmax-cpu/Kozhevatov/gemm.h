@@ -0,0 +1,190 @@
+/**
+ * @file gemm.h
+ * @brief CPU матричное умножение C = A×B над представлениями тензоров
+ *
+ * Эталонная схема та же, что и в run_openmp_reference из 03-matmul-cuda:
+ * параллелизм по строкам C и цикл i-k-j. Вместо std::vector матрицы задаются
+ * через TensorView, поэтому A, B и C могут быть подблоками больших буферов
+ * (leading dimension > числа столбцов) без копирования.
+ *
+ * Необязательный эпилог row_scale умножает строку i результата на
+ * row_scale[i] при записи из регистров: так нормализация Softmax, оставленная
+ * на потом (softmax_lazy.h), применяется к C [M, N] вместо A [M, K].
+ */
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "simd_vec.h"
+#include "tensor.h"
+
+// Метод вычисления GEMM
+enum class GemmMethod {
+  kSequential,  // скалярный i-k-j, один поток
+  kOpenMP,      // скалярный i-k-j, строки C распределены между потоками
+  kSimd,        // векторное микроядро 4×(2·W), один поток
+  kOpenMPSimd,  // векторное микроядро, блоки строк распределены между потоками
+};
+
+// Строк в регистровом блоке микроядра; столбцов - два вектора Vec
+constexpr std::size_t kGemmMr = 4;
+
+// Скалярная строка C[i, :] = A[i, :] × B для произвольных шагов
+inline void GemmRowScalar(const TensorView<const float>& a,
+                          const TensorView<const float>& b,
+                          const TensorView<float>& c, std::size_t i,
+                          std::size_t j_begin,
+                          const float* row_scale = nullptr) {
+  const std::size_t k_dim = a.shape.dims[1];
+  const std::size_t n_dim = b.shape.dims[1];
+  const std::size_t a_rs = a.shape.strides[0], a_cs = a.shape.strides[1];
+  const std::size_t b_rs = b.shape.strides[0], b_cs = b.shape.strides[1];
+  const std::size_t c_rs = c.shape.strides[0], c_cs = c.shape.strides[1];
+  float* row = c.data + i * c_rs;
+
+  for (std::size_t j = j_begin; j < n_dim; ++j) row[j * c_cs] = 0.0f;
+  for (std::size_t k = 0; k < k_dim; ++k) {
+    const float a_ik = a.data[i * a_rs + k * a_cs];
+    const float* b_row = b.data + k * b_rs;
+#pragma omp simd
+    for (std::size_t j = j_begin; j < n_dim; ++j) {
+      row[j * c_cs] += a_ik * b_row[j * b_cs];
+    }
+  }
+  if (row_scale != nullptr) {
+    const float scale = row_scale[i];
+    for (std::size_t j = j_begin; j < n_dim; ++j) row[j * c_cs] *= scale;
+  }
+}
+
+/**
+ * @brief Микроядро над Vec<float, W>: блок C[i..i+4, j..j+2W] в 8
+ * регистрах-аккумуляторах
+ *
+ * Один исходник для всех ширин: 4×8 на SSE, 4×16 на AVX2, 4×32 на AVX-512.
+ * Требует непрерывных строк B и C (шаг столбца 1); строки A читаются по
+ * шагам, так как из A берётся один скаляр на итерацию k.
+ */
+template <std::size_t W>
+inline void GemmMicroKernel(const TensorView<const float>& a,
+                            const TensorView<const float>& b,
+                            const TensorView<float>& c, std::size_t i,
+                            std::size_t j, const float* row_scale = nullptr) {
+  using V = Vec<float, W>;
+  const std::size_t k_dim = a.shape.dims[1];
+  const std::size_t a_rs = a.shape.strides[0], a_cs = a.shape.strides[1];
+  const std::size_t b_rs = b.shape.strides[0];
+  const std::size_t c_rs = c.shape.strides[0];
+
+  V acc[kGemmMr][2];
+  for (std::size_t r = 0; r < kGemmMr; ++r) {
+    acc[r][0] = V::zero();
+    acc[r][1] = V::zero();
+  }
+
+  for (std::size_t k = 0; k < k_dim; ++k) {
+    const float* b_row = b.data + k * b_rs + j;
+    const V b0 = V::load(b_row);
+    const V b1 = V::load(b_row + W);
+    for (std::size_t r = 0; r < kGemmMr; ++r) {
+      const V a_rk = V::broadcast(a.data[(i + r) * a_rs + k * a_cs]);
+      acc[r][0] = vfmadd(a_rk, b0, acc[r][0]);
+      acc[r][1] = vfmadd(a_rk, b1, acc[r][1]);
+    }
+  }
+
+  if (row_scale != nullptr) {
+    for (std::size_t r = 0; r < kGemmMr; ++r) {
+      const V scale = V::broadcast(row_scale[i + r]);
+      acc[r][0] = acc[r][0] * scale;
+      acc[r][1] = acc[r][1] * scale;
+    }
+  }
+  for (std::size_t r = 0; r < kGemmMr; ++r) {
+    float* c_row = c.data + (i + r) * c_rs + j;
+    acc[r][0].store(c_row);
+    acc[r][1].store(c_row + W);
+  }
+}
+
+/**
+ * @brief C = A×B для матриц A [M, K], B [K, N], C [M, N]
+ *
+ * Быстрый путь (микроядро GemmMicroKernel<W>) используется, когда строки B
+ * и C непрерывны; края, не кратные блоку 4×(2·W), и произвольные шаги
+ * считаются скалярно. gemm - вариант на родной ширине kVecLanes, gemm_vec
+ * позволяет выбрать ширину явно (для сравнения ISA в одной сборке).
+ *
+ * @param row_scale Эпилог: множитель строки i результата (M значений) или
+ * nullptr
+ */
+template <std::size_t W>
+inline void gemm_vec(TensorView<const float> a, TensorView<const float> b,
+                     TensorView<float> c, GemmMethod method,
+                     const float* row_scale = nullptr) {
+  constexpr std::size_t kGemmNr = 2 * W;
+  if (a.rank() != 2 || b.rank() != 2 || c.rank() != 2) {
+    throw std::invalid_argument("GEMM expects 2-D views");
+  }
+  const std::size_t m_dim = a.shape.dims[0];
+  const std::size_t k_dim = a.shape.dims[1];
+  const std::size_t n_dim = b.shape.dims[1];
+  if (b.shape.dims[0] != k_dim || c.shape.dims[0] != m_dim ||
+      c.shape.dims[1] != n_dim) {
+    throw std::invalid_argument("GEMM operand shapes do not match");
+  }
+
+  const bool parallel =
+      method == GemmMethod::kOpenMP || method == GemmMethod::kOpenMPSimd;
+  const bool simd = (method == GemmMethod::kSimd ||
+                     method == GemmMethod::kOpenMPSimd) &&
+                    b.shape.last_axis_contiguous() &&
+                    c.shape.last_axis_contiguous();
+  const std::size_t block_rows = simd ? kGemmMr : 1;
+  const std::size_t blocks = m_dim / block_rows;
+  const std::size_t n_blocked = simd ? n_dim / kGemmNr * kGemmNr : 0;
+
+#pragma omp parallel for schedule(static) if (parallel)
+  for (std::size_t block = 0; block < blocks; ++block) {
+    const std::size_t i = block * block_rows;
+    for (std::size_t j = 0; j < n_blocked; j += kGemmNr) {
+      GemmMicroKernel<W>(a, b, c, i, j, row_scale);
+    }
+    if (n_blocked < n_dim) {
+      for (std::size_t r = 0; r < block_rows; ++r) {
+        GemmRowScalar(a, b, c, i + r, n_blocked, row_scale);
+      }
+    }
+  }
+
+  // Строки, не вошедшие в блоки по kGemmMr
+  for (std::size_t i = blocks * block_rows; i < m_dim; ++i) {
+    GemmRowScalar(a, b, c, i, 0, row_scale);
+  }
+}
+
+inline void gemm(TensorView<const float> a, TensorView<const float> b,
+                 TensorView<float> c, GemmMethod method,
+                 const float* row_scale = nullptr) {
+  gemm_vec<kVecLanes>(a, b, c, method, row_scale);
+}
+
+// Вариант для плотных матриц в std::vector: A [m, k], B [k, n] -> C [m, n]
+inline std::vector<float> gemm(const std::vector<float>& a,
+                               const std::vector<float>& b, std::size_t m,
+                               std::size_t k, std::size_t n,
+                               GemmMethod method) {
+  std::vector<float> c(m * n);
+  gemm(make_view(a, TensorShape({m, k})), make_view(b, TensorShape({k, n})),
+       make_view(c, TensorShape({m, n})), method);
+  return c;
+}
+
+#endif  // !GEMM_H
@@ -18,19 +18,45 @@
  * ./softmax_cpu 1024           # Тест с матрицей 1024x1024
  * ./softmax_cpu --test         # Запуск тестов корректности
  * ./softmax_cpu --debug 8      # Отладка с матрицей 8x8
+ * ./softmax_cpu --denormals 2048  # Замер FTZ/DAZ на широких логитах
+ * ./softmax_cpu --shape 8 16 128 128  # Тензор [B, H, S, S], Softmax по S
+ * ./softmax_cpu --axis 1 8 64 56 56  # NCHW, Softmax по каналам
+ * ./softmax_cpu --attention 8 12 128  # Батч внимания [B, H, S, S]
+ * ./softmax_cpu --masked 2048  # Causal/окно/длина против -inf
+ * ./softmax_cpu --prologue 8 12 512  # Масштаб+bias+ALiBi+T в одном проходе
+ * ./softmax_cpu --loss 64 262144  # Cross-entropy: отдельные проходы/слияние
+ * ./softmax_cpu --backward 2048  # Обратный проход против эталона в double
+ * ./softmax_cpu --half 4096    # fp16/bf16 хранение против float
+ * ./softmax_cpu --quantized 4096  # int8/int32 логиты, точность и время
+ * ./softmax_cpu --sample 64 131072 50  # top-k и сэмплирование без Softmax
+ * ./softmax_cpu --lazy 2048    # P×V: нормализация в эпилоге GEMM
+ * ./softmax_cpu --decode 8192  # Пошаговый рост строки: состояние Softmax
+ * ./softmax_cpu --segments 100000  # CSR сегменты разной длины
+ * ./softmax_cpu --hsoftmax 524288 64  # Двухуровневый Softmax по словарю
+ * ./softmax_cpu --sparse 4096  # Sparsemax/entmax-1.5 против Softmax
+ * ./softmax_cpu --dropout 4096  # Softmax + dropout без маски в памяти
+ * ./softmax_cpu --norm 4096     # LayerNorm/RMSNorm на каркасе Softmax
+ * ./softmax_cpu --fixed         # Ядра для длин 64..4096 против общего
+ * ./softmax_cpu --vec           # Vec<float, W> на SSE/AVX2/AVX-512
+ * ./softmax_cpu --pairwise 4194304  # Точность суммы на длинной строке
+ * ./softmax_cpu --reproducible 4194304  # Редукции без зависимости от потоков
+ * ./softmax_cpu --health 4096  # Флаги NaN/Inf/опустошения строк
+ * ./softmax_cpu --summary 2048  # Сводка тензора вместо печати элементов
  * @endcode
  */
 
-#include <immintrin.h>  // AVX инструкции (Intel Intrinsics)
 #include <omp.h>        // OpenMP для параллелизации
 
 #include <algorithm>  // Для std::max, std::min
+#include <array>      // std::array (контрольные значения)
 #include <chrono>  // Для измерения времени: high_resolution_clock
 #include <cmath>       // Математические функции: exp, abs
 #include <cstdlib>     // Для EXIT_SUCCESS, EXIT_FAILURE
+#include <cstring>     // std::memcpy
 #include <functional>  // Для std::function (коллбэки)
 #include <iomanip>  // Для форматирования вывода: setprecision, fixed
 #include <iostream>  // Основной ввод-вывод: cout, cerr
+#include <limits>    // std::numeric_limits (порог побитового сравнения)
 #include <random>  // Генерация случайных чисел: mt19937, uniform_real_distribution
 #include <sstream>  // Для форматирования строк: ostringstream
 #include <stdexcept>  // Исключения: runtime_error, invalid_argument
@@ -38,198 +64,89 @@
 #include <string_view>  // std::string_view (легковесная замена const char*)
 #include <vector>  // Динамический массив std::vector
 
+#include "gemm.h"
+#include "normalization.h"
+#include "philox.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_backward.h"
+#include "softmax_dropout.h"
+#include "softmax_half.h"
+#include "softmax_health.h"
+#include "softmax_hierarchical.h"
+#include "softmax_attention.h"
+#include "softmax_axis.h"
+#include "softmax_kernels.h"
+#include "softmax_lazy.h"
+#include "softmax_loss.h"
+#include "softmax_masked.h"
+#include "softmax_prologue.h"
+#include "softmax_quantized.h"
+#include "softmax_sampling.h"
+#include "softmax_segmented.h"
+#include "softmax_sparse.h"
+#include "softmax_state.h"
+#include "tensor.h"
+#include "tensor_summary.h"
+
 namespace {
-// Быстрая векторная экспонента для AVX (аппроксимация полиномом)
-// Основана на алгоритме из библиотеки "sse_mathfun.h" (Julien Pommier)
-// https://github.com/RJVB/sse_mathfun/blob/master/sse_mathfun.h
-
-static inline __m256 exp256_ps(__m256 x) {
-  __m256 exp_hi = _mm256_set1_ps(88.3762626647949f);
-  __m256 exp_lo = _mm256_set1_ps(-88.3762626647949f);
-  __m256 cephes_LOG2EF = _mm256_set1_ps(1.44269504088896341);
-  __m256 cephes_exp_C1 = _mm256_set1_ps(0.693359375);
-  __m256 cephes_exp_C2 = _mm256_set1_ps(-2.12194440e-4);
-  __m256 cephes_exp_p0 = _mm256_set1_ps(1.9875691500E-4);
-  __m256 cephes_exp_p1 = _mm256_set1_ps(1.3981999507E-3);
-  __m256 cephes_exp_p2 = _mm256_set1_ps(8.3334519073E-3);
-  __m256 cephes_exp_p3 = _mm256_set1_ps(4.1665795894E-2);
-  __m256 cephes_exp_p4 = _mm256_set1_ps(1.6666665459E-1);
-  __m256 cephes_exp_p5 = _mm256_set1_ps(5.0000001201E-1);
-  __m256 tmp = _mm256_setzero_ps(), fx;
-  __m256i imm0;
-  __m256 one = _mm256_set1_ps(1.0f);
-
-  x = _mm256_min_ps(x, exp_hi);
-  x = _mm256_max_ps(x, exp_lo);
-
-  fx = _mm256_mul_ps(x, cephes_LOG2EF);
-  fx = _mm256_add_ps(fx, _mm256_set1_ps(0.5f));
-  tmp = _mm256_floor_ps(fx);
-  __m256 mask = _mm256_cmp_ps(tmp, fx, _CMP_GT_OS);
-  mask = _mm256_and_ps(mask, one);
-  fx = _mm256_sub_ps(tmp, mask);
-  tmp = _mm256_mul_ps(fx, cephes_exp_C1);
-  __m256 z = _mm256_mul_ps(fx, cephes_exp_C2);
-  x = _mm256_sub_ps(x, tmp);
-  x = _mm256_sub_ps(x, z);
-  z = _mm256_mul_ps(x, x);
-
-  __m256 y = cephes_exp_p0;
-  y = _mm256_mul_ps(y, x);
-  y = _mm256_add_ps(y, cephes_exp_p1);
-  y = _mm256_mul_ps(y, x);
-  y = _mm256_add_ps(y, cephes_exp_p2);
-  y = _mm256_mul_ps(y, x);
-  y = _mm256_add_ps(y, cephes_exp_p3);
-  y = _mm256_mul_ps(y, x);
-  y = _mm256_add_ps(y, cephes_exp_p4);
-  y = _mm256_mul_ps(y, x);
-  y = _mm256_add_ps(y, cephes_exp_p5);
-  y = _mm256_mul_ps(y, z);
-  y = _mm256_add_ps(y, x);
-  y = _mm256_add_ps(y, one);
-
-  imm0 = _mm256_cvttps_epi32(fx);
-  imm0 = _mm256_add_epi32(imm0, _mm256_set1_epi32(0x7f));
-  imm0 = _mm256_slli_epi32(imm0, 23);
-  __m256 pow2n = _mm256_castsi256_ps(imm0);
-  y = _mm256_mul_ps(y, pow2n);
-  return y;
-}
+// Распределение значений тестовой матрицы
+enum class InputDistribution {
+  kUniform,    // [0, 1): все экспоненты нормализованные, денормалов нет
+  kWideRange,  // [-120, 0]: логиты после сдвига на максимум строки,
+               // разброс в сотню единиц даёт денормалы около клампа -88
+};
 
-// Генерация тестовой матрицы
-std::vector<float> make_matrix(std::size_t n) {
-  std::vector<float> matrix(n * n);
+// Генерация тестовых данных из count элементов
+std::vector<float> make_values(
+    std::size_t count,
+    InputDistribution distribution = InputDistribution::kUniform) {
+  std::vector<float> values(count);
   std::mt19937 gen(15);  // Фиксированный seed для воспроизводимости
-  std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+  const bool wide = distribution == InputDistribution::kWideRange;
+  std::uniform_real_distribution<float> dist(wide ? -120.0f : 0.0f,
+                                             wide ? 0.0f : 1.0f);
 
-  for (auto& x : matrix) {
+  for (auto& x : values) {
     x = dist(gen);
   }
-  return matrix;
-}
-
-// Softmax для одной строки (скалярная версия)
-void SoftmaxRow(const float* row_begin, float* row_result, std::size_t n) {
-  float sum_exp = 0.0f;
-  for (std::size_t j = 0; j < n; ++j) {
-    sum_exp += std::exp(row_begin[j]);
-  }
-
-  // Защита от деления на ноль (хотя маловероятно при exp(x) > 0)
-  if (sum_exp == 0.0f) {
-    std::fill(row_result, row_result + n, 1.0f / n);
-    return;
-  }
-
-  float div_sum_exp = 1.0f / sum_exp;
-  for (std::size_t j = 0; j < n; ++j) {
-    row_result[j] = std::exp(row_begin[j]) * div_sum_exp;
-  }
-}
-
-// Сумма 8 float в векторе AVX
-static inline float hsum256_ps(__m256 v) {
-  __m128 lo = _mm256_castps256_ps128(v);
-  __m128 hi = _mm256_extractf128_ps(v, 1);
-  __m128 sum128 = _mm_add_ps(lo, hi);
-  sum128 = _mm_hadd_ps(sum128, sum128);
-  sum128 = _mm_hadd_ps(sum128, sum128);
-  return _mm_cvtss_f32(sum128);
+  return values;
 }
 
-// Вспомогательные функции для работы с AVX
-static inline void storeu256_ps(float* dst, __m256 v) {
-  _mm256_storeu_ps(dst, v);
-}
-static inline __m256 loadu256_ps(const float* src) {
-  return _mm256_loadu_ps(src);
+// Генерация тестовой матрицы
+std::vector<float> make_matrix(
+    std::size_t n,
+    InputDistribution distribution = InputDistribution::kUniform) {
+  return make_values(n * n, distribution);
 }
 
-// Softmax для одной строки (векторизованная версия)
-// УСЛОВИЕ ЦИКЛА ПРАВИЛЬНОЕ: i + 7 < n эквивалентно i < n - 7
-// При n = 8: i=0 -> 0+7<8=true, i=8 -> 8+7<8=false → обработаны 8 элементов
-void SoftmaxRowSimd(const float* row_begin, float* row_result, std::size_t n) {
-  if (n == 0) return;
-
-  std::size_t i = 0;
-  float sum_exp = 0.0f;
-
-  // Первый проход: вычисляем экспоненты и их сумму
-  for (; i + 7 < n; i += 8) {
-    __m256 v = loadu256_ps(row_begin + i);
-    __m256 e = exp256_ps(v);
-    storeu256_ps(row_result + i, e);
-    sum_exp += hsum256_ps(e);
-  }
-
-  // Обработка хвоста (оставшиеся элементы)
-  for (; i < n; ++i) {
-    float s = std::exp(row_begin[i]);
-    row_result[i] = s;
-    sum_exp += s;
-  }
-
-  // Защита от деления на ноль
-  if (sum_exp == 0.0f) {
-    float val = 1.0f / n;
-    std::fill(row_result, row_result + n, val);
-    return;
-  }
-
-  // Второй проход: нормализация
-  float inv_sum = 1.0f / sum_exp;
-  __m256 inv_vec = _mm256_set1_ps(inv_sum);
-  i = 0;
-
-  // Векторизованная нормализация
-  for (; i + 7 < n; i += 8) {
-    __m256 e = loadu256_ps(row_result + i);
-    __m256 r = _mm256_mul_ps(e, inv_vec);
-    storeu256_ps(row_result + i, r);
-  }
-
-  // Нормализация хвоста
-  for (; i < n; ++i) {
-    row_result[i] *= inv_sum;
-  }
+// Реализации для разных методов
+std::vector<float> run_method(const std::vector<float>& matrix, std::size_t n,
+                              SoftmaxMethod method,
+                              DenormalMode mode = DenormalMode::kPreserve) {
+  std::vector<float> result(n * n);
+  softmax_rows(matrix.data(), n, result.data(), n, n, n, method, mode);
+  return result;
 }
 
-// Реализации для разных методов
 std::vector<float> run_sequential(const std::vector<float>& matrix,
                                   std::size_t n) {
-  std::vector<float> result(n * n);
-  for (std::size_t i = 0; i < n; ++i) {
-    SoftmaxRow(&matrix[i * n], &result[i * n], n);
-  }
-  return result;
+  return run_method(matrix, n, SoftmaxMethod::kSequential);
 }
 
 std::vector<float> run_openmp(const std::vector<float>& matrix, std::size_t n) {
-  std::vector<float> result(n * n);
-#pragma omp parallel for
-  for (std::size_t i = 0; i < n; ++i) {
-    SoftmaxRow(&matrix[i * n], &result[i * n], n);
-  }
-  return result;
+  return run_method(matrix, n, SoftmaxMethod::kOpenMP);
 }
 
-std::vector<float> run_simd(const std::vector<float>& matrix, std::size_t n) {
-  std::vector<float> result(n * n);
-  for (std::size_t i = 0; i < n; ++i) {
-    SoftmaxRowSimd(&matrix[i * n], &result[i * n], n);
-  }
-  return result;
+std::vector<float> run_simd(const std::vector<float>& matrix, std::size_t n,
+                            DenormalMode mode = DenormalMode::kPreserve) {
+  return run_method(matrix, n, SoftmaxMethod::kSimd, mode);
 }
 
-std::vector<float> run_openmp_simd(const std::vector<float>& matrix,
-                                   std::size_t n) {
-  std::vector<float> result(n * n);
-#pragma omp parallel for
-  for (std::size_t i = 0; i < n; ++i) {
-    SoftmaxRowSimd(&matrix[i * n], &result[i * n], n);
-  }
-  return result;
+std::vector<float> run_openmp_simd(
+    const std::vector<float>& matrix, std::size_t n,
+    DenormalMode mode = DenormalMode::kPreserve) {
+  return run_method(matrix, n, SoftmaxMethod::kOpenMPSimd, mode);
 }
 
 // Измерение времени выполнения
@@ -241,6 +158,18 @@ double measure_seconds(const std::function<std::vector<float>()>& work,
   return std::chrono::duration<double>(stop - start).count();
 }
 
+// Лучшее время из repeats запусков (первый запуск - прогрев и не считается)
+double measure_best_seconds(const std::function<std::vector<float>()>& work,
+                            std::vector<float>& result_store,
+                            int repeats = 3) {
+  result_store = work();
+  double best = measure_seconds(work, result_store);
+  for (int i = 1; i < repeats; ++i) {
+    best = std::min(best, measure_seconds(work, result_store));
+  }
+  return best;
+}
+
 // Проверка корректности: максимальная разница
 float max_abs_diff(const std::vector<float>& baseline,
                    const std::vector<float>& candidate) {
@@ -264,9 +193,9 @@ struct RunResult {
 };
 
 // Форматирование вывода
-std::string format_time(double seconds) {
+std::string format_time(double seconds, int precision = 2) {
   std::ostringstream oss;
-  oss << std::fixed << std::setprecision(2) << seconds;
+  oss << std::fixed << std::setprecision(precision) << seconds;
   return oss.str();
 }
 std::string format_diff(float diff) {
@@ -299,7 +228,7 @@ RunResult run_test_case(const std::function<std::vector<float>()>& runner,
 }
 
 // Тестирование корректности SIMD реализации для различных размеров
-void test_simd_correctness() {
+bool test_simd_correctness() {
   std::cout << "\n=== Тестирование корректности SIMD реализации ===\n";
   std::cout
       << "Проверяем граничные случаи (размеры, кратные 8 и некратные):\n\n";
@@ -354,101 +283,3953 @@ void test_simd_correctness() {
     }
   }
 
-  if (all_tests_passed) {
-    std::cout << "\n✅ ВСЕ ТЕСТЫ ПРОЙДЕНЫ! SIMD реализация корректна.\n";
-  } else {
-    std::cout << "\n❌ ЕСТЬ ПРОБЛЕМЫ! Требуется отладка SIMD реализации.\n";
+  return all_tests_passed;
+}
+
+// FTZ/DAZ не должен "утекать" за пределы ядра
+bool test_denormal_mode() {
+  const unsigned int csr_before = _mm_getcsr();
+  auto matrix = make_matrix(64, InputDistribution::kWideRange);
+  run_simd(matrix, 64, DenormalMode::kFlushToZero);
+  run_openmp_simd(matrix, 64, DenormalMode::kFlushToZero);
+  const bool restored = _mm_getcsr() == csr_before;
+  std::cout << "\nMXCSR после FTZ/DAZ: "
+            << (restored ? "✅ восстановлен" : "❌ НЕ восстановлен") << "\n";
+  return restored;
+}
+
+// Эталон для тензорных тестов: скалярный Softmax каждой строки
+std::vector<float> reference_last_axis(const std::vector<float>& input,
+                                       std::size_t rows, std::size_t cols,
+                                       std::size_t row_stride) {
+  std::vector<float> expected(rows * cols);
+  for (std::size_t r = 0; r < rows; ++r) {
+    SoftmaxRow(&input[r * row_stride], &expected[r * cols], cols);
   }
+  return expected;
 }
 
-// Проверка конкретного размера матрицы (для отладки)
-void debug_single_test(std::size_t n) {
-  std::cout << "\n=== Отладочная информация для n = " << n << " ===\n";
-  std::cout << "Количество элементов в строке: " << n << "\n";
-  std::cout << "Векторных итераций (по 8 элементов): " << (n + 7) / 8 << "\n";
-  std::cout << "Остаточных элементов (хвост): " << n % 8 << "\n\n";
+// Softmax по последней оси для тензоров разной размерности и с шагами строк
+bool test_tensor_shapes() {
+  std::cout << "\n=== Softmax по последней оси N-мерного тензора ===\n";
 
-  // Создаем матрицу
-  auto matrix = make_matrix(n);
+  const std::vector<std::vector<std::size_t>> shapes = {
+      {7}, {3, 5}, {1, 129}, {5, 1}, {2, 3, 17}, {2, 2, 4, 9}, {2, 4, 33, 8}};
 
-  // Обрабатываем первую строку с отладочным выводом
-  std::vector<float> scalar_result(n);
-  std::vector<float> simd_result(n);
+  bool all_passed = true;
+  for (const auto& dims : shapes) {
+    const TensorShape shape(dims);
+    const auto input = make_values(shape.numel());
+    const auto expected =
+        reference_last_axis(input, shape.rows(), shape.last_dim(),
+                            shape.last_dim());
 
-  SoftmaxRow(&matrix[0], &scalar_result[0], n);
-  SoftmaxRowSimd(&matrix[0], &simd_result[0], n);
+    float max_diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      max_diff = std::max(
+          max_diff,
+          max_abs_diff(expected, softmax_last_axis(input, shape, method)));
+    }
 
-  std::cout << "Первая строка матрицы (первые 10 элементов):\n";
-  for (std::size_t j = 0; j < std::min(n, static_cast<std::size_t>(10)); ++j) {
-    std::cout << "  Элемент " << j << ": input=" << std::setprecision(4)
-              << matrix[j] << ", scalar=" << scalar_result[j]
-              << ", SIMD=" << simd_result[j]
-              << ", diff=" << std::abs(scalar_result[j] - simd_result[j])
-              << "\n";
+    std::cout << "[";
+    for (std::size_t i = 0; i < dims.size(); ++i) {
+      std::cout << (i ? ", " : "") << dims[i];
+    }
+    std::cout << "]: ";
+    const bool ok = max_diff < 1e-5f;
+    std::cout << (ok ? "✅ ОК" : "❌ ПРОБЛЕМА") << " (diff = "
+              << std::scientific << max_diff << std::defaultfloat << ")\n";
+    all_passed = all_passed && ok;
   }
 
-  // Проверяем суммы
-  float sum_scalar = 0.0f, sum_simd = 0.0f;
-  for (std::size_t j = 0; j < n; ++j) {
-    sum_scalar += scalar_result[j];
-    sum_simd += simd_result[j];
+  // Строки с выравниванием: 6×19 внутри буфера с шагом 24, без копии
+  {
+    const std::size_t rows = 6, cols = 19, ld = 24;
+    const auto padded = make_values(rows * ld);
+    const TensorShape shape({2, 3, cols}, {3 * ld, ld, 1});
+    const auto expected = reference_last_axis(padded, rows, cols, ld);
+    const float diff = max_abs_diff(
+        expected, softmax_last_axis(padded, shape, SoftmaxMethod::kOpenMPSimd));
+    const bool ok = diff < 1e-5f;
+    std::cout << "[2, 3, 19] с шагом строки 24: "
+              << (ok ? "✅ ОК" : "❌ ПРОБЛЕМА") << " (diff = "
+              << std::scientific << diff << std::defaultfloat << ")\n";
+    all_passed = all_passed && ok;
   }
 
-  std::cout << "\nСумма скалярного результата: " << sum_scalar << "\n";
-  std::cout << "Сумма SIMD результата: " << sum_simd << "\n";
-  std::cout << "Разница сумм: " << std::abs(sum_scalar - sum_simd) << "\n";
+  return all_passed;
 }
-}  // namespace
 
-int main(int argc, char* argv[]) {
-  // Если запуск с флагом --test, выполняем тестирование
-  if (argc == 2 && std::string(argv[1]) == "--test") {
-    test_simd_correctness();
-    return EXIT_SUCCESS;
+// Печать строки отчёта теста с разницей против эталона
+bool report_check(std::string_view name, float diff, float tolerance = 1e-5f) {
+  const bool ok = diff < tolerance;
+  std::cout << name << ": " << (ok ? "✅ ОК" : "❌ ПРОБЛЕМА") << " (diff = "
+            << std::scientific << diff << std::defaultfloat << ")\n";
+  return ok;
+}
+
+// Ядра на представлениях: подблоки, переставленные оси, GEMM без копий
+bool test_tensor_views() {
+  std::cout << "\n=== Невладеющие представления тензоров ===\n";
+  bool all_passed = true;
+
+  // Подблок [:, :, 3:11, 2:13] буфера внимания [2, 4, 16, 16]; результат
+  // пишется в подблок другого буфера того же размера
+  {
+    auto scores = make_values(2 * 4 * 16 * 16);
+    std::vector<float> probs(scores.size(), -1.0f);
+    const TensorShape full({2, 4, 16, 16});
+    const auto in = make_view(scores, full).slice(2, 3, 11).slice(3, 2, 13);
+    const auto out = make_view(probs, full).slice(2, 3, 11).slice(3, 2, 13);
+
+    std::vector<float> block;
+    for (std::size_t r = 0; r < in.shape.rows(); ++r) {
+      const float* row = in.data + in.shape.offset_of(r, 3);
+      block.insert(block.end(), row, row + 11);
+    }
+    const auto expected =
+        reference_last_axis(block, block.size() / 11, 11, 11);
+
+    float diff = 0.0f;
+    for (auto method :
+         {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMPSimd}) {
+      softmax_last_axis(in, out, method);
+      std::vector<float> got;
+      for (std::size_t r = 0; r < out.shape.rows(); ++r) {
+        const float* row = out.data + out.shape.offset_of(r, 3);
+        got.insert(got.end(), row, row + 11);
+      }
+      diff = std::max(diff, max_abs_diff(expected, got));
+    }
+    // Элементы вне подблока не должны меняться
+    const std::size_t untouched = static_cast<std::size_t>(
+        std::count(probs.begin(), probs.end(), -1.0f));
+    if (untouched != probs.size() - expected.size()) diff = 1.0f;
+    all_passed = report_check("Подблок [2, 4, 8, 11] буфера внимания", diff) &&
+                 all_passed;
   }
 
-  // Если запуск с флагом --debug N, выполняем отладку для конкретного размера
-  if (argc == 3 && std::string(argv[1]) == "--debug") {
-    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
-    debug_single_test(n);
-    return EXIT_SUCCESS;
+  // Переставленные ведущие оси и шаг последней оси != 1 (транспонирование
+  // матрицы как представление)
+  {
+    const auto values = make_values(4 * 3 * 8);
+    const TensorShape permuted({4, 3, 8}, {8, 32, 1});
+    std::vector<float> rows;
+    for (std::size_t r = 0; r < 12; ++r) {
+      const std::size_t offset = permuted.offset_of(r, 2);
+      rows.insert(rows.end(), values.begin() + offset,
+                  values.begin() + offset + 8);
+    }
+    all_passed =
+        report_check("Переставленные оси [4, 3, 8]",
+                     max_abs_diff(reference_last_axis(rows, 12, 8, 8),
+                                  softmax_last_axis(values, permuted,
+                                                    SoftmaxMethod::kSimd))) &&
+        all_passed;
+
+    const TensorShape transposed({8, 12}, {1, 8});
+    std::vector<float> columns;
+    for (std::size_t r = 0; r < 8; ++r) {
+      for (std::size_t j = 0; j < 12; ++j) columns.push_back(values[j * 8 + r]);
+    }
+    all_passed =
+        report_check("Транспонированная матрица [8, 12]",
+                     max_abs_diff(reference_last_axis(columns, 8, 12, 12),
+                                  softmax_last_axis(values, transposed,
+                                                    SoftmaxMethod::kOpenMP))) &&
+        all_passed;
   }
 
-  // Обычный режим работы
-  try {
-    if (argc != 2) {
-      std::cerr << "Usage: " << argv[0] << " <matrix_size_n>\n";
-      std::cerr << "       " << argv[0] << " --test     (запуск всех тестов)\n";
-      std::cerr << "       " << argv[0]
-                << " --debug N  (отладка для размера N)\n";
-      return EXIT_FAILURE;
+  // Softmax по оси 1 среза [1:3] по оси 0 тензора [4, 20, 24]
+  {
+    const auto values = make_values(4 * 20 * 24);
+    const auto view =
+        make_view(values, TensorShape({4, 20, 24})).slice(0, 1, 3);
+    const std::vector<float> sliced(view.data, view.data + view.numel());
+    std::vector<float> result(view.numel());
+    softmax_axis(view, make_view(result, TensorShape({2, 20, 24})), 1,
+                 SoftmaxMethod::kOpenMPSimd);
+    all_passed =
+        report_check("Softmax по оси 1 среза [1:3, :, :]",
+                     max_abs_diff(softmax_axis(sliced, TensorShape({2, 20, 24}),
+                                               1, SoftmaxMethod::kSequential),
+                                  result)) &&
+        all_passed;
+  }
+
+  // GEMM на подблоках: A = X[1:38, 2:27], B = Y[0:25, 3:40], C = Z[2:39, 1:38]
+  {
+    const std::size_t ld = 48, m = 37, k = 25, n = 37;
+    const auto x = make_values(48 * ld);
+    auto y = make_values(48 * ld);
+    for (auto& v : y) v -= 0.5f;
+    const TensorShape full({48, ld});
+    const auto a = make_view(x, full).slice(0, 1, 1 + m).slice(1, 2, 2 + k);
+    const auto b = make_view(y, full).slice(0, 0, k).slice(1, 3, 3 + n);
+
+    std::vector<double> expected(m * n, 0.0);
+    for (std::size_t i = 0; i < m; ++i) {
+      for (std::size_t kk = 0; kk < k; ++kk) {
+        for (std::size_t j = 0; j < n; ++j) {
+          expected[i * n + j] += static_cast<double>(a.data[i * ld + kk]) *
+                                 b.data[kk * ld + j];
+        }
+      }
     }
 
-    const std::size_t n = static_cast<std::size_t>(std::stoul(argv[1]));
-    if (n == 0) {
-      throw std::invalid_argument("Matrix size must be positive");
+    for (auto method : {GemmMethod::kSequential, GemmMethod::kOpenMP,
+                        GemmMethod::kSimd, GemmMethod::kOpenMPSimd}) {
+      std::vector<float> z(48 * ld, 0.0f);
+      const auto c = make_view(z, full).slice(0, 2, 2 + m).slice(1, 1, 1 + n);
+      gemm(a, b, c, method);
+      float diff = 0.0f;
+      for (std::size_t i = 0; i < m; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+          diff = std::max(diff, static_cast<float>(std::abs(
+                                    c.data[i * ld + j] - expected[i * n + j])));
+        }
+      }
+      const std::string name = "GEMM на подблоках, метод " +
+                               std::to_string(static_cast<int>(method));
+      all_passed = report_check(name, diff) && all_passed;
     }
+  }
 
-    const auto input = make_matrix(n);
+  return all_passed;
+}
 
-    // Базовая последовательная версия
-    std::vector<float> sequential_result;
-    const double sequential_seconds = measure_seconds(
-        [&]() { return run_sequential(input, n); }, sequential_result);
+// Softmax вдоль не последней оси против эталона через явную выборку столбца
+bool test_softmax_axis() {
+  std::cout << "\n=== Softmax вдоль произвольной оси (без транспонирования) "
+               "===\n";
 
-    // Тестируем оптимизированные версии
-    auto omp_res = run_test_case([&] { return run_openmp(input, n); },
-                                 sequential_result, "OpenMP");
-    auto simd_res = run_test_case([&] { return run_simd(input, n); },
-                                  sequential_result, "SIMD");
-    auto omp_simd_res = run_test_case([&] { return run_openmp_simd(input, n); },
-                                      sequential_result, "OpenMP + SIMD");
+  struct AxisCase {
+    std::vector<std::size_t> dims;
+    std::size_t axis;
+  };
+  const std::vector<AxisCase> cases = {
+      {{5, 7}, 0},          {{33, 3}, 0},        {{129, 70}, 0},
+      {{2, 9, 3, 5}, 1},    {{3, 4, 17}, 1},     {{4, 6, 13}, 0},
+      {{2, 16, 4, 4}, 1},   {{1, 2048, 40}, 1},  {{2, 3, 8}, 2}};
 
-    // Вывод результатов
-    std::cout << "Sequential: " << format_time(sequential_seconds) << " sec\n";
-    print_report("OpenMP", omp_res);
-    print_report("SIMD", simd_res);
-    print_report("OpenMP + SIMD", omp_simd_res);
+  bool all_passed = true;
+  for (const auto& c : cases) {
+    const TensorShape shape(c.dims);
+    const auto input = make_values(shape.numel());
+
+    std::size_t outer = 1, inner = 1;
+    for (std::size_t i = 0; i < c.axis; ++i) outer *= c.dims[i];
+    for (std::size_t i = c.axis + 1; i < c.dims.size(); ++i) {
+      inner *= c.dims[i];
+    }
+    const std::size_t len = c.dims[c.axis];
+
+    std::vector<float> expected(input.size());
+    std::vector<float> column(len), column_result(len);
+    for (std::size_t o = 0; o < outer; ++o) {
+      for (std::size_t j = 0; j < inner; ++j) {
+        const std::size_t base = o * len * inner + j;
+        for (std::size_t a = 0; a < len; ++a) {
+          column[a] = input[base + a * inner];
+        }
+        SoftmaxRow(column.data(), column_result.data(), len);
+        for (std::size_t a = 0; a < len; ++a) {
+          expected[base + a * inner] = column_result[a];
+        }
+      }
+    }
+
+    float max_diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      max_diff = std::max(
+          max_diff,
+          max_abs_diff(expected, softmax_axis(input, shape, c.axis, method)));
+    }
+
+    std::cout << "[";
+    for (std::size_t i = 0; i < c.dims.size(); ++i) {
+      std::cout << (i ? ", " : "") << c.dims[i];
+    }
+    std::cout << "], axis " << c.axis << ": ";
+    const bool ok = max_diff < 1e-5f;
+    std::cout << (ok ? "✅ ОК" : "❌ ПРОБЛЕМА") << " (diff = "
+              << std::scientific << max_diff << std::defaultfloat << ")\n";
+    all_passed = all_passed && ok;
+  }
+  return all_passed;
+}
+
+// Батч внимания [B, H, S, T] против построчного эталона
+bool test_attention_batch() {
+  std::cout << "\n=== Батч Softmax внимания [B, H, S, T] ===\n";
+  bool all_passed = true;
+
+  const std::size_t shapes[][3] = {{1, 1, 1}, {2, 3, 7}, {1, 12, 64},
+                                   {3, 2, 129}, {1, 1, 300}};
+  for (const auto& bhs : shapes) {
+    const TensorShape shape({bhs[0], bhs[1], bhs[2], bhs[2]});
+    const auto scores = make_values(shape.numel());
+    const auto expected =
+        reference_last_axis(scores, shape.rows(), bhs[2], bhs[2]);
+
+    float diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      std::vector<float> probs(scores.size());
+      softmax_attention(make_view(scores, shape), make_view(probs, shape),
+                        method);
+      diff = std::max(diff, max_abs_diff(expected, probs));
+    }
+    const std::string name = "B=" + std::to_string(bhs[0]) +
+                             " H=" + std::to_string(bhs[1]) +
+                             " S=" + std::to_string(bhs[2]);
+    all_passed = report_check(name, diff) && all_passed;
+  }
+
+  // Головы [1:3] из буфера [2, 4, 16, 16]: шаги по B и H не сворачиваются
+  {
+    const TensorShape full({2, 4, 16, 16});
+    const auto scores = make_values(full.numel());
+    const auto view = make_view(scores, full).slice(1, 1, 3);
+    std::vector<float> probs(2 * 2 * 16 * 16);
+    softmax_attention(view, make_view(probs, TensorShape({2, 2, 16, 16})),
+                      SoftmaxMethod::kOpenMPSimd);
+    std::vector<float> expected(probs.size());
+    softmax_last_axis(view, make_view(expected, TensorShape({2, 2, 16, 16})),
+                      SoftmaxMethod::kSequential);
+    all_passed = report_check("Срез голов [:, 1:3]",
+                              max_abs_diff(expected, probs)) &&
+                 all_passed;
+  }
+
+  // Неквадратные [B, H, S, T]: блок строк считается по длине строки T
+  {
+    const TensorShape shape({2, 3, 5, 300});
+    const auto scores = make_values(shape.numel());
+    const auto expected = reference_last_axis(scores, shape.rows(), 300, 300);
+    std::vector<float> probs(scores.size());
+    softmax_attention(make_view(scores, shape), make_view(probs, shape),
+                      SoftmaxMethod::kOpenMPSimd);
+    all_passed = report_check("B=2 H=3 S=5 T=300",
+                              max_abs_diff(expected, probs)) &&
+                 all_passed;
+    // Строка в 256 КиБ больше бюджета задачи: по строке на задачу
+    const bool one_row = attention_rows_per_task(1, 4, 64 * 1024, 1) == 1 &&
+                         attention_rows_per_task(1, 4096, 16, 1) == 512;
+    all_passed = report_check("Блок строк по числу ключей",
+                              one_row ? 0.0f : 1.0f) &&
+                 all_passed;
+  }
+  return all_passed;
+}
+
+// Прежний способ маскирования: -inf в замаскированные позиции копии оценок
+std::vector<float> apply_mask_with_inf(const std::vector<float>& scores,
+                                       std::size_t rows, std::size_t queries,
+                                       std::size_t cols,
+                                       const SoftmaxMask& mask) {
+  std::vector<float> masked(scores);
+  for (std::size_t r = 0; r < rows; ++r) {
+    std::size_t lo = 0, hi = cols;
+    mask.range(r, r % queries, cols, lo, hi);
+    for (std::size_t j = 0; j < cols; ++j) {
+      if (j < lo || j >= hi) masked[r * cols + j] = -INFINITY;
+    }
+  }
+  return masked;
+}
+
+// Softmax с маской против эталона "-inf + полный Softmax"
+bool test_masked_softmax() {
+  std::cout << "\n=== Softmax со структурной маской ===\n";
+  bool all_passed = true;
+
+  const std::size_t batch = 2, seq = 37;
+  const TensorShape shape({batch, seq, seq});
+  const auto scores = make_values(shape.numel());
+  std::vector<std::size_t> lengths(batch * seq);
+  for (std::size_t r = 0; r < lengths.size(); ++r) lengths[r] = (r * 7) % 40;
+
+  const std::pair<std::string_view, SoftmaxMask> masks[] = {
+      {"Causal", SoftmaxMask::causal()},
+      {"Окно W=5", SoftmaxMask::sliding_window(5)},
+      {"Окно W=1", SoftmaxMask::sliding_window(1)},
+      {"Длина строки", SoftmaxMask::valid_length(lengths.data())}};
+
+  for (const auto& [name, mask] : masks) {
+    auto expected = apply_mask_with_inf(scores, batch * seq, seq, seq, mask);
+    softmax_rows(expected.data(), seq, expected.data(), seq, batch * seq, seq,
+                 SoftmaxMethod::kSequential);
+    // Полностью замаскированная строка: договорённость - нули
+    for (std::size_t r = 0; r < batch * seq; ++r) {
+      std::size_t lo = 0, hi = seq;
+      mask.range(r, r % seq, seq, lo, hi);
+      if (lo == hi) std::fill_n(&expected[r * seq], seq, 0.0f);
+    }
+
+    float diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      std::vector<float> probs(scores.size(), -1.0f);
+      softmax_masked(make_view(scores, shape), make_view(probs, shape), mask,
+                     method);
+      diff = std::max(diff, max_abs_diff(expected, probs));
+    }
+    all_passed = report_check(name, diff) && all_passed;
+  }
+  return all_passed;
+}
+
+// Параметры пролога внимания: x / sqrt(d) + bias[j] + ALiBi, затем / T
+struct PrologueParams {
+  std::size_t heads = 1;
+  std::size_t seq_len = 1;
+  float scale = 1.0f;
+  float temperature = 1.0f;
+  std::vector<float> column_bias;
+  std::vector<float> slopes;
+};
+
+PrologueParams make_prologue_params(std::size_t heads, std::size_t seq_len,
+                                    std::size_t head_dim) {
+  PrologueParams params;
+  params.heads = heads;
+  params.seq_len = seq_len;
+  params.scale = 1.0f / std::sqrt(static_cast<float>(head_dim));
+  params.temperature = 0.7f;
+  params.column_bias = make_values(seq_len);
+  for (std::size_t h = 0; h < heads; ++h) {
+    params.slopes.push_back(std::exp2(-8.0f * (h + 1) / heads));
+  }
+  return params;
+}
+
+// Пролог отдельными проходами по матрице (как без слияния), затем Softmax
+std::vector<float> prologue_via_passes(std::vector<float> scores,
+                                       const PrologueParams& params,
+                                       SoftmaxMethod method) {
+  const std::size_t s = params.seq_len;
+  const std::size_t rows = scores.size() / s;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+#pragma omp parallel for if (parallel)
+  for (std::size_t i = 0; i < scores.size(); ++i) scores[i] *= params.scale;
+#pragma omp parallel for if (parallel)
+  for (std::size_t r = 0; r < rows; ++r) {
+    for (std::size_t j = 0; j < s; ++j) {
+      scores[r * s + j] += params.column_bias[j];
+    }
+  }
+#pragma omp parallel for if (parallel)
+  for (std::size_t r = 0; r < rows; ++r) {
+    const float slope = params.slopes[(r / s) % params.heads];
+    const float q = static_cast<float>(r % s);
+    for (std::size_t j = 0; j < s; ++j) {
+      scores[r * s + j] += slope * (static_cast<float>(j) - q);
+    }
+  }
+#pragma omp parallel for if (parallel)
+  for (std::size_t i = 0; i < scores.size(); ++i) {
+    scores[i] /= params.temperature;
+  }
+  softmax_rows(scores.data(), s, scores.data(), s, rows, s, method);
+  return scores;
+}
+
+// Тот же пролог, слитый с первым проходом Softmax
+std::vector<float> prologue_fused(const std::vector<float>& scores,
+                                  const TensorShape& shape,
+                                  const PrologueParams& params,
+                                  SoftmaxMethod method) {
+  std::vector<float> probs(scores.size());
+  const auto chain = make_prologue(
+      prologue::Scale{params.scale},
+      prologue::ColumnBias{params.column_bias.data()},
+      prologue::Alibi{params.slopes.data(), params.seq_len, params.heads},
+      prologue::Temperature(params.temperature));
+  softmax_prologue(make_view(scores, shape), make_view(probs, shape), chain,
+                   method);
+  return probs;
+}
+
+// Слитый пролог против отдельных проходов
+bool test_prologue_fusion() {
+  std::cout << "\n=== Пролог Softmax (масштаб, bias, ALiBi, T) ===\n";
+  bool all_passed = true;
+
+  for (std::size_t seq : {1, 7, 8, 37, 64}) {
+    const TensorShape shape({2, 3, seq, seq});
+    const auto scores = make_values(shape.numel());
+    const auto params = make_prologue_params(3, seq, 64);
+    const auto expected =
+        prologue_via_passes(scores, params, SoftmaxMethod::kSequential);
+
+    float diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      diff = std::max(diff, max_abs_diff(expected, prologue_fused(
+                                                       scores, shape, params,
+                                                       method)));
+    }
+    all_passed =
+        report_check("S = " + std::to_string(seq), diff) && all_passed;
+  }
+
+  // Построчные параметры и полная матрица смещений
+  const std::size_t rows = 19, cols = 45;
+  const TensorShape shape({rows, cols});
+  const auto scores = make_values(rows * cols);
+  const auto row_scale = make_values(rows);
+  const auto row_bias = make_values(rows);
+  const auto bias = make_values(rows * cols);
+
+  auto expected = scores;
+  for (std::size_t r = 0; r < rows; ++r) {
+    for (std::size_t j = 0; j < cols; ++j) {
+      float& x = expected[r * cols + j];
+      x = x * row_scale[r] + row_bias[r] + bias[r * cols + j];
+    }
+  }
+  softmax_rows(expected.data(), cols, expected.data(), cols, rows, cols,
+               SoftmaxMethod::kSequential);
+
+  const auto chain = make_prologue(prologue::RowScale{row_scale.data()},
+                                   prologue::RowBias{row_bias.data()},
+                                   prologue::MatrixBias{bias.data(), rows,
+                                                        cols});
+  float diff = 0.0f;
+  for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kSimd}) {
+    std::vector<float> probs(scores.size());
+    softmax_prologue(make_view(scores, shape), make_view(probs, shape), chain,
+                     method);
+    diff = std::max(diff, max_abs_diff(expected, probs));
+  }
+  all_passed =
+      report_check("Построчные scale/bias + матрица bias", diff) && all_passed;
+  return all_passed;
+}
+
+// Эталон в double: log-softmax, потери и градиент cross-entropy
+struct CrossEntropyReference {
+  std::vector<float> log_probs;
+  std::vector<float> losses;
+  std::vector<float> grad;
+};
+
+CrossEntropyReference reference_cross_entropy(
+    const std::vector<float>& logits, std::size_t rows, std::size_t cols,
+    const std::vector<std::size_t>& targets, double smoothing) {
+  CrossEntropyReference ref;
+  ref.log_probs.resize(logits.size());
+  ref.grad.resize(logits.size());
+  for (std::size_t r = 0; r < rows; ++r) {
+    const float* row = &logits[r * cols];
+    double max = row[0], sum_exp = 0.0, loss = 0.0;
+    for (std::size_t j = 0; j < cols; ++j) max = std::max(max, double(row[j]));
+    for (std::size_t j = 0; j < cols; ++j) sum_exp += std::exp(row[j] - max);
+    const double lse = max + std::log(sum_exp);
+    for (std::size_t j = 0; j < cols; ++j) {
+      const double log_p = row[j] - lse;
+      const double q = (j == targets[r] ? 1.0 - smoothing : 0.0) +
+                       smoothing / static_cast<double>(cols);
+      ref.log_probs[r * cols + j] = static_cast<float>(log_p);
+      ref.grad[r * cols + j] = static_cast<float>(std::exp(log_p) - q);
+      loss -= q * log_p;
+    }
+    ref.losses.push_back(static_cast<float>(loss));
+  }
+  return ref;
+}
+
+// Log-softmax и cross-entropy против эталона в double
+bool test_cross_entropy() {
+  std::cout << "\n=== Log-softmax и Softmax + cross-entropy ===\n";
+  bool all_passed = true;
+
+  for (std::size_t cols : {1, 7, 8, 33, 1000}) {
+    const std::size_t rows = 13;
+    const TensorShape shape({rows, cols});
+    // Широкие логиты: без вычитания максимума exp переполнился бы
+    auto logits = make_values(rows * cols);
+    for (float& x : logits) x = 200.0f * x - 50.0f;
+    std::vector<std::size_t> targets(rows);
+    for (std::size_t r = 0; r < rows; ++r) targets[r] = (r * 5) % cols;
+
+    for (float smoothing : {0.0f, 0.1f}) {
+      const auto ref =
+          reference_cross_entropy(logits, rows, cols, targets, smoothing);
+      float log_diff = 0.0f, loss_diff = 0.0f, grad_diff = 0.0f;
+      for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                          SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+        std::vector<float> log_probs(logits.size()), grad(logits.size());
+        std::vector<float> losses(rows);
+        log_softmax(make_view(logits, shape), make_view(log_probs, shape),
+                    method);
+        softmax_cross_entropy(make_view(logits, shape), targets.data(),
+                              smoothing, losses.data(),
+                              make_view(grad, shape), method);
+        log_diff = std::max(log_diff, max_abs_diff(ref.log_probs, log_probs));
+        loss_diff = std::max(loss_diff, max_abs_diff(ref.losses, losses));
+        grad_diff = std::max(grad_diff, max_abs_diff(ref.grad, grad));
+      }
+      const std::string name = "n = " + std::to_string(cols) +
+                               ", smoothing " + format_time(smoothing, 1);
+      // Логиты и lse порядка сотен: ошибка округления lse во float ~1e-5
+      all_passed = report_check(name + ", log-softmax", log_diff, 1e-4f) &&
+                   all_passed;
+      all_passed =
+          report_check(name + ", потеря", loss_diff, 1e-4f) && all_passed;
+      all_passed =
+          report_check(name + ", градиент", grad_diff, 1e-4f) && all_passed;
+    }
+  }
+
+  // Статистики за одно чтение: максимум растёт в каждом векторе, часть
+  // дорожек начинается с -inf (маска), строка целиком из -inf
+  const float inf = std::numeric_limits<float>::infinity();
+  std::vector<float> rising(203);
+  for (std::size_t j = 0; j < rising.size(); ++j) {
+    rising[j] = j % 8 < 3 && j < 64 ? -inf : 0.5f * j - 40.0f;
+  }
+  double lse_ref = 0.0, max_ref = -inf;
+  for (float x : rising) max_ref = std::max<double>(max_ref, x);
+  for (float x : rising) lse_ref += std::exp(x - max_ref);
+  lse_ref = max_ref + std::log(lse_ref);
+  const std::vector<float> masked(19, -inf);
+  float online_diff = 0.0f;
+  for (const auto& stats : {LogitStatsRow(rising.data(), rising.size()),
+                            LogitStatsRowSimd(rising.data(), rising.size())}) {
+    online_diff = std::max(
+        online_diff, static_cast<float>(std::abs(stats.lse - lse_ref)));
+  }
+  for (const auto& stats : {LogitStatsRow(masked.data(), masked.size()),
+                            LogitStatsRowSimd(masked.data(), masked.size())}) {
+    if (stats.lse != -inf || stats.max != -inf) online_diff = 1.0f;
+  }
+  all_passed = report_check("Онлайн max и Σ exp за одно чтение", online_diff,
+                            1e-4f) &&
+               all_passed;
+
+  // NaN в начале блока, в середине, в другом блоке и в хвосте: lse и
+  // потеря - NaN на обоих путях, максимум NaN не включает
+  bool nan_agrees = true;
+  for (std::size_t pos : {0, 5, 150, 700, 997}) {
+    std::vector<float> row = make_values(1000);
+    for (float& x : row) x = 20.0f * x;
+    row[pos] = std::numeric_limits<float>::quiet_NaN();
+    const LogitStats scalar = LogitStatsRow(row.data(), row.size());
+    const LogitStats simd = LogitStatsRowSimd(row.data(), row.size());
+    nan_agrees = nan_agrees && std::isnan(scalar.lse) &&
+                 std::isnan(simd.lse) && scalar.max == simd.max;
+    const TensorShape shape({1, row.size()});
+    const std::size_t target = 1;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kSimd}) {
+      const float loss = softmax_cross_entropy(
+          make_view(row, shape), &target, 0.0f, nullptr, {}, method);
+      nan_agrees = nan_agrees && std::isnan(loss);
+    }
+  }
+  all_passed = report_check("NaN в логитах даёт NaN lse",
+                            nan_agrees ? 0.0f : 1.0f) &&
+               all_passed;
+  return all_passed;
+}
+
+// Эталон обратного прохода в double: dx = y * (dy - sum(dy * y))
+std::vector<float> reference_backward(const std::vector<float>& y,
+                                      const std::vector<float>& dy,
+                                      std::size_t rows, std::size_t cols) {
+  std::vector<float> dx(y.size());
+  for (std::size_t r = 0; r < rows; ++r) {
+    double dot = 0.0;
+    for (std::size_t j = 0; j < cols; ++j) {
+      dot += static_cast<double>(dy[r * cols + j]) * y[r * cols + j];
+    }
+    for (std::size_t j = 0; j < cols; ++j) {
+      dx[r * cols + j] =
+          static_cast<float>(y[r * cols + j] * (dy[r * cols + j] - dot));
+    }
+  }
+  return dx;
+}
+
+// Обратный проход Softmax против эталона в double
+bool test_softmax_backward() {
+  std::cout << "\n=== Обратный проход Softmax ===\n";
+  bool all_passed = true;
+
+  // 1024 x 2048 - результат 8 МиБ, проверяется ветка потоковых записей
+  const std::pair<std::size_t, std::size_t> sizes[] = {
+      {3, 1}, {5, 7}, {9, 8}, {17, 33}, {64, 129}, {1024, 2048}};
+  for (const auto& [rows, cols] : sizes) {
+    auto y = make_values(rows * cols);
+    softmax_rows(y.data(), cols, y.data(), cols, rows, cols,
+                 SoftmaxMethod::kSimd);
+    auto dy = make_values(rows * cols);
+    for (float& g : dy) g = 2.0f * g - 1.0f;
+    const auto expected = reference_backward(y, dy, rows, cols);
+
+    float diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      std::vector<float> dx(y.size());
+      softmax_backward_rows(y.data(), cols, dy.data(), cols, dx.data(), cols,
+                            rows, cols, method);
+      diff = std::max(diff, max_abs_diff(expected, dx));
+    }
+    // Обновление на месте: dx записывается поверх dy
+    softmax_backward_rows(y.data(), cols, dy.data(), cols, dy.data(), cols,
+                          rows, cols, SoftmaxMethod::kOpenMPSimd);
+    diff = std::max(diff, max_abs_diff(expected, dy));
+    all_passed = report_check(std::to_string(rows) + " x " +
+                                  std::to_string(cols),
+                              diff) &&
+                 all_passed;
+  }
+  return all_passed;
+}
+
+// Softmax + dropout против эталона в double: маска из Dropout::keep,
+// обратный проход - reference_backward по градиенту после маски
+bool test_softmax_dropout() {
+  std::cout << "\n=== Softmax + dropout ===\n";
+  bool all_passed = true;
+  const Dropout dropout(0.25f, 2024);
+
+  for (std::size_t n : {1, 7, 33, 100}) {
+    const std::size_t rows = 6;
+    auto logits = make_values(rows * n, InputDistribution::kWideRange);
+    for (std::size_t j = 0; j < n; ++j) logits[j] = -INFINITY;
+    auto dout = make_values(rows * n);
+    for (float& g : dout) g = 2.0f * g - 1.0f;
+
+    std::vector<float> y(rows * n, 1.0f / n), expected(rows * n), g(rows * n);
+    std::vector<float> expected_lse(rows, -INFINITY);
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float* row = &logits[r * n];
+      if (r > 0) {
+        const double max = *std::max_element(row, row + n);
+        double sum = 0.0;
+        for (std::size_t j = 0; j < n; ++j) sum += std::exp(row[j] - max);
+        for (std::size_t j = 0; j < n; ++j) {
+          y[r * n + j] = static_cast<float>(std::exp(row[j] - max) / sum);
+        }
+        expected_lse[r] = static_cast<float>(max + std::log(sum));
+      }
+      for (std::size_t j = 0; j < n; ++j) {
+        const bool keep = dropout.keep(r, j);
+        expected[r * n + j] = keep ? y[r * n + j] * dropout.scale : 0.0f;
+        g[r * n + j] = keep ? dout[r * n + j] * dropout.scale : 0.0f;
+      }
+    }
+    const auto expected_dx = reference_backward(y, g, rows, n);
+
+    const TensorShape shape({rows, n});
+    float forward_diff = 0.0f, backward_diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      std::vector<float> out(rows * n), lse(rows), dx(rows * n);
+      softmax_dropout(make_view(logits, shape), make_view(out, shape),
+                      lse.data(), dropout, method);
+      forward_diff = std::max(forward_diff, max_abs_diff(expected, out));
+      // lse порядка сотни: сравнение относительное
+      for (std::size_t r = 1; r < rows; ++r) {
+        forward_diff = std::max(forward_diff,
+                                std::abs(lse[r] - expected_lse[r]) /
+                                    std::max(1.0f, std::abs(expected_lse[r])));
+      }
+      softmax_dropout_backward(make_view(logits, shape), lse.data(),
+                               make_view(dout, shape), make_view(dx, shape),
+                               dropout, method);
+      backward_diff = std::max(backward_diff, max_abs_diff(expected_dx, dx));
+    }
+    all_passed = report_check("Прямой проход, n = " + std::to_string(n),
+                              forward_diff) &&
+                 all_passed;
+    all_passed = report_check("Обратный проход, n = " + std::to_string(n),
+                              backward_diff) &&
+                 all_passed;
+  }
+
+  // Доля сохранённых элементов длинной строки близка к 1 - rate
+  const std::size_t n = 1 << 18;
+  const auto logits = make_values(n);
+  std::vector<float> out(n);
+  softmax_dropout(make_view(logits, TensorShape({1, n})),
+                  make_view(out, TensorShape({1, n})), nullptr, dropout,
+                  SoftmaxMethod::kSimd);
+  const auto kept = std::count_if(out.begin(), out.end(),
+                                  [](float p) { return p > 0.0f; });
+  all_passed = report_check("Доля сохранённых элементов",
+                            std::abs(static_cast<float>(kept) / n - 0.75f),
+                            5e-3f) &&
+               all_passed;
+
+  int thrown = 0;
+  for (float rate : {-0.1f, 1.0f}) {
+    try {
+      Dropout invalid(rate, 0);
+    } catch (const std::invalid_argument&) {
+      ++thrown;
+    }
+  }
+  all_passed =
+      report_check("Доля вне [0, 1)", thrown == 2 ? 0.0f : 1.0f) && all_passed;
+  return all_passed;
+}
+
+// Softmax типов In -> Out всеми методами против float Softmax над теми же
+// (округлёнными до In) входами; возвращает максимальное отклонение
+template <typename In, typename Out>
+float half_storage_diff(const std::vector<float>& logits, std::size_t rows,
+                        std::size_t cols, HalfExp exp) {
+  const auto input = convert_from_float<In>(logits);
+  auto expected = convert_to_float(input);
+  softmax_rows(expected.data(), cols, expected.data(), cols, rows, cols,
+               SoftmaxMethod::kSequential);
+
+  float diff = 0.0f;
+  for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                      SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+    std::vector<Out> output(input.size());
+    softmax_rows(input.data(), cols, output.data(), cols, rows, cols, method,
+                 DenormalMode::kPreserve, exp);
+    diff = std::max(diff, max_abs_diff(expected, convert_to_float(output)));
+  }
+  return diff;
+}
+
+// Хранение в fp16/bf16 с вычислениями во float
+bool test_half_storage() {
+  std::cout << "\n=== Softmax с хранением в fp16/bf16 ===\n";
+  bool all_passed = true;
+
+  // Точность табличной экспоненты на всём диапазоне fp16 без клампа
+  float table_error = 0.0f;
+  const float* table = half_exp_table();
+  for (std::uint32_t bits = 0; bits < (1u << 16); ++bits) {
+    const double x = f16_to_f32(static_cast<std::uint16_t>(bits));
+    if (std::isnan(x) || std::abs(x) > 88.0) continue;
+    const double exact = std::exp(x);
+    table_error = std::max(
+        table_error, static_cast<float>(std::abs(table[bits] - exact) / exact));
+  }
+  all_passed =
+      report_check("Таблица exp fp16 (отн.)", table_error, 1e-7f) &&
+      all_passed;
+
+  const std::size_t rows = 6;
+  for (std::size_t cols : {1, 7, 8, 9, 33, 1000}) {
+    // exp(20) не помещается в fp16: ненормализованные экспоненты в
+    // 16-битный выход не пишутся
+    auto logits = make_values(rows * cols);
+    for (float& x : logits) x = 30.0f * x - 10.0f;
+    const std::string size = "n = " + std::to_string(cols);
+
+    // Допуски - половина ulp выхода около 1: fp16 2^-11, bf16 2^-8
+    const float diffs[] = {
+        half_storage_diff<Half, Half>(logits, rows, cols,
+                                      HalfExp::kPolynomial),
+        half_storage_diff<Half, float>(logits, rows, cols,
+                                       HalfExp::kPolynomial),
+        half_storage_diff<Half, Half>(logits, rows, cols, HalfExp::kTable),
+        half_storage_diff<BFloat16, BFloat16>(logits, rows, cols,
+                                              HalfExp::kPolynomial),
+        half_storage_diff<float, BFloat16>(logits, rows, cols,
+                                           HalfExp::kPolynomial)};
+    const std::pair<std::string_view, float> variants[] = {
+        {"fp16 -> fp16", 5e-4f},
+        {"fp16 -> float", 1e-5f},
+        {"fp16 -> fp16 (таблица exp)", 5e-4f},
+        {"bf16 -> bf16", 4e-3f},
+        {"float -> bf16", 4e-3f}};
+    for (std::size_t v = 0; v < std::size(diffs); ++v) {
+      const auto& [name, tolerance] = variants[v];
+      all_passed = report_check(size + ", " + std::string(name), diffs[v],
+                                tolerance) &&
+                   all_passed;
+    }
+  }
+  return all_passed;
+}
+
+// Случайные квантованные логиты в [lo, hi]
+template <typename T>
+std::vector<T> make_quantized(std::size_t count, std::int32_t lo,
+                              std::int32_t hi) {
+  std::vector<T> values(count);
+  std::mt19937 gen(15);
+  std::uniform_int_distribution<std::int32_t> dist(lo, hi);
+  for (auto& q : values) q = static_cast<T>(dist(gen));
+  return values;
+}
+
+// Эталон для квантованных логитов: деквантование и Softmax в double
+template <typename T>
+std::vector<float> reference_quantized(const std::vector<T>& logits,
+                                       float scale, std::size_t rows,
+                                       std::size_t cols) {
+  std::vector<float> probs(logits.size());
+  for (std::size_t r = 0; r < rows; ++r) {
+    const T* row = &logits[r * cols];
+    const double max = *std::max_element(row, row + cols);
+    double sum = 0.0;
+    for (std::size_t j = 0; j < cols; ++j) {
+      sum += std::exp(double(scale) * (row[j] - max));
+    }
+    for (std::size_t j = 0; j < cols; ++j) {
+      probs[r * cols + j] =
+          static_cast<float>(std::exp(double(scale) * (row[j] - max)) / sum);
+    }
+  }
+  return probs;
+}
+
+// Отклонение Softmax квантованных логитов In -> Out от эталона (все методы)
+template <typename In, typename Out>
+float quantized_diff(const std::vector<In>& logits, float scale,
+                     std::size_t rows, std::size_t cols) {
+  const auto expected = reference_quantized(logits, scale, rows, cols);
+  const TensorShape shape({rows, cols});
+  float diff = 0.0f;
+  for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                      SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+    std::vector<Out> probs(logits.size());
+    softmax_quantized(make_view(logits, shape), scale,
+                      make_view(probs, shape), method);
+    std::vector<float> values(probs.size());
+    for (std::size_t i = 0; i < probs.size(); ++i) {
+      if constexpr (std::is_same_v<Out, std::uint8_t>) {
+        values[i] = probs[i] / kUInt8ProbScale;
+      } else {
+        values[i] = StorageTraits<Out>::to_float(probs[i]);
+      }
+    }
+    diff = std::max(diff, max_abs_diff(expected, values));
+  }
+  return diff;
+}
+
+// Softmax квантованных логитов против эталона в double
+bool test_quantized_softmax() {
+  std::cout << "\n=== Softmax квантованных логитов (int8/int32) ===\n";
+  bool all_passed = true;
+
+  const std::size_t rows = 7;
+  for (std::size_t cols : {1, 7, 8, 33, 100, 1000}) {
+    const std::string size = "n = " + std::to_string(cols);
+    const auto q8 = make_quantized<std::int8_t>(rows * cols, -128, 127);
+    const auto q32 =
+        make_quantized<std::int32_t>(rows * cols, -200000, 200000);
+
+    all_passed = report_check(size + ", int8 -> float",
+                              quantized_diff<std::int8_t, float>(
+                                  q8, 0.05f, rows, cols)) &&
+                 all_passed;
+    all_passed = report_check(size + ", int8 -> fp16",
+                              quantized_diff<std::int8_t, Half>(
+                                  q8, 0.05f, rows, cols),
+                              5e-4f) &&
+                 all_passed;
+    // uint8: половина шага 1/255 плюс погрешность суммы
+    all_passed = report_check(size + ", int8 -> uint8",
+                              quantized_diff<std::int8_t, std::uint8_t>(
+                                  q8, 0.05f, rows, cols),
+                              2.5e-3f) &&
+                 all_passed;
+    // Таблицы по байтам разности и полиномиальный путь для мелкого масштаба
+    all_passed = report_check(size + ", int32 -> float (таблицы)",
+                              quantized_diff<std::int32_t, float>(
+                                  q32, 1e-2f, rows, cols)) &&
+                 all_passed;
+    all_passed = report_check(size + ", int32 -> float (полином)",
+                              quantized_diff<std::int32_t, float>(
+                                  q32, 1e-5f, rows, cols)) &&
+                 all_passed;
+  }
+  return all_passed;
+}
+
+// Top-k эталон: полная сортировка пар (значение, индекс) без NaN
+std::vector<TopKEntry> reference_topk(const float* row, std::size_t n,
+                                      std::size_t k) {
+  std::vector<TopKEntry> entries;
+  for (std::size_t j = 0; j < n; ++j) {
+    if (!std::isnan(row[j])) {
+      entries.push_back({row[j], static_cast<std::int32_t>(j)});
+    }
+  }
+  std::sort(entries.begin(), entries.end(), topk_before);
+  entries.resize(std::min(k, entries.size()));
+  return entries;
+}
+
+// Top-k, генератор Philox и сэмплирование Гумбеля
+bool test_topk_sampling() {
+  std::cout << "\n=== Top-k и сэмплирование без нормализации ===\n";
+  bool all_passed = true;
+
+  // Контрольные значения Philox4x32-10 из Random123 (kat_vectors)
+  const auto zero = philox4x32({0, 0, 0, 0}, 0, 0);
+  const auto ones = philox4x32(
+      {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}, 0xFFFFFFFF,
+      0xFFFFFFFF);
+  const bool kat =
+      zero == std::array<std::uint32_t, 4>{0x6627E8D5, 0xE169C58D,
+                                           0xBC57AC4C, 0x9B00DBD8} &&
+      ones == std::array<std::uint32_t, 4>{0x408F276D, 0x41C83B0E,
+                                           0xA20BC7C6, 0x6D5451FD};
+  all_passed = report_check("Philox4x32-10 KAT", kat ? 0.0f : 1.0f, 0.5f) &&
+               all_passed;
+
+  // AVX2 блок и поэлементная функция дают те же числа
+  std::size_t rng_mismatch = 0;
+  for (std::uint64_t block : {0ull, 1ull, 12345ull}) {
+    __m256i vec[4];
+    std::uint32_t scalar[kPhiloxBlockCols], simd[kPhiloxBlockCols];
+    philox_block(42, 7, 1ull << 33 | 5, block, scalar);
+    philox_block_avx2(42, 7, 1ull << 33 | 5, block, vec);
+    std::memcpy(simd, vec, sizeof(simd));
+    for (std::size_t c = 0; c < kPhiloxBlockCols; ++c) {
+      rng_mismatch += scalar[c] != simd[c];
+      rng_mismatch += scalar[c] != philox_bits(42, 7, 1ull << 33 | 5,
+                                               block * kPhiloxBlockCols + c);
+    }
+  }
+  all_passed = report_check("Philox: AVX2 = скалярный",
+                            static_cast<float>(rng_mismatch), 0.5f) &&
+               all_passed;
+
+  // log256_ps против std::log (относительная ошибка)
+  float log_error = 0.0f;
+  for (float x = 1e-30f; x < 1e30f; x *= 1.37f) {
+    alignas(32) float out[8];
+    _mm256_store_ps(out, log256_ps(_mm256_set1_ps(x)));
+    log_error = std::max(log_error, std::abs(out[0] - std::log(x)) /
+                                        std::max(1.0f, std::abs(std::log(x))));
+  }
+  all_passed = report_check("log256_ps", log_error, 1e-6f) && all_passed;
+
+  // Top-k против полной сортировки; округление даёт повторы значений
+  for (std::size_t cols : {1, 7, 8, 33, 1000}) {
+    const std::size_t rows = 9;
+    auto logits = make_values(rows * cols);
+    for (float& x : logits) x = std::round(x * 50.0f) / 5.0f;
+    if (cols > 3) logits[2] = NAN;
+    const TensorShape shape({rows, cols});
+    std::vector<std::size_t> ks = {1, std::min<std::size_t>(5, cols), cols};
+    ks.erase(std::unique(ks.begin(), ks.end()), ks.end());
+    for (std::size_t k : ks) {
+      const TensorShape out_shape({rows, k});
+      float diff = 0.0f;
+      for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                          SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+        std::vector<std::int32_t> indices(rows * k);
+        std::vector<float> probs(rows * k);
+        softmax_topk(make_view(logits, shape), k,
+                     make_view(indices, out_shape),
+                     make_view(probs, out_shape), method);
+        for (std::size_t r = 0; r < rows; ++r) {
+          const auto expected = reference_topk(&logits[r * cols], cols, k);
+          float sum_exp = 0.0f;
+          for (const auto& e : expected) {
+            sum_exp += std::exp(e.value - expected.front().value);
+          }
+          for (std::size_t j = 0; j < k; ++j) {
+            const bool present = j < expected.size();
+            const std::int32_t index = present ? expected[j].index : -1;
+            const float p =
+                present ? std::exp(expected[j].value -
+                                   expected.front().value) / sum_exp
+                        : 0.0f;
+            if (indices[r * k + j] != index) diff = 1.0f;
+            diff = std::max(diff, std::abs(probs[r * k + j] - p));
+          }
+        }
+      }
+      all_passed = report_check("Top-k n = " + std::to_string(cols) +
+                                    ", k = " + std::to_string(k),
+                                diff) &&
+                   all_passed;
+    }
+  }
+
+  // Частоты выборок Гумбеля против softmax(x / T) на 40000 строках
+  const std::size_t cols = 37, rows = 40000;
+  const float temperature = 0.8f;
+  const auto row = make_values(cols);
+  std::vector<float> logits(rows * cols);
+  for (std::size_t r = 0; r < rows; ++r) {
+    std::copy(row.begin(), row.end(), logits.begin() + r * cols);
+  }
+  for (float& x : logits) x *= 3.0f;
+  std::vector<double> expected(cols);
+  double sum_exp = 0.0;
+  for (std::size_t j = 0; j < cols; ++j) {
+    expected[j] = std::exp(logits[j] / temperature);
+    sum_exp += expected[j];
+  }
+
+  const TensorShape shape({rows, cols});
+  for (auto sampling : {SamplingMethod::kGumbel, SamplingMethod::kInverseCdf}) {
+    const std::string name =
+        sampling == SamplingMethod::kGumbel ? "Гумбель" : "Обратная CDF";
+    std::vector<std::int32_t> scalar(rows), simd(rows), parallel(rows);
+    sample_softmax(make_view(logits, shape), temperature, 2025, scalar.data(),
+                   SoftmaxMethod::kSequential, sampling);
+    sample_softmax(make_view(logits, shape), temperature, 2025, simd.data(),
+                   SoftmaxMethod::kSimd, sampling);
+    sample_softmax(make_view(logits, shape), temperature, 2025,
+                   parallel.data(), SoftmaxMethod::kOpenMPSimd, sampling);
+
+    for (const auto* samples : {&scalar, &simd}) {
+      std::vector<double> counts(cols);
+      for (std::int32_t s : *samples) counts[s] += 1.0;
+      float freq_diff = 0.0f;
+      for (std::size_t j = 0; j < cols; ++j) {
+        freq_diff = std::max(
+            freq_diff, static_cast<float>(std::abs(counts[j] / rows -
+                                                   expected[j] / sum_exp)));
+      }
+      // 4 стандартных отклонения частоты при p <= 0.15 и 40000 выборках
+      all_passed =
+          report_check(name + (samples == &scalar ? ": частоты (скалярно)"
+                                                  : ": частоты (SIMD)"),
+                       freq_diff, 7.5e-3f) &&
+          all_passed;
+    }
+    std::size_t thread_mismatch = 0, simd_mismatch = 0;
+    for (std::size_t r = 0; r < rows; ++r) {
+      thread_mismatch += simd[r] != parallel[r];
+      simd_mismatch += simd[r] != scalar[r];
+    }
+    all_passed = report_check(name + ": не зависит от числа потоков",
+                              static_cast<float>(thread_mismatch), 0.5f) &&
+                 all_passed;
+    // Полиномиальные log и exp могут развести почти равные значения
+    all_passed = report_check(name + ": доля расхождений SIMD и скалярного",
+                              static_cast<float>(simd_mismatch) / rows,
+                              1e-3f) &&
+                 all_passed;
+  }
+
+  // Отсечение блоков Гумбеля на строке с большим разбросом логитов и
+  // выбор обратной CDF через границы блоков kCdfBlockCols
+  const std::size_t long_cols = 3000, long_rows = 2000;
+  std::vector<float> peaked(long_rows * long_cols, -30.0f);
+  for (std::size_t r = 0; r < long_rows; ++r) {
+    peaked[r * long_cols + 255] = 0.0f;
+    peaked[r * long_cols + 256] = 0.0f;
+    peaked[r * long_cols + 2999] = 0.0f;
+  }
+  peaked[7] = NAN;
+  const TensorShape long_shape({long_rows, long_cols});
+  for (auto sampling : {SamplingMethod::kGumbel, SamplingMethod::kInverseCdf}) {
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kSimd}) {
+      std::vector<std::int32_t> samples(long_rows);
+      sample_softmax(make_view(peaked, long_shape), 1.0f, 7, samples.data(),
+                     method, sampling);
+      // Остальные 2997 столбцов вместе имеют вероятность ~3e-10
+      std::array<double, 3> counts{};
+      bool valid = true;
+      for (std::int32_t s : samples) {
+        if (s == 255) counts[0] += 1.0;
+        else if (s == 256) counts[1] += 1.0;
+        else if (s == 2999) counts[2] += 1.0;
+        else valid = false;
+      }
+      float freq_diff = valid ? 0.0f : 1.0f;
+      for (double count : counts) {
+        freq_diff = std::max(
+            freq_diff,
+            static_cast<float>(std::abs(count / long_rows - 1.0 / 3.0)));
+      }
+      all_passed =
+          report_check(std::string(sampling == SamplingMethod::kGumbel
+                                       ? "Гумбель"
+                                       : "Обратная CDF") +
+                           (method == SoftmaxMethod::kSimd ? " (SIMD)" : "") +
+                           ": три пика из 3000",
+                       freq_diff, 0.045f) &&
+          all_passed;
+    }
+  }
+  return all_passed;
+}
+
+// Ненормализованный Softmax и отложенный масштаб против обычного Softmax
+bool test_lazy_softmax() {
+  std::cout << "\n=== Softmax с отложенной нормализацией ===\n";
+  bool all_passed = true;
+
+  for (std::size_t n : {1, 7, 8, 33, 130}) {
+    const std::size_t rows = n + 3;
+    auto scores = make_values(rows * n, InputDistribution::kWideRange);
+    for (std::size_t j = 0; j < n; ++j) scores[j] = -INFINITY;
+    const TensorShape shape({rows, n});
+    // Эталон в double с вычитанием максимума: логиты до -120 опустошают
+    // exp(x) во float; строка из -inf - равномерное распределение
+    std::vector<float> expected(scores.size(), 1.0f / n);
+    for (std::size_t r = 1; r < rows; ++r) {
+      const float* row = &scores[r * n];
+      const double max = *std::max_element(row, row + n);
+      double sum = 0.0;
+      for (std::size_t j = 0; j < n; ++j) sum += std::exp(row[j] - max);
+      for (std::size_t j = 0; j < n; ++j) {
+        expected[r * n + j] = static_cast<float>(std::exp(row[j] - max) / sum);
+      }
+    }
+
+    float softmax_diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      std::vector<float> exps(scores.size()), scale(rows);
+      softmax_unnormalized(make_view(scores, shape), make_view(exps, shape),
+                           scale.data(), method);
+      apply_row_scale(make_view(exps, shape), scale.data(), method);
+      softmax_diff = std::max(softmax_diff, max_abs_diff(expected, exps));
+    }
+    all_passed = report_check("exps * scale, n = " + std::to_string(n),
+                              softmax_diff) &&
+                 all_passed;
+
+    // P×V с масштабом в эпилоге против (P нормализована)×V; d не кратно 16
+    const std::size_t d = 21;
+    const auto v = make_values(n * d);
+    const TensorShape v_shape({n, d}), out_shape({rows, d});
+    std::vector<float> exps(scores.size()), scale(rows);
+    softmax_unnormalized(make_view(scores, shape), make_view(exps, shape),
+                         scale.data(), SoftmaxMethod::kSequential);
+    const auto expected_out =
+        gemm(expected, v, rows, n, d, GemmMethod::kSequential);
+    float gemm_diff = 0.0f;
+    for (auto method : {GemmMethod::kSequential, GemmMethod::kOpenMP,
+                        GemmMethod::kSimd, GemmMethod::kOpenMPSimd}) {
+      std::vector<float> out(rows * d);
+      gemm(make_view(exps, shape), make_view(v, v_shape),
+           make_view(out, out_shape), method, scale.data());
+      gemm_diff = std::max(gemm_diff, max_abs_diff(expected_out, out));
+    }
+    all_passed = report_check("P×V, масштаб в эпилоге, n = " +
+                                  std::to_string(n),
+                              gemm_diff) &&
+                 all_passed;
+  }
+  return all_passed;
+}
+
+// Потоковое состояние Softmax против эталона в double по всей строке
+bool test_softmax_state() {
+  std::cout << "\n=== Потоковое состояние Softmax ===\n";
+  bool all_passed = true;
+
+  for (std::size_t n : {1, 9, 1000, 5000}) {
+    auto row = make_values(n, InputDistribution::kWideRange);
+    for (float& x : row) x += 60.0f;  // логиты в [-60, 60)
+    if (n > 1) row[n / 2] = -INFINITY;
+    const double max = *std::max_element(row.begin(), row.end());
+    double sum = 0.0;
+    for (float x : row) sum += std::exp(x - max);
+    const double lse = max + std::log(sum);
+
+    SoftmaxState by_one;
+    for (float x : row) by_one.append(x);
+    SoftmaxState chunked;
+    chunked.append(row.data(), n / 3);
+    chunked.append(row.data() + n / 3, n - n / 3);
+    // Куски в обратном порядке: слияние не зависит от порядка
+    SoftmaxState reversed;
+    for (std::size_t end = n; end > 0;) {
+      const std::size_t begin = end > 37 ? end - 37 : 0;
+      SoftmaxState piece;
+      piece.append(row.data() + begin, end - begin, false);
+      reversed.merge(piece);
+      end = begin;
+    }
+
+    const std::pair<std::string, SoftmaxState> states[] = {
+        {"по одному", by_one},
+        {"куски", chunked},
+        {"слияние в обратном порядке", reversed},
+        {"потоки", softmax_state(row.data(), n, SoftmaxMethod::kOpenMPSimd)},
+        {"потоки, скалярно",
+         softmax_state(row.data(), n, SoftmaxMethod::kOpenMP)}};
+    for (const auto& [name, state] : states) {
+      std::vector<float> probs(n);
+      state.materialize(row.data(), 0, n, probs.data());
+      float diff = static_cast<float>(std::abs(state.log_normalizer() - lse) /
+                                      std::max(1.0, std::abs(lse)));
+      if (state.count != n) diff = 1.0f;
+      for (std::size_t j = 0; j < n; ++j) {
+        diff = std::max(diff, static_cast<float>(std::abs(
+                                  probs[j] - std::exp(row[j] - lse))));
+      }
+      // Диапазон [begin, end) совпадает с частью полной строки
+      if (n > 8) {
+        std::vector<float> part(5);
+        state.materialize(row.data(), 3, 8, part.data(), false);
+        for (std::size_t j = 0; j < 5; ++j) {
+          diff = std::max(diff, std::abs(part[j] - probs[3 + j]));
+        }
+      }
+      all_passed = report_check("n = " + std::to_string(n) + ", " + name,
+                                diff) &&
+                   all_passed;
+    }
+  }
+
+  // Пустое состояние и строка из -inf - равномерное распределение
+  SoftmaxState empty;
+  SoftmaxState infinite;
+  for (int j = 0; j < 4; ++j) infinite.append(-INFINITY);
+  empty.merge(infinite);
+  const float uniform_diff = std::abs(empty.probability(-INFINITY) - 0.25f);
+  all_passed = report_check("Строка из -inf", uniform_diff) && all_passed;
+  return all_passed;
+}
+
+// Смещения CSR для сегментов заданных длин (со сдвигом начала base)
+std::vector<std::size_t> make_offsets(const std::vector<std::size_t>& lengths,
+                                      std::size_t base = 0) {
+  std::vector<std::size_t> offsets(lengths.size() + 1, base);
+  for (std::size_t s = 0; s < lengths.size(); ++s) {
+    offsets[s + 1] = offsets[s] + lengths[s];
+  }
+  return offsets;
+}
+
+// Softmax по CSR сегментам против SoftmaxRow каждого сегмента
+bool test_segmented_softmax() {
+  std::cout << "\n=== Softmax по сегментам (CSR) ===\n";
+  bool all_passed = true;
+
+  const std::vector<std::vector<std::size_t>> cases = {
+      {},
+      {0, 0},
+      {1, 2, 3, 4, 5, 6, 7, 0, 1, 3},
+      {8, 9, 100, 7, 0, 1000, 2},
+      {kSegmentParallel, 5, kSegmentParallel + 13, 3, 1, 200}};
+  for (const auto& lengths : cases) {
+    // Смещения начинаются не с нуля: сегменты - часть большего буфера
+    const auto offsets = make_offsets(lengths, 3);
+    // Логиты в [0, 4) и каждый седьмой около -200 (exp опустошается)
+    auto values = make_values(offsets.back());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      values[i] = i % 7 == 0 ? values[i] - 200.0f : values[i] * 4.0f;
+    }
+    std::vector<float> expected(values.size(), -1.0f);
+    for (std::size_t s = 0; s < lengths.size(); ++s) {
+      SoftmaxRow(&values[offsets[s]], &expected[offsets[s]], lengths[s]);
+    }
+
+    float diff = 0.0f;
+    for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                        SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+      std::vector<float> output(values.size(), -1.0f);
+      softmax_segments(values.data(), output.data(), offsets.data(),
+                       lengths.size(), method);
+      diff = std::max(diff, max_abs_diff(expected, output));
+    }
+    all_passed = report_check(std::to_string(lengths.size()) +
+                                  " сегментов, " +
+                                  std::to_string(offsets.back() - 3) +
+                                  " элементов",
+                              diff) &&
+                 all_passed;
+  }
+
+  // Сегмент с опустошённой суммой - равномерное распределение
+  const std::vector<float> tiny = {-200.0f, -200.0f, -200.0f, -200.0f,
+                                   -200.0f};
+  const std::vector<std::size_t> offsets = {0, 2, 5};
+  std::vector<float> output(tiny.size());
+  softmax_segments(tiny.data(), output.data(), offsets.data(), 2,
+                   SoftmaxMethod::kSimd);
+  const float uniform_diff =
+      max_abs_diff({0.5f, 0.5f, 1.0f / 3, 1.0f / 3, 1.0f / 3}, output);
+  all_passed = report_check("Нулевая сумма", uniform_diff) && all_passed;
+
+  bool thrown = false;
+  const std::vector<std::size_t> bad = {0, 4, 2};
+  try {
+    softmax_segments(tiny.data(), output.data(), bad.data(), 2,
+                     SoftmaxMethod::kSimd);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  all_passed = report_check("Убывающие смещения", thrown ? 0.0f : 1.0f) &&
+               all_passed;
+  return all_passed;
+}
+
+// Двухуровневый Softmax против определения в double
+bool test_hierarchical_softmax() {
+  std::cout << "\n=== Двухуровневый Softmax ===\n";
+  bool all_passed = true;
+
+  // Кластеры разного размера (0..2 крупнее остальных), классы перемешаны
+  const std::size_t vocab = 1000, clusters = 33, dim = 19, tokens = 7;
+  std::vector<std::size_t> assignment(vocab);
+  for (std::size_t v = 0; v < vocab; ++v) {
+    assignment[v] = v < 400 ? v % 3 : (v * 7) % clusters;
+  }
+  const auto table = ClusterTable::from_assignment(assignment, clusters);
+  auto cluster_w = make_values(clusters * dim);
+  auto class_w = make_values(vocab * dim, InputDistribution::kWideRange);
+  for (float& w : class_w) w /= 10.0f;
+  const auto hidden = make_values(tokens * dim);
+  const TensorShape hidden_shape({tokens, dim});
+  const HierarchicalSoftmax model(
+      make_view(cluster_w, TensorShape({clusters, dim})),
+      make_view(class_w, TensorShape({vocab, dim})), table);
+
+  // Эталон: log p(v) для всех классов каждого токена
+  std::vector<double> expected(tokens * vocab);
+  for (std::size_t t = 0; t < tokens; ++t) {
+    const auto dot = [&](const float* w) {
+      double sum = 0.0;
+      for (std::size_t i = 0; i < dim; ++i) sum += w[i] * hidden[t * dim + i];
+      return sum;
+    };
+    std::vector<double> top(clusters), inner(vocab);
+    double top_sum = 0.0;
+    for (std::size_t c = 0; c < clusters; ++c) {
+      top[c] = dot(&cluster_w[c * dim]);
+      top_sum += std::exp(top[c]);
+    }
+    std::vector<double> inner_sum(clusters);
+    for (std::size_t v = 0; v < vocab; ++v) {
+      inner[v] = dot(&class_w[v * dim]);
+      inner_sum[assignment[v]] += std::exp(inner[v]);
+    }
+    for (std::size_t v = 0; v < vocab; ++v) {
+      const std::size_t c = assignment[v];
+      expected[t * vocab + v] = top[c] - std::log(top_sum) + inner[v] -
+                                std::log(inner_sum[c]);
+    }
+  }
+
+  std::vector<std::size_t> targets(tokens);
+  for (std::size_t t = 0; t < tokens; ++t) targets[t] = (t * 389) % vocab;
+  for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                      SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+    const std::string suffix =
+        ", метод " + std::to_string(static_cast<int>(method));
+    std::vector<float> log_probs(tokens);
+    hierarchical_log_prob(model, make_view(hidden, hidden_shape),
+                          targets.data(), log_probs.data(), method);
+    float diff = 0.0f;
+    for (std::size_t t = 0; t < tokens; ++t) {
+      diff = std::max(diff, static_cast<float>(std::abs(
+                                log_probs[t] -
+                                expected[t * vocab + targets[t]])));
+    }
+    all_passed = report_check("log p(target)" + suffix, diff, 1e-4f) &&
+                 all_passed;
+
+    std::vector<float> probs(tokens * vocab);
+    hierarchical_softmax_full(model, make_view(hidden, hidden_shape),
+                              make_view(probs, TensorShape({tokens, vocab})),
+                              method);
+    float full_diff = 0.0f;
+    for (std::size_t t = 0; t < tokens; ++t) {
+      double sum = 0.0;
+      for (std::size_t v = 0; v < vocab; ++v) {
+        sum += probs[t * vocab + v];
+        full_diff = std::max(
+            full_diff, static_cast<float>(std::abs(
+                           probs[t * vocab + v] -
+                           std::exp(expected[t * vocab + v]))));
+      }
+      full_diff = std::max(full_diff, static_cast<float>(std::abs(sum - 1.0)));
+    }
+    all_passed = report_check("Полное распределение" + suffix, full_diff) &&
+                 all_passed;
+  }
+
+  std::size_t thrown = 0;
+  try {
+    ClusterTable::from_assignment({0, 3}, 3);
+  } catch (const std::invalid_argument&) {
+    ++thrown;
+  }
+  try {
+    HierarchicalSoftmax(make_view(cluster_w, TensorShape({3, dim})),
+                        make_view(class_w, TensorShape({2, dim})),
+                        ClusterTable::from_assignment({0, 2}, 3));
+  } catch (const std::invalid_argument&) {
+    ++thrown;
+  }
+  all_passed = report_check("Кластер вне диапазона и пустой кластер",
+                            thrown == 2 ? 0.0f : 1.0f) &&
+               all_passed;
+  return all_passed;
+}
+
+// Эталоны разреженных отображений в double: sparsemax - по сортировке,
+// entmax-1.5 - делением пополам до предела точности double
+std::vector<float> reference_sparse_row(const float* row, std::size_t n,
+                                        SparseMapping mapping) {
+  std::vector<double> z(row, row + n);
+  const double scale = mapping == SparseMapping::kSparsemax ? 1.0 : 0.5;
+  for (double& v : z) v *= scale;
+  double tau = 0.0;
+  if (mapping == SparseMapping::kSparsemax) {
+    std::vector<double> sorted = z;
+    std::sort(sorted.begin(), sorted.end(), std::greater<double>());
+    double prefix = 0.0;
+    for (std::size_t k = 0; k < n; ++k) {
+      prefix += sorted[k];
+      const double candidate = (prefix - 1.0) / (k + 1);
+      if (sorted[k] > candidate) tau = candidate;
+    }
+  } else {
+    const double max = *std::max_element(z.begin(), z.end());
+    double lo = max - 1.0, hi = max;
+    for (int iter = 0; iter < 200; ++iter) {
+      tau = 0.5 * (lo + hi);
+      double sum = 0.0;
+      for (double v : z) sum += v > tau ? (v - tau) * (v - tau) : 0.0;
+      (sum >= 1.0 ? lo : hi) = tau;
+    }
+  }
+  std::vector<float> out(n);
+  for (std::size_t j = 0; j < n; ++j) {
+    const double p = std::max(z[j] - tau, 0.0);
+    out[j] = static_cast<float>(mapping == SparseMapping::kSparsemax ? p
+                                                                     : p * p);
+  }
+  return out;
+}
+
+// Sparsemax и entmax-1.5 против эталонов; масштаб логитов задаёт
+// разреженность (при x в [0, 20) носитель - несколько элементов)
+bool test_sparse_mappings() {
+  std::cout << "\n=== Sparsemax и entmax-1.5 ===\n";
+  bool all_passed = true;
+
+  for (auto mapping : {SparseMapping::kSparsemax, SparseMapping::kEntmax15}) {
+    const std::string name =
+        mapping == SparseMapping::kSparsemax ? "sparsemax" : "entmax-1.5";
+    for (std::size_t n : {1, 7, 8, 33, 1000}) {
+      for (float scale : {1.0f, 4.0f, 20.0f}) {
+        const std::size_t rows = 5;
+        auto logits = make_values(rows * n);
+        for (float& x : logits) x *= scale;
+        // Строка из одинаковых значений и строка из -inf
+        std::fill(logits.begin(), logits.begin() + n, 3.0f);
+        std::fill(logits.begin() + n, logits.begin() + 2 * n, -INFINITY);
+        std::vector<float> expected;
+        for (std::size_t r = 0; r < rows; ++r) {
+          auto row = r == 1 ? std::vector<float>(n, 1.0f / n)
+                            : reference_sparse_row(&logits[r * n], n, mapping);
+          expected.insert(expected.end(), row.begin(), row.end());
+        }
+
+        const TensorShape shape({rows, n});
+        float diff = 0.0f, sum_diff = 0.0f;
+        for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                            SoftmaxMethod::kSimd,
+                            SoftmaxMethod::kOpenMPSimd}) {
+          std::vector<float> out(rows * n);
+          sparse_last_axis(make_view(logits, shape), make_view(out, shape),
+                           mapping, method);
+          diff = std::max(diff, max_abs_diff(expected, out));
+          for (std::size_t r = 0; r < rows; ++r) {
+            double sum = 0.0;
+            for (std::size_t j = 0; j < n; ++j) sum += out[r * n + j];
+            sum_diff =
+                std::max(sum_diff, static_cast<float>(std::abs(sum - 1.0)));
+          }
+        }
+        all_passed = report_check(name + ", n = " + std::to_string(n) +
+                                      ", x * " + std::to_string(int(scale)),
+                                  std::max(diff, sum_diff)) &&
+                     all_passed;
+      }
+    }
+
+    // Ведущие оси с зазором: строки по шагам, без сворачивания
+    const std::size_t n = 37;
+    const TensorShape strided({2, 3, n}, {5 * n, n, 1});
+    const auto logits = make_values(10 * n);
+    std::vector<float> out(10 * n, -1.0f);
+    sparse_last_axis(make_view(logits, strided), make_view(out, strided),
+                     mapping, SoftmaxMethod::kOpenMPSimd);
+    float diff = 0.0f;
+    for (std::size_t r = 0; r < 6; ++r) {
+      const std::size_t offset = strided.offset_of(r, 2);
+      const auto expected = reference_sparse_row(&logits[offset], n, mapping);
+      const std::vector<float> got(out.begin() + offset,
+                                   out.begin() + offset + n);
+      diff = std::max(diff, max_abs_diff(expected, got));
+    }
+    all_passed = report_check(name + ", строки с зазором", diff) && all_passed;
+  }
+
+  // Строки, на которых носитель сжимается медленно: геометрическая и
+  // равномерная лестницы значений в [max - 1, max]. Порог ищется делением
+  // пополам - проходов не больше kSparseMaxPasses + 1 при любой длине
+  const std::size_t n = 4096;
+  const std::pair<const char*, std::vector<float>> ladders[] = {
+      {"геометрическая", [&] {
+         std::vector<float> row(n);
+         for (std::size_t j = 0; j < n; ++j) {
+           row[j] = static_cast<float>(std::expm1(-0.002 * j));
+         }
+         return row;
+       }()},
+      {"равномерная", [&] {
+         std::vector<float> row(n);
+         for (std::size_t j = 0; j < n; ++j) row[j] = -float(j) / n;
+         return row;
+       }()},
+  };
+  for (const auto& [ladder, row] : ladders) {
+    const auto expected =
+        reference_sparse_row(row.data(), n, SparseMapping::kSparsemax);
+    float diff = 0.0f;
+    int passes = 0;
+    for (bool simd : {false, true}) {
+      std::vector<float> out(n);
+      SparsemaxRow(row.data(), out.data(), n, simd);
+      diff = std::max(diff, max_abs_diff(expected, out));
+      passes = std::max(
+          passes, SparsemaxThreshold(row.data(), n, 0.0f, simd).passes);
+    }
+    if (passes > kSparseMaxPasses + 1) diff = 1.0f;
+    all_passed = report_check(std::string("sparsemax, ") + ladder +
+                                  " лестница (" + std::to_string(passes) +
+                                  " проходов)",
+                              diff) &&
+                 all_passed;
+  }
+  return all_passed;
+}
+
+// LayerNorm и RMSNorm на каркасе row_reduce.h против эталона в double;
+// сдвиг +1000 проверяет устойчивость дисперсии при большом среднем
+bool test_row_normalization() {
+  std::cout << "\n=== LayerNorm и RMSNorm ===\n";
+  bool all_passed = true;
+  const float eps = 1e-5f;
+
+  for (std::size_t n : {1, 7, 8, 33, 1000}) {
+    for (float offset : {0.0f, 1000.0f}) {
+      const std::size_t rows = 5;
+      auto x = make_values(rows * n);
+      for (float& v : x) v = 4.0f * v - 2.0f + offset;
+      auto gamma = make_values(n), beta = make_values(n);
+      for (float& g : gamma) g += 0.5f;
+
+      std::vector<float> expected_ln(rows * n), expected_rms(rows * n);
+      for (std::size_t r = 0; r < rows; ++r) {
+        const float* row = &x[r * n];
+        double mean = 0.0, square = 0.0;
+        for (std::size_t j = 0; j < n; ++j) mean += row[j];
+        mean /= n;
+        double var = 0.0;
+        for (std::size_t j = 0; j < n; ++j) {
+          var += (row[j] - mean) * (row[j] - mean);
+          square += static_cast<double>(row[j]) * row[j];
+        }
+        const double rstd = 1.0 / std::sqrt(var / n + eps);
+        const double rms = 1.0 / std::sqrt(square / n + eps);
+        for (std::size_t j = 0; j < n; ++j) {
+          expected_ln[r * n + j] =
+              static_cast<float>((row[j] - mean) * rstd * gamma[j] + beta[j]);
+          expected_rms[r * n + j] = static_cast<float>(row[j] * rms * gamma[j]);
+        }
+      }
+
+      const TensorShape shape({rows, n});
+      float ln_diff = 0.0f, rms_diff = 0.0f;
+      for (auto method : {SoftmaxMethod::kSequential, SoftmaxMethod::kOpenMP,
+                          SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+        std::vector<float> out(rows * n);
+        layer_norm(make_view(x, shape), make_view(out, shape), gamma.data(),
+                   beta.data(), eps, method);
+        ln_diff = std::max(ln_diff, max_abs_diff(expected_ln, out));
+        rms_norm(make_view(x, shape), make_view(out, shape), gamma.data(), eps,
+                 method);
+        rms_diff = std::max(rms_diff, max_abs_diff(expected_rms, out));
+      }
+      const std::string suffix = ", n = " + std::to_string(n) + ", x + " +
+                                 std::to_string(static_cast<int>(offset));
+      all_passed = report_check("LayerNorm" + suffix, ln_diff) && all_passed;
+      all_passed = report_check("RMSNorm" + suffix, rms_diff) && all_passed;
+    }
+  }
+
+  // Без gamma и beta: среднее 0 и дисперсия 1 в каждой строке
+  const std::size_t n = 129;
+  const auto x = make_values(3 * n);
+  std::vector<float> out(3 * n);
+  layer_norm(make_view(x, TensorShape({3, n})),
+             make_view(out, TensorShape({3, n})), nullptr, nullptr, 0.0f,
+             SoftmaxMethod::kOpenMPSimd);
+  float moments = 0.0f;
+  for (std::size_t r = 0; r < 3; ++r) {
+    double mean = 0.0, square = 0.0;
+    for (std::size_t j = 0; j < n; ++j) {
+      mean += out[r * n + j];
+      square += static_cast<double>(out[r * n + j]) * out[r * n + j];
+    }
+    moments = std::max({moments, static_cast<float>(std::abs(mean / n)),
+                        static_cast<float>(std::abs(square / n - 1.0))});
+  }
+  all_passed =
+      report_check("LayerNorm без gamma/beta: моменты", moments) && all_passed;
+  return all_passed;
+}
+
+// Ядра фиксированной длины против общего SoftmaxRowSimd и выбор по таблице
+bool test_fixed_length_kernels() {
+  std::cout << "\n=== Softmax ядра фиксированной длины ===\n";
+  bool all_passed = true;
+
+  for (const FixedSoftmaxEntry& entry : kFixedSoftmaxKernels) {
+    const std::size_t n = entry.cols;
+    const std::size_t rows = 3;
+    auto logits = make_values(rows * n, InputDistribution::kWideRange);
+    // Строка с нулевой суммой экспонент: результат 1/n, как в общем ядре
+    std::fill(logits.begin(), logits.begin() + n, -1000.0f);
+    std::vector<float> expected(rows * n), got(rows * n);
+    for (std::size_t r = 0; r < rows; ++r) {
+      SoftmaxRowSimd(&logits[r * n], &expected[r * n], n);
+      entry.kernel(&logits[r * n], &got[r * n], n);
+    }
+    float diff = max_abs_diff(expected, got);
+    // Выбор в softmax_rows: весь вызов против скалярного пути
+    const auto input = make_values(16 * n);
+    std::vector<float> sequential(16 * n), fixed(16 * n);
+    softmax_rows(input.data(), n, sequential.data(), n, 16, n,
+                 SoftmaxMethod::kSequential);
+    softmax_rows(input.data(), n, fixed.data(), n, 16, n,
+                 SoftmaxMethod::kOpenMPSimd);
+    diff = std::max(diff, max_abs_diff(sequential, fixed));
+    all_passed =
+        report_check("n = " + std::to_string(n), diff) && all_passed;
+  }
+
+  const bool dispatch =
+      softmax_row_kernel(128, true) == SoftmaxRowKernel{SoftmaxRowFixed<128>} &&
+      softmax_row_kernel(100, true) == SoftmaxRowKernel{SoftmaxRowSimd} &&
+      softmax_row_kernel(128, false) == SoftmaxRowKernel{SoftmaxRow} &&
+      fixed_softmax_row_kernel(4095) == nullptr;
+  all_passed = report_check("Выбор ядра по длине", dispatch ? 0.0f : 1.0f) &&
+               all_passed;
+  return all_passed;
+}
+
+// Ядра над Vec<float, W> на всех доступных ширинах
+bool test_portable_vec() {
+  std::cout << "\n=== Переносимый вектор Vec<float, W> ===\n";
+  bool all_passed = true;
+
+  // Экспонента на всех ширинах против std::exp в double на всём диапазоне
+  // нормальных результатов (относительная ошибка)
+  auto x = make_values(4096);
+  for (auto& v : x) v = 174.0f * v - 87.0f;
+  float exp_diff = 0.0f;
+  const auto relative = [](float arg, float got) {
+    const double expected = std::exp(static_cast<double>(arg));
+    return static_cast<float>(std::abs(expected - got) / expected);
+  };
+  for (std::size_t i = 0; i < x.size(); i += 16) {
+    alignas(64) float ported[16], narrow[16];
+    vexp(Vec<float, 8>::load(&x[i])).store(ported);
+    vexp(Vec<float, 8>::load(&x[i + 8])).store(ported + 8);
+    for (std::size_t k = 0; k < 16; k += 4) {
+      vexp(Vec<float, 4>::load(&x[i + k])).store(narrow + k);
+    }
+#ifdef __AVX512F__
+    alignas(64) float wide[16];
+    vexp(Vec<float, 16>::load(&x[i])).store(wide);
+#endif
+    for (std::size_t k = 0; k < 16; ++k) {
+      exp_diff = std::max(exp_diff, relative(x[i + k], ported[k]));
+      exp_diff = std::max(exp_diff, relative(x[i + k], narrow[k]));
+#ifdef __AVX512F__
+      exp_diff = std::max(exp_diff, relative(x[i + k], wide[k]));
+#endif
+    }
+  }
+  all_passed = report_check("vexp против std::exp (относительно)", exp_diff,
+                            1e-6f) &&
+               all_passed;
+
+  // Softmax строки: хвосты всех длин, нулевая сумма
+  float softmax_diff = 0.0f, softmax_bitwise = 0.0f;
+  for (std::size_t n : {1u, 3u, 4u, 7u, 8u, 13u, 17u, 64u, 1000u}) {
+    auto row = make_values(n, InputDistribution::kWideRange);
+    if (n == 17) std::fill(row.begin(), row.end(), -1000.0f);
+    std::vector<float> hand(n), native(n), ported(n), narrow(n);
+    SoftmaxRowSimd(row.data(), hand.data(), n);
+    SoftmaxRowVec<kVecLanes>(row.data(), native.data(), n);
+    SoftmaxRowVec<8>(row.data(), ported.data(), n);
+    SoftmaxRowVec<4>(row.data(), narrow.data(), n);
+    softmax_bitwise = std::max(softmax_bitwise, max_abs_diff(hand, native));
+    softmax_diff = std::max(softmax_diff, max_abs_diff(hand, ported));
+    softmax_diff = std::max(softmax_diff, max_abs_diff(hand, narrow));
+#ifdef __AVX512F__
+    std::vector<float> wide(n);
+    SoftmaxRowVec<16>(row.data(), wide.data(), n);
+    softmax_diff = std::max(softmax_diff, max_abs_diff(hand, wide));
+#endif
+  }
+  all_passed = report_check("SoftmaxRowSimd = SoftmaxRowVec<kVecLanes> "
+                            "(побитово)",
+                            softmax_bitwise,
+                            std::numeric_limits<float>::min()) &&
+               all_passed;
+  all_passed = report_check("SoftmaxRowVec на других ширинах", softmax_diff) &&
+               all_passed;
+
+  // GEMM: края, не кратные блоку 4×(2·W), и эпилог row_scale
+  const std::size_t m = 37, k = 29, n = 45;
+  const auto a = make_values(m * k);
+  const auto b = make_values(k * n);
+  const auto scale = make_values(m);
+  const TensorShape a_shape({m, k}), b_shape({k, n}), c_shape({m, n});
+  std::vector<float> expected(m * n);
+  gemm(make_view(a, a_shape), make_view(b, b_shape),
+       make_view(expected, c_shape), GemmMethod::kSequential, scale.data());
+  const auto run_width = [&](auto width) {
+    std::vector<float> c(m * n);
+    gemm_vec<decltype(width)::value>(make_view(a, a_shape),
+                                     make_view(b, b_shape),
+                                     make_view(c, c_shape),
+                                     GemmMethod::kOpenMPSimd, scale.data());
+    return max_abs_diff(expected, c);
+  };
+  float gemm_diff =
+      std::max(run_width(std::integral_constant<std::size_t, 4>{}),
+               run_width(std::integral_constant<std::size_t, 8>{}));
+#ifdef __AVX512F__
+  gemm_diff =
+      std::max(gemm_diff, run_width(std::integral_constant<std::size_t, 16>{}));
+#endif
+  all_passed =
+      report_check("GemmMicroKernel<W> с эпилогом", gemm_diff) && all_passed;
+
+  const float max_diff =
+      std::abs(vreduce_max(Vec<float, 8>::load(&x[0])) -
+               *std::max_element(x.begin(), x.begin() + 8)) +
+      std::abs(vreduce_max(Vec<float, 4>::load(&x[0])) -
+               *std::max_element(x.begin(), x.begin() + 4));
+  all_passed = report_check("vreduce_max", max_diff) && all_passed;
+  return all_passed;
+}
+
+// Максимальная относительная ошибка Softmax строки против суммы в double
+float softmax_relative_error(const std::vector<float>& logits,
+                             const std::vector<float>& y) {
+  double sum = 0.0;
+  for (float x : logits) sum += std::exp(static_cast<double>(x));
+  double worst = 0.0;
+  for (std::size_t j = 0; j < logits.size(); ++j) {
+    const double expected = std::exp(static_cast<double>(logits[j])) / sum;
+    worst = std::max(worst, std::abs(y[j] - expected) / expected);
+  }
+  return static_cast<float>(worst);
+}
+
+// Длинные строки: попарная сумма держит ошибку на уровне O(log n)·eps
+bool test_pairwise_summation() {
+  std::cout << "\n=== Попарная сумма на длинных строках ===\n";
+  bool all_passed = true;
+
+  // Блоки складываются как двоичный счётчик: проверка переносов на
+  // числе блоков, не равном степени двойки
+  using V = Vec<float, 8>;
+  PairwiseSum<V, 2> counter;
+  for (int b = 1; b <= 1000; ++b) {
+    const V block[2] = {V::broadcast(1.0f),
+                        V::broadcast(static_cast<float>(b))};
+    counter.push(block);
+  }
+  V totals[2];
+  counter.total(totals);
+  const float count_diff = std::abs(vreduce_add(totals[0]) - 8000.0f) +
+                           std::abs(vreduce_add(totals[1]) - 8.0f * 500500.0f);
+  all_passed = report_check("Перенос между уровнями", count_diff) &&
+               all_passed;
+
+  // Строка в 4M значений: последовательная сумма по дорожкам (2^19
+  // слагаемых) теряла ~1e-4 относительной точности
+  const std::size_t n = std::size_t{1} << 22;
+  const auto logits = make_values(n);
+  std::vector<float> y(n);
+  SoftmaxRowSimd(logits.data(), y.data(), n);
+  all_passed = report_check("SoftmaxRowSimd, n = 2^22 (относительно)",
+                            softmax_relative_error(logits, y), 2e-6f) &&
+               all_passed;
+  SoftmaxRowVec<4>(logits.data(), y.data(), n);
+  all_passed = report_check("SoftmaxRowVec<4>, n = 2^22 (относительно)",
+                            softmax_relative_error(logits, y), 2e-6f) &&
+               all_passed;
+
+  // Огромный сегмент: части потоков и куски воспроизводимого режима
+  const std::size_t offsets[2] = {0, n};
+  softmax_segments(logits.data(), y.data(), offsets, 1,
+                   SoftmaxMethod::kOpenMPSimd);
+  all_passed = report_check("Огромный сегмент, n = 2^22 (относительно)",
+                            softmax_relative_error(logits, y), 2e-6f) &&
+               all_passed;
+  softmax_segments(logits.data(), y.data(), offsets, 1, SoftmaxMethod::kSimd,
+                   DenormalMode::kPreserve, ReductionOrder::kReproducible);
+  all_passed =
+      report_check("Огромный сегмент, воспроизводимо (относительно)",
+                   softmax_relative_error(logits, y), 2e-6f) &&
+      all_passed;
+
+  // log Σ exp за одно чтение и состояние Softmax: блоки дорожек и куски
+  // состояния тоже складываются попарно
+  double exp_sum = 0.0;
+  for (float x : logits) exp_sum += std::exp(static_cast<double>(x));
+  const double lse = std::log(exp_sum);
+  all_passed =
+      report_check("LogitStatsRowSimd, n = 2^22",
+                   static_cast<float>(std::abs(
+                       LogitStatsRowSimd(logits.data(), n).lse - lse)),
+                   2e-6f) &&
+      all_passed;
+  for (ReductionOrder order :
+       {ReductionOrder::kFast, ReductionOrder::kReproducible}) {
+    const SoftmaxState state =
+        softmax_state(logits.data(), n, SoftmaxMethod::kOpenMPSimd, order);
+    all_passed =
+        report_check(order == ReductionOrder::kFast
+                         ? "softmax_state, n = 2^22"
+                         : "softmax_state, n = 2^22, воспроизводимо",
+                     static_cast<float>(
+                         std::abs(state.log_normalizer() - lse)),
+                     2e-6f) &&
+        all_passed;
+  }
+
+  // Ядра, которые сами нормируют строку или хранят её не во float, -
+  // через ту же попарную сумму с хвостом под маской
+  const TensorShape row_shape({1, n});
+  const auto halves = convert_from_float<Half>(logits);
+  softmax_rows(halves.data(), n, y.data(), n, 1, n, SoftmaxMethod::kSimd);
+  all_passed =
+      report_check("Softmax fp16 -> float, n = 2^22 (относительно)",
+                   softmax_relative_error(convert_to_float(halves), y),
+                   2e-6f) &&
+      all_passed;
+  float row_scale = 0.0f;
+  softmax_unnormalized(make_view(logits, row_shape), make_view(y, row_shape),
+                       &row_scale, SoftmaxMethod::kSimd);
+  apply_row_scale(make_view(y, row_shape), &row_scale, SoftmaxMethod::kSimd);
+  all_passed = report_check("softmax_unnormalized, n = 2^22 (относительно)",
+                            softmax_relative_error(logits, y), 2e-6f) &&
+               all_passed;
+  softmax_dropout(make_view(logits, row_shape), make_view(y, row_shape),
+                  nullptr, Dropout(0.0f, 1), SoftmaxMethod::kSimd);
+  all_passed = report_check("softmax_dropout, rate 0, n = 2^22 (относительно)",
+                            softmax_relative_error(logits, y), 2e-6f) &&
+               all_passed;
+  std::vector<std::int32_t> quantized(n);
+  std::vector<float> dequantized(n);
+  for (std::size_t j = 0; j < n; ++j) {
+    quantized[j] = static_cast<std::int32_t>(std::lround(logits[j] * 1024.0f));
+    dequantized[j] = static_cast<float>(quantized[j]) / 1024.0f;
+  }
+  softmax_quantized(make_view(std::as_const(quantized), row_shape),
+                    1.0f / 1024.0f, make_view(y, row_shape),
+                    SoftmaxMethod::kSimd);
+  all_passed = report_check("softmax_quantized, n = 2^22 (относительно)",
+                            softmax_relative_error(dequantized, y), 2e-6f) &&
+               all_passed;
+
+  // Softmax по длинной оси 0: суммы столбцов полос - блоками
+  const std::size_t columns = 8;
+  softmax_axis(make_view(logits, TensorShape({n / columns, columns})),
+               make_view(y, TensorShape({n / columns, columns})), 0,
+               SoftmaxMethod::kSimd);
+  float axis_error = 0.0f;
+  for (std::size_t c = 0; c < columns; ++c) {
+    std::vector<float> column(n / columns), column_y(n / columns);
+    for (std::size_t a = 0; a < n / columns; ++a) {
+      column[a] = logits[a * columns + c];
+      column_y[a] = y[a * columns + c];
+    }
+    axis_error = std::max(axis_error, softmax_relative_error(column, column_y));
+  }
+  all_passed = report_check("softmax_axis, ось 2^19 (относительно)",
+                            axis_error, 2e-6f) &&
+               all_passed;
+
+  // Сумма квадратов в RMSNorm идёт через тот же каркас
+  double sum_sq = 0.0;
+  for (float x : logits) sum_sq += static_cast<double>(x) * x;
+  const double rstd = 1.0 / std::sqrt(sum_sq / n + 1e-6);
+  rms_norm(make_view(logits, TensorShape({1, n})),
+           make_view(y, TensorShape({1, n})), nullptr, 1e-6f,
+           SoftmaxMethod::kSimd);
+  double rms_diff = 0.0;
+  for (std::size_t j = 0; j < n; ++j) {
+    const double expected = logits[j] * rstd;
+    if (expected > 1e-3) {
+      rms_diff = std::max(rms_diff, std::abs(y[j] - expected) / expected);
+    }
+  }
+  all_passed = report_check("RMSNorm, n = 2^22 (относительно)",
+                            static_cast<float>(rms_diff), 2e-6f) &&
+               all_passed;
+  return all_passed;
+}
+
+// Воспроизводимый режим: побитово один результат при любом числе потоков
+// и совпадение параллельных методов с однопоточными
+bool test_reproducible_reductions() {
+  std::cout << "\n=== Воспроизводимые редукции ===\n";
+  bool all_passed = true;
+  const int saved_threads = omp_get_max_threads();
+  const float bitwise = std::numeric_limits<float>::min();
+  const std::pair<SoftmaxMethod, SoftmaxMethod> pairs[] = {
+      {SoftmaxMethod::kOpenMPSimd, SoftmaxMethod::kSimd},
+      {SoftmaxMethod::kOpenMP, SoftmaxMethod::kSequential}};
+
+  // Огромный сегмент не кратен куску; соседи идут обычным путём
+  const std::vector<std::size_t> lengths = {5, 3 * kSegmentParallel + 77, 40};
+  const auto offsets = make_offsets(lengths);
+  auto values = make_values(offsets.back());
+  for (auto& v : values) v *= 8.0f;
+  const auto row = make_values(100 * kStateChunk + 5);
+  const std::size_t rows = 257, cols = 100;
+  const auto logits = make_values(rows * cols);
+  const TensorShape shape({rows, cols});
+  std::vector<std::size_t> targets(rows);
+  for (std::size_t r = 0; r < rows; ++r) targets[r] = r * 37 % cols;
+
+  float segment_diff = 0.0f, state_diff = 0.0f, loss_diff = 0.0f;
+  for (const auto& [method, single] : pairs) {
+    std::vector<float> expected(values.size());
+    softmax_segments(values.data(), expected.data(), offsets.data(),
+                     lengths.size(), single, DenormalMode::kPreserve,
+                     ReductionOrder::kReproducible);
+    const SoftmaxState expected_state = softmax_state(
+        row.data(), row.size(), single, ReductionOrder::kReproducible);
+    const float expected_loss = softmax_cross_entropy(
+        make_view(logits, shape), targets.data(), 0.1f, nullptr,
+        {}, single, DenormalMode::kPreserve,
+        ReductionOrder::kReproducible);
+
+    for (int threads : {1, 2, 3, 4, 7}) {
+      omp_set_num_threads(threads);
+      std::vector<float> output(values.size());
+      softmax_segments(values.data(), output.data(), offsets.data(),
+                       lengths.size(), method, DenormalMode::kPreserve,
+                       ReductionOrder::kReproducible);
+      segment_diff = std::max(segment_diff, max_abs_diff(expected, output));
+
+      const SoftmaxState state = softmax_state(
+          row.data(), row.size(), method, ReductionOrder::kReproducible);
+      state_diff = std::max({state_diff,
+                             std::abs(state.max - expected_state.max),
+                             std::abs(state.sum - expected_state.sum)});
+
+      const float loss = softmax_cross_entropy(
+          make_view(logits, shape), targets.data(), 0.1f, nullptr,
+          {}, method, DenormalMode::kPreserve,
+          ReductionOrder::kReproducible);
+      loss_diff = std::max(loss_diff, std::abs(loss - expected_loss));
+    }
+  }
+  omp_set_num_threads(saved_threads);
+
+  all_passed =
+      report_check("Огромный сегмент CSR", segment_diff, bitwise) && all_passed;
+  all_passed =
+      report_check("Состояние длинной строки", state_diff, bitwise) &&
+      all_passed;
+  all_passed =
+      report_check("Средняя cross-entropy", loss_diff, bitwise) && all_passed;
+  return all_passed;
+}
+
+// Строка сводки флагов для отчёта
+std::string format_health(const HealthSummary& summary) {
+  std::ostringstream out;
+  out << summary.rows << " rows, " << summary.unhealthy << " unhealthy ("
+      << summary.nan << " NaN, " << summary.pos_inf << " +Inf, "
+      << summary.sum_underflow << " sum underflow, " << summary.exp_clamped
+      << " exp clamped)";
+  return out.str();
+}
+
+bool test_row_health() {
+  std::cout << "\n=== Флаги состояния строк ===\n";
+  bool all_passed = true;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float inf = std::numeric_limits<float>::infinity();
+
+  // Длина 37: аномалии и в теле, и в хвосте под маской
+  const std::size_t cols = 37;
+  const std::vector<RowHealth> expected = {
+      kRowHealthy,   kRowNaN,          kRowPosInf,
+      kRowHealthy,   kRowSumUnderflow, kRowExpClamped,
+      kRowNaN | kRowExpClamped,        kRowHealthy};
+  const std::size_t rows = expected.size();
+  auto logits = make_values(rows * cols);
+  logits[1 * cols + 3] = nan;
+  logits[2 * cols + 35] = inf;
+  for (std::size_t j = 0; j < cols; j += 2) logits[3 * cols + j] = -inf;
+  for (std::size_t j = 0; j < cols; ++j) logits[4 * cols + j] = -1000.0f;
+  logits[5 * cols + 36] = 100.0f;
+  logits[6 * cols + 9] = nan;
+  logits[6 * cols + 30] = 95.0f;
+  logits[7 * cols + 20] = kExpClampHigh;
+
+  std::vector<float> reference(rows * cols);
+  softmax_rows(logits.data(), cols, reference.data(), cols, rows, cols,
+               SoftmaxMethod::kSimd);
+  const std::pair<std::string_view, SoftmaxMethod> methods[] = {
+      {"Sequential", SoftmaxMethod::kSequential},
+      {"OpenMP", SoftmaxMethod::kOpenMP},
+      {"SIMD", SoftmaxMethod::kSimd},
+      {"OpenMP + SIMD", SoftmaxMethod::kOpenMPSimd}};
+  for (const auto& [name, method] : methods) {
+    std::vector<float> output(rows * cols);
+    std::vector<RowHealth> health(rows);
+    softmax_rows_health(logits.data(), cols, output.data(), cols, rows, cols,
+                        health.data(), method);
+    const float flag_diff = health == expected ? 0.0f : 1.0f;
+    all_passed = report_check("Флаги строк, " + std::string(name), flag_diff) &&
+                 all_passed;
+
+    // На месте: к свёртке вход уже заменён экспонентами, флаги и выход те же
+    std::vector<float> in_place = logits;
+    std::vector<RowHealth> in_place_health(rows);
+    softmax_rows_health(in_place.data(), cols, in_place.data(), cols, rows,
+                        cols, in_place_health.data(), method);
+    const bool in_place_ok =
+        in_place_health == expected &&
+        std::memcmp(in_place.data(), output.data(),
+                    output.size() * sizeof(float)) == 0;
+    all_passed = report_check("Флаги строк на месте, " + std::string(name),
+                              in_place_ok ? 0.0f : 1.0f) &&
+                 all_passed;
+    if (method != SoftmaxMethod::kSimd) continue;
+
+    // Проверка не меняет выход: побитово как у softmax_rows на здоровых строках
+    float diff = 0.0f;
+    for (std::size_t r = 0; r < rows; ++r) {
+      if (health[r] != kRowHealthy) continue;
+      for (std::size_t j = 0; j < cols; ++j) {
+        const std::size_t k = r * cols + j;
+        diff = std::max(diff, std::abs(output[k] - reference[k]));
+      }
+    }
+    all_passed = report_check("Выход здоровых строк против softmax_rows", diff,
+                              std::numeric_limits<float>::min()) &&
+                 all_passed;
+  }
+
+  // Сводка и API представлений
+  const TensorShape shape({2, rows / 2, cols});
+  std::vector<float> output(rows * cols);
+  std::vector<RowHealth> health(rows);
+  softmax_last_axis_health(make_view(logits, shape), make_view(output, shape),
+                           health.data(), SoftmaxMethod::kOpenMPSimd);
+  const HealthSummary summary = summarize_health(health.data(), rows);
+  std::cout << "Сводка: " << format_health(summary) << "\n";
+  const bool summary_ok = summary.rows == rows && summary.unhealthy == 5 &&
+                          summary.nan == 2 && summary.pos_inf == 1 &&
+                          summary.sum_underflow == 1 &&
+                          summary.exp_clamped == 2;
+  all_passed = report_check("Сводка флагов", summary_ok ? 0.0f : 1.0f) &&
+               all_passed;
+  return all_passed;
+}
+
+// Расхождение двух сводок: 1, если счётчики, гистограмма, top-k или
+// выборка различаются; иначе наибольшее относительное расхождение чисел
+float summary_diff(const TensorSummary& a, const TensorSummary& b) {
+  if (a.dtype != b.dtype || a.count != b.count || a.finite != b.finite ||
+      a.nan != b.nan || a.pos_inf != b.pos_inf || a.neg_inf != b.neg_inf ||
+      a.histogram != b.histogram || a.top_abs != b.top_abs ||
+      a.samples.size() != b.samples.size()) {
+    return 1.0f;
+  }
+  // В выборке бывают NaN: сравниваем побитово
+  for (std::size_t k = 0; k < a.samples.size(); ++k) {
+    if (a.samples[k].first != b.samples[k].first ||
+        std::memcmp(&a.samples[k].second, &b.samples[k].second,
+                    sizeof(float)) != 0) {
+      return 1.0f;
+    }
+  }
+  const auto relative = [](double x, double y) {
+    return std::abs(x - y) / std::max(1.0, std::abs(y));
+  };
+  return static_cast<float>(std::max({relative(a.min, b.min),
+                                      relative(a.max, b.max),
+                                      relative(a.mean, b.mean),
+                                      relative(a.stddev, b.stddev)}));
+}
+
+// Эталонная сводка float: скалярно, суммы в double
+TensorSummary reference_summary(const std::vector<float>& values,
+                                const SummaryOptions& options) {
+  TensorSummary summary;
+  summary.count = values.size();
+  float min = std::numeric_limits<float>::infinity(), max = -min;
+  double sum = 0.0;
+  std::vector<std::pair<std::size_t, float>> finite;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    const float x = values[i];
+    if (std::isnan(x)) {
+      ++summary.nan;
+    } else if (std::isinf(x)) {
+      ++(x > 0.0f ? summary.pos_inf : summary.neg_inf);
+    } else {
+      finite.emplace_back(i, x);
+      min = std::min(min, x);
+      max = std::max(max, x);
+      sum += x;
+    }
+  }
+  summary.finite = finite.size();
+  summary.histogram.assign(options.bins, 0);
+  if (!finite.empty()) {
+    summary.min = min;
+    summary.max = max;
+    summary.mean = sum / finite.size();
+    const summary::HistogramScale histogram(min, max, options.bins);
+    double squares = 0.0;
+    for (const auto& [i, x] : finite) {
+      squares += (x - summary.mean) * (x - summary.mean);
+      ++summary.histogram[histogram.bin(x)];
+    }
+    summary.stddev = std::sqrt(squares / finite.size());
+    std::stable_sort(finite.begin(), finite.end(),
+                     [](const auto& a, const auto& b) {
+                       return std::abs(a.second) > std::abs(b.second);
+                     });
+    finite.resize(std::min(finite.size(), options.top_k));
+    summary.top_abs = finite;
+  }
+  for (std::size_t i : summary::sample_indices(values.size(), options)) {
+    summary.samples.emplace_back(i, values[i]);
+  }
+  return summary;
+}
+
+bool test_tensor_summary() {
+  std::cout << "\n=== Сводка тензора ===\n";
+  bool all_passed = true;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float inf = std::numeric_limits<float>::infinity();
+  const SummaryOptions options;
+
+  // Длина не кратна ни вектору, ни блоку; NaN и ±Inf в теле и в хвосте
+  const std::size_t count = 3 * kSummaryBlock + 1237;
+  auto values = make_values(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    values[i] = (values[i] - 0.3f) * 50.0f;
+  }
+  values[17] = nan;
+  values[kSummaryBlock + 3] = inf;
+  values[2 * kSummaryBlock + 100] = -inf;
+  values[count - 2] = nan;
+  values[count - 5] = inf;
+  values[5000] = -90.0f;  // уникальный минимум и наибольший модуль
+  values[count - 1] = 40.0f;  // равен другому значению в top-k
+  values[9000] = 40.0f;
+  const TensorSummary expected = reference_summary(values, options);
+
+  const std::pair<std::string_view, SoftmaxMethod> methods[] = {
+      {"Sequential", SoftmaxMethod::kSequential},
+      {"OpenMP", SoftmaxMethod::kOpenMP},
+      {"SIMD", SoftmaxMethod::kSimd},
+      {"OpenMP + SIMD", SoftmaxMethod::kOpenMPSimd}};
+  for (const auto& [name, method] : methods) {
+    const TensorSummary summary =
+        summarize_tensor(values.data(), count, options, method);
+    all_passed = report_check("float против эталона, " + std::string(name),
+                              summary_diff(summary, expected)) &&
+                 all_passed;
+  }
+
+  // 16-битные и целые типы: сводка равна сводке значений, расширенных до
+  // float (кроме типа)
+  const auto check_type = [&](std::string_view name, const auto& typed) {
+    using T = typename std::decay_t<decltype(typed)>::value_type;
+    std::vector<float> widened(typed.size());
+    for (std::size_t i = 0; i < typed.size(); ++i) {
+      widened[i] = SummaryTraits<T>::to_float(typed[i]);
+    }
+    TensorSummary summary = summarize_tensor(
+        make_view(typed, TensorShape({typed.size()})), options);
+    const bool dtype_ok = summary.dtype == DTypeOf<T>::value;
+    summary.dtype = DType::kFloat32;
+    const float diff =
+        dtype_ok ? summary_diff(summary, summarize_tensor(widened.data(),
+                                                           widened.size(),
+                                                           options))
+                 : 1.0f;
+    return report_check(name, diff);
+  };
+  std::vector<std::int8_t> int8(count);
+  std::vector<std::uint8_t> uint8(count);
+  std::vector<std::int32_t> int32(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    int8[i] = static_cast<std::int8_t>(i * 37 % 256 - 128);
+    uint8[i] = static_cast<std::uint8_t>(i * 11 % 256);
+    int32[i] = static_cast<std::int32_t>(i * 2654435761u % 2000001) - 1000000;
+  }
+  all_passed = check_type("float16", convert_from_float<Half>(values)) &&
+               all_passed;
+  all_passed = check_type("bfloat16", convert_from_float<BFloat16>(values)) &&
+               all_passed;
+  all_passed = check_type("int8", int8) && all_passed;
+  all_passed = check_type("uint8", uint8) && all_passed;
+  all_passed = check_type("int32", int32) && all_passed;
+
+  // Значения ±FLT_MAX (маска и обрезка): max - min и float-сумма блока
+  // переполняются
+  std::vector<float> extreme = make_values(64 * 1024 + 5);
+  const float huge = std::numeric_limits<float>::max();
+  for (std::size_t i = 0; i < extreme.size(); i += 3) {
+    extreme[i] = i % 2 == 0 ? huge : -huge;
+  }
+  extreme[7] = nan;
+  for (const auto& [name, method] : methods) {
+    const TensorSummary summary =
+        summarize_tensor(extreme.data(), extreme.size(), options, method);
+    const bool sane = std::isfinite(summary.mean) &&
+                      std::isfinite(summary.stddev) &&
+                      summary.histogram.front() > 0 &&
+                      summary.histogram.back() > 0;
+    all_passed =
+        report_check("±FLT_MAX, " + std::string(name),
+                     sane ? summary_diff(summary, reference_summary(
+                                                      extreme, options))
+                          : 1.0f) &&
+        all_passed;
+  }
+
+  // Вырожденные случаи: пусто, только NaN, одно значение
+  const std::vector<float> empty, only_nan(10, nan), single = {2.5f};
+  for (const auto* data : {&empty, &only_nan, &single}) {
+    all_passed =
+        report_check("Вырожденный тензор из " + std::to_string(data->size()),
+                     summary_diff(summarize_tensor(
+                                      data->data(), data->size(), options),
+                                  reference_summary(*data, options))) &&
+        all_passed;
+  }
+
+  std::cout << format_summary(summarize_tensor(values.data(), count));
+  return all_passed;
+}
+
+// Запуск всех тестов корректности
+bool run_all_tests() {
+  bool all_tests_passed = test_simd_correctness();
+  all_tests_passed = test_denormal_mode() && all_tests_passed;
+  all_tests_passed = test_tensor_shapes() && all_tests_passed;
+  all_tests_passed = test_softmax_axis() && all_tests_passed;
+  all_tests_passed = test_tensor_views() && all_tests_passed;
+  all_tests_passed = test_attention_batch() && all_tests_passed;
+  all_tests_passed = test_masked_softmax() && all_tests_passed;
+  all_tests_passed = test_prologue_fusion() && all_tests_passed;
+  all_tests_passed = test_cross_entropy() && all_tests_passed;
+  all_tests_passed = test_softmax_backward() && all_tests_passed;
+  all_tests_passed = test_softmax_dropout() && all_tests_passed;
+  all_tests_passed = test_half_storage() && all_tests_passed;
+  all_tests_passed = test_quantized_softmax() && all_tests_passed;
+  all_tests_passed = test_topk_sampling() && all_tests_passed;
+  all_tests_passed = test_lazy_softmax() && all_tests_passed;
+  all_tests_passed = test_softmax_state() && all_tests_passed;
+  all_tests_passed = test_segmented_softmax() && all_tests_passed;
+  all_tests_passed = test_hierarchical_softmax() && all_tests_passed;
+  all_tests_passed = test_sparse_mappings() && all_tests_passed;
+  all_tests_passed = test_row_normalization() && all_tests_passed;
+  all_tests_passed = test_fixed_length_kernels() && all_tests_passed;
+  all_tests_passed = test_portable_vec() && all_tests_passed;
+  all_tests_passed = test_pairwise_summation() && all_tests_passed;
+  all_tests_passed = test_reproducible_reductions() && all_tests_passed;
+  all_tests_passed = test_row_health() && all_tests_passed;
+  all_tests_passed = test_tensor_summary() && all_tests_passed;
+
+  if (all_tests_passed) {
+    std::cout << "\n✅ ВСЕ ТЕСТЫ ПРОЙДЕНЫ! SIMD реализация корректна.\n";
+  } else {
+    std::cout << "\n❌ ЕСТЬ ПРОБЛЕМЫ! Требуется отладка SIMD реализации.\n";
+  }
+  return all_tests_passed;
+}
+
+// Проверка конкретного размера матрицы (для отладки)
+void debug_single_test(std::size_t n) {
+  std::cout << "\n=== Отладочная информация для n = " << n << " ===\n";
+  std::cout << "Количество элементов в строке: " << n << "\n";
+  std::cout << "Векторных итераций (по 8 элементов): " << (n + 7) / 8 << "\n";
+  std::cout << "Остаточных элементов (хвост): " << n % 8 << "\n\n";
+
+  // Создаем матрицу
+  auto matrix = make_matrix(n);
+
+  // Обрабатываем первую строку с отладочным выводом
+  std::vector<float> scalar_result(n);
+  std::vector<float> simd_result(n);
+
+  SoftmaxRow(&matrix[0], &scalar_result[0], n);
+  SoftmaxRowSimd(&matrix[0], &simd_result[0], n);
+
+  std::cout << "Первая строка матрицы (первые 10 элементов):\n";
+  for (std::size_t j = 0; j < std::min(n, static_cast<std::size_t>(10)); ++j) {
+    std::cout << "  Элемент " << j << ": input=" << std::setprecision(4)
+              << matrix[j] << ", scalar=" << scalar_result[j]
+              << ", SIMD=" << simd_result[j]
+              << ", diff=" << std::abs(scalar_result[j] - simd_result[j])
+              << "\n";
+  }
+
+  // Проверяем суммы
+  float sum_scalar = 0.0f, sum_simd = 0.0f;
+  for (std::size_t j = 0; j < n; ++j) {
+    sum_scalar += scalar_result[j];
+    sum_simd += simd_result[j];
+  }
+
+  std::cout << "\nСумма скалярного результата: " << sum_scalar << "\n";
+  std::cout << "Сумма SIMD результата: " << sum_simd << "\n";
+  std::cout << "Разница сумм: " << std::abs(sum_scalar - sum_simd) << "\n";
+}
+
+// Количество денормализованных значений в результате
+std::size_t count_subnormals(const std::vector<float>& values) {
+  std::size_t count = 0;
+  for (float v : values) {
+    if (std::fpclassify(v) == FP_SUBNORMAL) ++count;
+  }
+  return count;
+}
+
+// Сравнение времени SIMD ядер с FTZ/DAZ и без на "широких" логитах
+void report_denormal_impact(std::size_t n) {
+  std::cout << "\n=== Влияние денормалов (логиты в [-120, 0], n = " << n
+            << ") ===\n";
+
+  const auto input = make_matrix(n, InputDistribution::kWideRange);
+  std::vector<float> baseline;
+  const double sequential_seconds =
+      measure_seconds([&] { return run_sequential(input, n); }, baseline);
+  std::cout << "Sequential: " << format_time(sequential_seconds, 4)
+            << " sec (" << count_subnormals(baseline) << " денормалов)\n";
+
+  struct Variant {
+    std::string_view name;
+    bool parallel;
+    DenormalMode mode;
+  };
+  const Variant variants[] = {
+      {"SIMD", false, DenormalMode::kPreserve},
+      {"SIMD + FTZ/DAZ", false, DenormalMode::kFlushToZero},
+      {"OpenMP + SIMD", true, DenormalMode::kPreserve},
+      {"OpenMP + SIMD + FTZ/DAZ", true, DenormalMode::kFlushToZero},
+  };
+
+  for (const auto& variant : variants) {
+    const auto runner = [&] {
+      return variant.parallel ? run_openmp_simd(input, n, variant.mode)
+                              : run_simd(input, n, variant.mode);
+    };
+    runner();  // прогрев: страницы результата и пул потоков OpenMP
+    auto res = run_test_case(runner, baseline, variant.name);
+    if (!res) continue;
+    std::cout << variant.name << ": " << format_time(res.seconds, 4)
+              << " sec (diff: " << format_diff(res.diff) << ", "
+              << count_subnormals(res.result) << " денормалов)\n";
+  }
+}
+
+// Замер всех методов на тензоре произвольной формы (Softmax по последней оси)
+void report_tensor(const TensorShape& shape) {
+  const auto input = make_values(shape.numel());
+
+  std::vector<float> sequential_result;
+  const double sequential_seconds = measure_seconds(
+      [&] {
+        return softmax_last_axis(input, shape, SoftmaxMethod::kSequential);
+      },
+      sequential_result);
+
+  const auto run = [&](SoftmaxMethod method, std::string_view name) {
+    return run_test_case(
+        [&] { return softmax_last_axis(input, shape, method); },
+        sequential_result, name);
+  };
+  auto omp_res = run(SoftmaxMethod::kOpenMP, "OpenMP");
+  auto simd_res = run(SoftmaxMethod::kSimd, "SIMD");
+  auto omp_simd_res = run(SoftmaxMethod::kOpenMPSimd, "OpenMP + SIMD");
+
+  std::cout << "Shape: " << shape.rows() << " rows x " << shape.last_dim()
+            << "\n";
+  std::cout << "Sequential: " << format_time(sequential_seconds) << " sec\n";
+  print_report("OpenMP", omp_res);
+  print_report("SIMD", simd_res);
+  print_report("OpenMP + SIMD", omp_simd_res);
+}
+
+// Прежний способ: транспонировать ось в конец, посчитать строки, вернуть
+std::vector<float> softmax_axis_via_transpose(const std::vector<float>& input,
+                                              std::size_t outer,
+                                              std::size_t len,
+                                              std::size_t inner) {
+  std::vector<float> transposed(input.size()), result(input.size());
+  for (std::size_t o = 0; o < outer; ++o) {
+    for (std::size_t a = 0; a < len; ++a) {
+      for (std::size_t j = 0; j < inner; ++j) {
+        transposed[(o * inner + j) * len + a] =
+            input[(o * len + a) * inner + j];
+      }
+    }
+  }
+  softmax_rows(transposed.data(), len, transposed.data(), len, outer * inner,
+               len, SoftmaxMethod::kOpenMPSimd);
+  for (std::size_t o = 0; o < outer; ++o) {
+    for (std::size_t a = 0; a < len; ++a) {
+      for (std::size_t j = 0; j < inner; ++j) {
+        result[(o * len + a) * inner + j] =
+            transposed[(o * inner + j) * len + a];
+      }
+    }
+  }
+  return result;
+}
+
+// Замер Softmax вдоль оси axis: транспонирование против strided-ядер
+void report_axis(const TensorShape& shape, std::size_t axis) {
+  if (axis >= shape.rank()) {
+    throw std::invalid_argument("Softmax axis is out of range");
+  }
+  const auto input = make_values(shape.numel());
+  std::size_t outer = 1, inner = 1;
+  for (std::size_t i = 0; i < axis; ++i) outer *= shape.dims[i];
+  for (std::size_t i = axis + 1; i < shape.rank(); ++i) inner *= shape.dims[i];
+
+  std::vector<float> baseline;
+  const double transpose_seconds = measure_seconds(
+      [&] {
+        return softmax_axis_via_transpose(input, outer, shape.dims[axis],
+                                          inner);
+      },
+      baseline);
+
+  const auto run = [&](SoftmaxMethod method, std::string_view name) {
+    return run_test_case(
+        [&] { return softmax_axis(input, shape, axis, method); }, baseline,
+        name);
+  };
+  auto seq_res = run(SoftmaxMethod::kSequential, "Strided");
+  auto simd_res = run(SoftmaxMethod::kSimd, "Strided SIMD");
+  auto omp_simd_res = run(SoftmaxMethod::kOpenMPSimd, "Strided OpenMP + SIMD");
+
+  std::cout << "Axis " << axis << ": outer " << outer << ", len "
+            << shape.dims[axis] << ", inner " << inner << "\n";
+  std::cout << "Transpose + OpenMP + SIMD: "
+            << format_time(transpose_seconds, 4) << " sec\n";
+  const std::pair<std::string_view, const RunResult*> rows[] = {
+      {"Strided", &seq_res},
+      {"Strided SIMD", &simd_res},
+      {"Strided OpenMP + SIMD", &omp_simd_res}};
+  for (const auto& [name, res] : rows) {
+    if (!*res) continue;
+    std::cout << name << ": " << format_time(res->seconds, 4)
+              << " sec (diff: " << format_diff(res->diff) << ")\n";
+  }
+}
+
+// Замер батча внимания: регион на каждую (b, h) против одного региона
+void report_attention(std::size_t batch, std::size_t heads,
+                      std::size_t seq_len) {
+  const TensorShape shape({batch, heads, seq_len, seq_len});
+  const auto scores = make_values(shape.numel());
+  const std::size_t matrix = seq_len * seq_len;
+
+  std::vector<float> baseline;
+  const double per_head_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> probs(scores.size());
+        for (std::size_t bh = 0; bh < batch * heads; ++bh) {
+          softmax_rows(&scores[bh * matrix], seq_len, &probs[bh * matrix],
+                       seq_len, seq_len, seq_len, SoftmaxMethod::kOpenMPSimd);
+        }
+        return probs;
+      },
+      baseline);
+
+  std::vector<float> batched;
+  const double batched_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> probs(scores.size());
+        softmax_attention(make_view(scores, shape), make_view(probs, shape),
+                          SoftmaxMethod::kOpenMPSimd);
+        return probs;
+      },
+      batched);
+
+  std::cout << "B=" << batch << " H=" << heads << " S=" << seq_len
+            << ": per-(b,h) " << format_time(per_head_seconds, 4)
+            << " sec, batched " << format_time(batched_seconds, 4)
+            << " sec (diff: " << format_diff(max_abs_diff(baseline, batched))
+            << ")\n";
+}
+
+// Замер маскированного Softmax: -inf + полный проход против встроенной маски
+void report_masked(std::size_t n) {
+  const TensorShape shape({n, n});
+  const auto scores = make_matrix(n);
+  std::vector<std::size_t> lengths(n);
+  for (std::size_t r = 0; r < n; ++r) lengths[r] = n / 2 + r % (n / 2 + 1);
+
+  const std::pair<std::string_view, SoftmaxMask> masks[] = {
+      {"Causal", SoftmaxMask::causal()},
+      {"Sliding window 128", SoftmaxMask::sliding_window(128)},
+      {"Valid length", SoftmaxMask::valid_length(lengths.data())}};
+
+  std::cout << "Masked softmax, n = " << n << "\n";
+  for (const auto& [name, mask] : masks) {
+    std::vector<float> baseline;
+    const double inf_seconds = measure_best_seconds(
+        [&] {
+          auto masked = apply_mask_with_inf(scores, n, n, n, mask);
+          return run_openmp_simd(masked, n);
+        },
+        baseline);
+
+    std::vector<float> fused;
+    const double fused_seconds = measure_best_seconds(
+        [&] {
+          std::vector<float> probs(scores.size());
+          softmax_masked(make_view(scores, shape), make_view(probs, shape),
+                         mask, SoftmaxMethod::kOpenMPSimd);
+          return probs;
+        },
+        fused);
+
+    std::cout << name << ": -inf + softmax " << format_time(inf_seconds, 4)
+              << " sec, fused " << format_time(fused_seconds, 4)
+              << " sec (diff: " << format_diff(max_abs_diff(baseline, fused))
+              << ")\n";
+  }
+}
+
+// Замер пролога внимания: отдельные проходы против слияния с Softmax
+void report_prologue(std::size_t batch, std::size_t heads,
+                     std::size_t seq_len) {
+  const TensorShape shape({batch, heads, seq_len, seq_len});
+  const auto scores = make_values(shape.numel());
+  const auto params = make_prologue_params(heads, seq_len, 64);
+
+  std::vector<float> baseline;
+  const double passes_seconds = measure_best_seconds(
+      [&] {
+        return prologue_via_passes(scores, params,
+                                   SoftmaxMethod::kOpenMPSimd);
+      },
+      baseline);
+
+  std::vector<float> fused;
+  const double fused_seconds = measure_best_seconds(
+      [&] {
+        return prologue_fused(scores, shape, params,
+                              SoftmaxMethod::kOpenMPSimd);
+      },
+      fused);
+
+  std::cout << "B=" << batch << " H=" << heads << " S=" << seq_len
+            << ": 4 passes + softmax " << format_time(passes_seconds, 4)
+            << " sec, fused " << format_time(fused_seconds, 4)
+            << " sec (diff: " << format_diff(max_abs_diff(baseline, fused))
+            << ")\n";
+}
+
+// Замер cross-entropy: Softmax, log, выборка метки и градиент отдельными
+// проходами против слитых ядер
+void report_cross_entropy(std::size_t rows, std::size_t vocab) {
+  const TensorShape shape({rows, vocab});
+  const auto logits = make_values(rows * vocab);
+  std::vector<std::size_t> targets(rows);
+  for (std::size_t r = 0; r < rows; ++r) targets[r] = (r * 7919) % vocab;
+  const float smoothing = 0.1f;
+
+  std::vector<float> baseline;
+  const double passes_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> probs(logits.size()), grad(logits.size());
+        std::vector<float> log_probs(logits.size());
+        softmax_rows(logits.data(), vocab, probs.data(), vocab, rows, vocab,
+                     SoftmaxMethod::kOpenMPSimd);
+#pragma omp parallel for
+        for (std::size_t i = 0; i < probs.size(); ++i) {
+          log_probs[i] = std::log(probs[i]);
+        }
+        double total = 0.0;
+#pragma omp parallel for reduction(+ : total)
+        for (std::size_t r = 0; r < rows; ++r) {
+          double sum_log = 0.0;
+          for (std::size_t j = 0; j < vocab; ++j) {
+            sum_log += log_probs[r * vocab + j];
+          }
+          total -= (1.0 - smoothing) * log_probs[r * vocab + targets[r]] +
+                   smoothing / vocab * sum_log;
+        }
+#pragma omp parallel for
+        for (std::size_t r = 0; r < rows; ++r) {
+          for (std::size_t j = 0; j < vocab; ++j) {
+            grad[r * vocab + j] = probs[r * vocab + j] - smoothing / vocab;
+          }
+          grad[r * vocab + targets[r]] -= 1.0f - smoothing;
+        }
+        grad.push_back(static_cast<float>(total / rows));
+        return grad;
+      },
+      baseline);
+
+  std::vector<float> fused;
+  const double fused_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> grad(logits.size());
+        const float loss = softmax_cross_entropy(
+            make_view(logits, shape), targets.data(), smoothing, nullptr,
+            make_view(grad, shape), SoftmaxMethod::kOpenMPSimd);
+        grad.push_back(loss);
+        return grad;
+      },
+      fused);
+
+  std::vector<float> loss_only;
+  const double loss_seconds = measure_best_seconds(
+      [&] {
+        return std::vector<float>{softmax_cross_entropy(
+            make_view(logits, shape), targets.data(), smoothing, nullptr, {},
+            SoftmaxMethod::kOpenMPSimd)};
+      },
+      loss_only);
+
+  std::cout << rows << " x " << vocab << ": 4 passes "
+            << format_time(passes_seconds, 4) << " sec, fused loss + grad "
+            << format_time(fused_seconds, 4) << " sec, fused loss only "
+            << format_time(loss_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(baseline, fused)) << ", loss "
+            << baseline.back() << " / " << loss_only.back() << ")\n";
+}
+
+// Режим проверки обратного прохода: все методы против эталона в double
+void report_backward(std::size_t n) {
+  auto y = make_matrix(n);
+  softmax_rows(y.data(), n, y.data(), n, n, n, SoftmaxMethod::kOpenMPSimd);
+  auto dy = make_matrix(n);
+  for (float& g : dy) g = 2.0f * g - 1.0f;
+
+  std::vector<float> expected;
+  const double reference_seconds = measure_seconds(
+      [&] { return reference_backward(y, dy, n, n); }, expected);
+  std::cout << "Backward, n = " << n << "\n";
+  std::cout << "Double reference: " << format_time(reference_seconds, 4)
+            << " sec\n";
+
+  const std::pair<std::string_view, SoftmaxMethod> methods[] = {
+      {"Sequential", SoftmaxMethod::kSequential},
+      {"OpenMP", SoftmaxMethod::kOpenMP},
+      {"SIMD", SoftmaxMethod::kSimd},
+      {"OpenMP + SIMD", SoftmaxMethod::kOpenMPSimd}};
+  for (const auto& [name, method] : methods) {
+    std::vector<float> dx;
+    const double seconds = measure_best_seconds(
+        [&] {
+          std::vector<float> result(n * n);
+          softmax_backward_rows(y.data(), n, dy.data(), n, result.data(), n,
+                                n, n, method);
+          return result;
+        },
+        dx);
+    std::cout << name << ": " << format_time(seconds, 4)
+              << " sec (diff vs double: "
+              << format_diff(max_abs_diff(expected, dx)) << ")\n";
+  }
+}
+
+// Softmax + dropout: отдельный проход с маской в памяти против слитого
+// ядра; обратный проход - по сохранённым y и маске против пересчёта
+void report_dropout(std::size_t n) {
+  const auto logits = make_matrix(n);
+  auto dout = make_matrix(n);
+  for (float& g : dout) g = 2.0f * g - 1.0f;
+  const Dropout dropout(0.1f, 2024);
+  const TensorShape shape({n, n});
+
+  // Раздельный путь: Softmax, затем маска в байтах и её применение
+  std::vector<float> y(n * n);
+  std::vector<std::uint8_t> mask(n * n);
+  std::vector<float> separate, fused, lse(n);
+  const auto separate_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> out(n * n);
+        softmax_rows(logits.data(), n, y.data(), n, n, n,
+                     SoftmaxMethod::kOpenMPSimd);
+#pragma omp parallel for
+        for (std::size_t r = 0; r < n; ++r) {
+          std::uint32_t bits[kPhiloxBlockCols];
+          for (std::size_t base = 0; base < n; base += kPhiloxBlockCols) {
+            philox_block(dropout.seed, kDropoutStream, r,
+                         base / kPhiloxBlockCols, bits);
+            const std::size_t end = std::min(n, base + kPhiloxBlockCols);
+            for (std::size_t j = base; j < end; ++j) {
+              mask[r * n + j] = bits[j - base] >= dropout.threshold;
+            }
+          }
+          for (std::size_t j = 0; j < n; ++j) {
+            out[r * n + j] =
+                mask[r * n + j] ? y[r * n + j] * dropout.scale : 0.0f;
+          }
+        }
+        return out;
+      },
+      separate);
+  const auto fused_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> out(n * n);
+        softmax_dropout(make_view(logits, shape), make_view(out, shape),
+                        lse.data(), dropout, SoftmaxMethod::kOpenMPSimd);
+        return out;
+      },
+      fused);
+
+  std::vector<float> separate_dx, fused_dx;
+  const auto separate_backward_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> g(n * n), dx(n * n);
+#pragma omp parallel for
+        for (std::size_t i = 0; i < n * n; ++i) {
+          g[i] = mask[i] ? dout[i] * dropout.scale : 0.0f;
+        }
+        softmax_backward_rows(y.data(), n, g.data(), n, dx.data(), n, n, n,
+                              SoftmaxMethod::kOpenMPSimd);
+        return dx;
+      },
+      separate_dx);
+  const auto fused_backward_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> dx(n * n);
+        softmax_dropout_backward(make_view(logits, shape), lse.data(),
+                                 make_view(dout, shape), make_view(dx, shape),
+                                 dropout, SoftmaxMethod::kOpenMPSimd);
+        return dx;
+      },
+      fused_dx);
+
+  std::cout << "n = " << n << ", dropout " << dropout.rate << "\n";
+  std::cout << "Forward: softmax + mask pass "
+            << format_time(separate_seconds, 4) << " sec, fused "
+            << format_time(fused_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(separate, fused)) << ")\n";
+  std::cout << "Backward: stored y + mask "
+            << format_time(separate_backward_seconds, 4) << " sec, recomputed "
+            << format_time(fused_backward_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(separate_dx, fused_dx)) << ")\n";
+  std::cout << "Saved for backward: y + mask "
+            << (n * n * (sizeof(float) + 1)) / (1024 * 1024) << " MiB, lse "
+            << n * sizeof(float) / 1024 << " KiB\n";
+}
+
+// Замер Softmax матрицы n×n с хранением в In/Out против float пути
+template <typename In, typename Out>
+void report_half_variant(std::string_view name,
+                         const std::vector<float>& matrix, std::size_t n,
+                         const std::vector<float>& baseline, HalfExp exp) {
+  const auto input = convert_from_float<In>(matrix);
+  std::vector<Out> output(input.size());
+  std::vector<float> result;
+  const double seconds = measure_best_seconds(
+      [&] {
+        softmax_rows(input.data(), n, output.data(), n, n, n,
+                     SoftmaxMethod::kOpenMPSimd, DenormalMode::kPreserve,
+                     exp);
+        return std::vector<float>();
+      },
+      result);
+  std::cout << name << ": " << format_time(seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(baseline, convert_to_float(output)))
+            << ")\n";
+}
+
+// Замер хранения в fp16/bf16: вычисления во float, вдвое меньше байт
+void report_half(std::size_t n) {
+  const auto matrix = make_matrix(n);
+  std::vector<float> output(n * n), baseline;
+  const double float_seconds = measure_best_seconds(
+      [&] {
+        softmax_rows(matrix.data(), n, output.data(), n, n, n,
+                     SoftmaxMethod::kOpenMPSimd);
+        return std::vector<float>();
+      },
+      baseline);
+  baseline = output;
+
+  std::cout << "OpenMP + SIMD, n = " << n << "\n";
+  std::cout << "float -> float: " << format_time(float_seconds, 4)
+            << " sec\n";
+  report_half_variant<Half, Half>("fp16 -> fp16", matrix, n, baseline,
+                                  HalfExp::kPolynomial);
+  report_half_variant<Half, Half>("fp16 -> fp16 (таблица exp)", matrix, n,
+                                  baseline, HalfExp::kTable);
+  report_half_variant<Half, float>("fp16 -> float", matrix, n, baseline,
+                                   HalfExp::kPolynomial);
+  report_half_variant<BFloat16, BFloat16>("bf16 -> bf16", matrix, n, baseline,
+                                          HalfExp::kPolynomial);
+}
+
+// Замер и точность Softmax квантованных логитов против деквантования во
+// float и run_openmp_simd
+void report_quantized(std::size_t n) {
+  const float scale = 0.05f;
+  const TensorShape shape({n, n});
+  const auto q8 = make_quantized<std::int8_t>(n * n, -128, 127);
+  const auto q32 = make_quantized<std::int32_t>(n * n, -128, 127);
+
+  std::vector<float> baseline;
+  const double float_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> logits(q8.size());
+        for (std::size_t i = 0; i < q8.size(); ++i) logits[i] = scale * q8[i];
+        return run_openmp_simd(logits, n);
+      },
+      baseline);
+  std::cout << "Quantized softmax, n = " << n << ", scale = " << scale
+            << "\n";
+  std::cout << "Dequantize + OpenMP + SIMD: " << format_time(float_seconds, 4)
+            << " sec\n";
+
+  const auto run = [&](std::string_view name, const auto& input,
+                       auto output, float to_float) {
+    using Out = typename decltype(output)::value_type;
+    std::vector<float> values;
+    const double seconds = measure_best_seconds(
+        [&] {
+          softmax_quantized(make_view(input, shape), scale,
+                            make_view(output, shape),
+                            SoftmaxMethod::kOpenMPSimd);
+          return std::vector<float>();
+        },
+        values);
+    values.resize(output.size());
+    for (std::size_t i = 0; i < output.size(); ++i) {
+      if constexpr (std::is_same_v<Out, std::uint8_t>) {
+        values[i] = output[i] * to_float;
+      } else {
+        values[i] = StorageTraits<Out>::to_float(output[i]);
+      }
+    }
+    std::cout << name << ": " << format_time(seconds, 4)
+              << " sec (max diff vs float: "
+              << format_diff(max_abs_diff(baseline, values)) << ")\n";
+  };
+  run("int8 -> float", q8, std::vector<float>(n * n), 1.0f);
+  run("int8 -> fp16", q8, std::vector<Half>(n * n), 1.0f);
+  run("int8 -> uint8", q8, std::vector<std::uint8_t>(n * n),
+      1.0f / kUInt8ProbScale);
+  run("int32 -> float", q32, std::vector<float>(n * n), 1.0f);
+}
+
+// Замер top-k и сэмплирования: полный Softmax + отбор против слитых ядер
+void report_sampling(std::size_t rows, std::size_t vocab, std::size_t k) {
+  const TensorShape shape({rows, vocab});
+  const TensorShape out_shape({rows, k});
+  const auto logits = make_values(rows * vocab);
+  const std::uint64_t seed = 2025;
+
+  // Полный Softmax и частичная сортировка вероятностей
+  std::vector<float> result;
+  const double topk_full_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> probs(logits.size());
+        softmax_rows(logits.data(), vocab, probs.data(), vocab, rows, vocab,
+                     SoftmaxMethod::kOpenMPSimd);
+        std::vector<float> top(rows * k);
+#pragma omp parallel for
+        for (std::size_t r = 0; r < rows; ++r) {
+          std::vector<float> row(probs.begin() + r * vocab,
+                                 probs.begin() + (r + 1) * vocab);
+          std::partial_sort(row.begin(), row.begin() + k, row.end(),
+                            std::greater<float>());
+          float sum = 0.0f;
+          for (std::size_t j = 0; j < k; ++j) sum += row[j];
+          for (std::size_t j = 0; j < k; ++j) top[r * k + j] = row[j] / sum;
+        }
+        return top;
+      },
+      result);
+  std::vector<float> fused;
+  const double topk_fused_seconds = measure_best_seconds(
+      [&] {
+        std::vector<std::int32_t> indices(rows * k);
+        std::vector<float> probs(rows * k);
+        softmax_topk(make_view(logits, shape), k,
+                     make_view(indices, out_shape),
+                     make_view(probs, out_shape), SoftmaxMethod::kOpenMPSimd);
+        return probs;
+      },
+      fused);
+  std::cout << rows << " x " << vocab << ", top-" << k << ": softmax + sort "
+            << format_time(topk_full_seconds, 4) << " sec, fused "
+            << format_time(topk_fused_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(result, fused)) << ")\n";
+
+  // Полный Softmax и обратная функция распределения
+  const double cdf_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> probs(logits.size()), samples(rows);
+        softmax_rows(logits.data(), vocab, probs.data(), vocab, rows, vocab,
+                     SoftmaxMethod::kOpenMPSimd);
+#pragma omp parallel for
+        for (std::size_t r = 0; r < rows; ++r) {
+          const float u =
+              bits_to_open_unit(philox_bits(seed, kSamplingStream, r, 0));
+          float cdf = 0.0f;
+          std::size_t j = 0;
+          for (; j + 1 < vocab; ++j) {
+            cdf += probs[r * vocab + j];
+            if (cdf >= u) break;
+          }
+          samples[r] = static_cast<float>(j);
+        }
+        return samples;
+      },
+      result);
+  const auto sample = [&](const std::vector<float>& values,
+                           SamplingMethod sampling) {
+    std::vector<std::int32_t> samples(rows);
+    sample_softmax(make_view(values, shape), 1.0f, seed, samples.data(),
+                   SoftmaxMethod::kOpenMPSimd, sampling);
+    return std::vector<float>(samples.begin(), samples.end());
+  };
+  const double gumbel_seconds = measure_best_seconds(
+      [&] { return sample(logits, SamplingMethod::kGumbel); }, fused);
+  const double inverse_cdf_seconds = measure_best_seconds(
+      [&] { return sample(logits, SamplingMethod::kInverseCdf); }, fused);
+  std::cout << rows << " x " << vocab << ", sampling: softmax + CDF "
+            << format_time(cdf_seconds, 4) << " sec, Gumbel-max "
+            << format_time(gumbel_seconds, 4) << " sec, one-pass CDF "
+            << format_time(inverse_cdf_seconds, 4) << " sec\n";
+
+  // Строка с явным лидером (как у языковой модели): после лидера блоки
+  // с логитами ниже него на kGumbelNoiseMax отсекаются без шума
+  auto peaked = logits;
+  for (float& x : peaked) x *= 8.0f;
+  for (std::size_t r = 0; r < rows; ++r) {
+    peaked[r * vocab + (r * 7919) % vocab] = 30.0f;
+  }
+  const double peaked_seconds = measure_best_seconds(
+      [&] { return sample(peaked, SamplingMethod::kGumbel); }, fused);
+  std::cout << rows << " x " << vocab
+            << ", sampling, peaked rows: Gumbel-max "
+            << format_time(peaked_seconds, 4) << " sec\n";
+}
+
+// Замер внимания P×V: нормализованный Softmax + GEMM против отложенной
+// нормализации в эпилоге GEMM (V - [n, 64])
+void report_lazy(std::size_t n) {
+  const std::size_t d = 64;
+  const auto scores = make_matrix(n);
+  const auto v = make_values(n * d);
+  const TensorShape shape({n, n}), v_shape({n, d}), out_shape({n, d});
+
+  // Только Softmax: буферы общие, результат сравнивается ниже через P×V
+  std::vector<float> probs(n * n), scale(n), unused;
+  const auto softmax_seconds = measure_best_seconds(
+      [&] {
+        softmax_rows(scores.data(), n, probs.data(), n, n, n,
+                     SoftmaxMethod::kOpenMPSimd);
+        return std::vector<float>();
+      },
+      unused);
+  const auto unnormalized_seconds = measure_best_seconds(
+      [&] {
+        softmax_unnormalized(make_view(scores, shape), make_view(probs, shape),
+                             scale.data(), SoftmaxMethod::kOpenMPSimd);
+        return std::vector<float>();
+      },
+      unused);
+
+  std::vector<float> baseline, lazy;
+  const auto baseline_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> p(n * n);
+        softmax_rows(scores.data(), n, p.data(), n, n, n,
+                     SoftmaxMethod::kOpenMPSimd);
+        return gemm(p, v, n, n, d, GemmMethod::kOpenMPSimd);
+      },
+      baseline);
+  const auto lazy_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> p(n * n), s(n), out(n * d);
+        softmax_unnormalized(make_view(scores, shape), make_view(p, shape),
+                             s.data(), SoftmaxMethod::kOpenMPSimd);
+        gemm(make_view(p, shape), make_view(v, v_shape),
+             make_view(out, out_shape), GemmMethod::kOpenMPSimd, s.data());
+        return out;
+      },
+      lazy);
+
+  std::cout << "n = " << n << ", softmax " << format_time(softmax_seconds, 4)
+            << " sec, unnormalized " << format_time(unnormalized_seconds, 4)
+            << " sec\n";
+  std::cout << "P x V (d = " << d << "): softmax + GEMM "
+            << format_time(baseline_seconds, 4) << " sec, lazy "
+            << format_time(lazy_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(baseline, lazy)) << ")\n";
+}
+
+// Замер декодирования: строка растёт на один логит за шаг, на каждом шаге
+// нужен нормализатор (log Σ exp) всей строки
+void report_decode(std::size_t steps) {
+  auto logits = make_values(steps, InputDistribution::kWideRange);
+  for (float& x : logits) x += 60.0f;
+
+  std::vector<float> recompute, incremental;
+  const double recompute_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> lse(steps);
+        for (std::size_t t = 0; t < steps; ++t) {
+          lse[t] = LogitStatsRowSimd(logits.data(), t + 1).lse;
+        }
+        return lse;
+      },
+      recompute);
+  const double incremental_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> lse(steps);
+        SoftmaxState state;
+        for (std::size_t t = 0; t < steps; ++t) {
+          state.append(logits[t]);
+          lse[t] = state.log_normalizer();
+        }
+        return lse;
+      },
+      incremental);
+  std::cout << steps << " decode steps: recompute "
+            << format_time(recompute_seconds, 4) << " sec, SoftmaxState "
+            << format_time(incremental_seconds, 6) << " sec (diff: "
+            << format_diff(max_abs_diff(recompute, incremental)) << ")\n";
+
+  // Одна длинная строка: куски между потоками и слияние состояний
+  const std::size_t n = steps * 1024;
+  auto row = make_values(n, InputDistribution::kWideRange);
+  std::vector<float> single, merged;
+  const double single_seconds = measure_best_seconds(
+      [&] { return std::vector<float>{LogitStatsRowSimd(row.data(), n).lse}; },
+      single);
+  const double merged_seconds = measure_best_seconds(
+      [&] {
+        return std::vector<float>{
+            softmax_state(row.data(), n, SoftmaxMethod::kOpenMPSimd)
+                .log_normalizer()};
+      },
+      merged);
+  std::cout << "Row of " << n << ": one thread "
+            << format_time(single_seconds, 4) << " sec, merged states "
+            << format_time(merged_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(single, merged)) << ")\n";
+}
+
+// Замер CSR Softmax: статический цикл по сегментам против выбора ядра по
+// длине и динамического расписания
+void report_segments_case(std::string_view name,
+                          const std::vector<std::size_t>& lengths) {
+  const std::size_t segments = lengths.size();
+  const auto offsets = make_offsets(lengths);
+  const auto values = make_values(offsets.back());
+
+  std::vector<float> baseline, segmented;
+  const double static_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> output(values.size());
+#pragma omp parallel for
+        for (std::size_t s = 0; s < segments; ++s) {
+          SoftmaxRowSimd(&values[offsets[s]], &output[offsets[s]], lengths[s]);
+        }
+        return output;
+      },
+      baseline);
+  const double segmented_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> output(values.size());
+        softmax_segments(values.data(), output.data(), offsets.data(),
+                         segments, SoftmaxMethod::kOpenMPSimd);
+        return output;
+      },
+      segmented);
+  std::cout << name << ", " << segments << " segments, " << values.size()
+            << " elements: static per-segment "
+            << format_time(static_seconds, 4) << " sec, segmented "
+            << format_time(segmented_seconds, 4) << " sec (diff: "
+            << format_diff(max_abs_diff(baseline, segmented)) << ")\n";
+}
+
+// Длины по степенному закону (в основном короткие) с несколькими огромными
+// сегментами в начале буфера, и отдельно только короткие сегменты
+void report_segments(std::size_t segments) {
+  std::vector<std::size_t> lengths(segments);
+  std::mt19937 gen(15);
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  for (std::size_t s = 0; s < segments; ++s) {
+    lengths[s] = static_cast<std::size_t>(2.0 / std::pow(dist(gen), 1.2));
+    lengths[s] = std::min<std::size_t>(lengths[s], 4096);
+  }
+  for (std::size_t s = 0; s < std::min<std::size_t>(4, segments); ++s) {
+    lengths[s] = 1 << 21;
+  }
+  report_segments_case("Power law + huge", lengths);
+
+  for (std::size_t s = 0; s < segments; ++s) lengths[s] = 1 + s % 7;
+  report_segments_case("Lengths 1..7", lengths);
+}
+
+// Замер log p(target) по словарю из vocab классов: плоский Softmax по
+// всем логитам против двух уровней с √V кластерами
+void report_hierarchical(std::size_t vocab, std::size_t dim) {
+  const std::size_t tokens = 64;
+  const std::size_t clusters = static_cast<std::size_t>(std::sqrt(vocab));
+  const auto cluster_w = make_values(clusters * dim);
+  const auto class_w = make_values(vocab * dim);
+  const auto hidden = make_values(tokens * dim);
+  const TensorShape hidden_shape({tokens, dim});
+  std::vector<std::size_t> targets(tokens);
+  for (std::size_t t = 0; t < tokens; ++t) targets[t] = (t * 7919) % vocab;
+
+  // Плоский Softmax над логитами <W_v, h> - O(V d) на токен
+  std::vector<float> flat;
+  const double flat_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> log_probs(tokens);
+#pragma omp parallel
+        {
+          std::vector<float> logits(vocab);
+#pragma omp for
+          for (std::size_t t = 0; t < tokens; ++t) {
+            for (std::size_t v = 0; v < vocab; ++v) {
+              logits[v] = dot_product(&class_w[v * dim], &hidden[t * dim],
+                                      dim, true);
+            }
+            log_probs[t] = logits[targets[t]] -
+                           LogitStatsRowSimd(logits.data(), vocab).lse;
+          }
+        }
+        return log_probs;
+      },
+      flat);
+
+  const HierarchicalSoftmax model(
+      make_view(cluster_w, TensorShape({clusters, dim})),
+      make_view(class_w, TensorShape({vocab, dim})),
+      ClusterTable::contiguous(vocab, clusters));
+  std::vector<float> two_level;
+  const double two_level_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> log_probs(tokens);
+        hierarchical_log_prob(model, make_view(hidden, hidden_shape),
+                              targets.data(), log_probs.data(),
+                              SoftmaxMethod::kOpenMPSimd);
+        return log_probs;
+      },
+      two_level);
+  std::cout << tokens << " tokens, V = " << vocab << ", d = " << dim
+            << ", C = " << clusters << ": flat "
+            << format_time(flat_seconds, 4) << " sec, two-level "
+            << format_time(two_level_seconds, 6) << " sec\n";
+}
+
+// Sparsemax и entmax-1.5 против Softmax на той же матрице; логиты в
+// [0, 8) - типичный разброс, при котором носитель заметно короче строки
+void report_sparse(std::size_t n) {
+  auto logits = make_matrix(n);
+  for (float& x : logits) x *= 8.0f;
+  const TensorShape shape({n, n});
+
+  std::vector<float> softmax_probs, sparsemax_probs, entmax_probs, sorted;
+  const auto softmax_seconds = measure_best_seconds(
+      [&] { return run_openmp_simd(logits, n); }, softmax_probs);
+  const auto sparse_seconds = [&](SparseMapping mapping,
+                                  std::vector<float>& result) {
+    return measure_best_seconds(
+        [&] {
+          std::vector<float> out(n * n);
+          sparse_last_axis(make_view(logits, shape), make_view(out, shape),
+                           mapping, SoftmaxMethod::kOpenMPSimd);
+          return out;
+        },
+        result);
+  };
+  const auto sparsemax_seconds =
+      sparse_seconds(SparseMapping::kSparsemax, sparsemax_probs);
+  const auto entmax_seconds =
+      sparse_seconds(SparseMapping::kEntmax15, entmax_probs);
+  // Классический sparsemax: сортировка строки и поиск порога по префиксам
+  const auto sort_seconds = measure_best_seconds(
+      [&] {
+        std::vector<float> out(n * n);
+#pragma omp parallel
+        {
+          std::vector<float> row(n);
+#pragma omp for
+          for (std::size_t r = 0; r < n; ++r) {
+            const float* x = &logits[r * n];
+            std::copy(x, x + n, row.begin());
+            std::sort(row.begin(), row.end(), std::greater<float>());
+            float prefix = 0.0f, tau = 0.0f;
+            for (std::size_t k = 0; k < n; ++k) {
+              prefix += row[k];
+              const float candidate = (prefix - 1.0f) / (k + 1);
+              if (row[k] > candidate) tau = candidate;
+            }
+            for (std::size_t j = 0; j < n; ++j) {
+              out[r * n + j] = std::max(x[j] - tau, 0.0f);
+            }
+          }
+        }
+        return out;
+      },
+      sorted);
+
+  const auto support = [&](const std::vector<float>& probs) {
+    const auto nonzero = std::count_if(probs.begin(), probs.end(),
+                                       [](float p) { return p > 0.0f; });
+    return static_cast<double>(nonzero) / n;
+  };
+  std::cout << "n = " << n << ", logits in [0, 8)\n";
+  std::cout << "softmax:           " << format_time(softmax_seconds, 4)
+            << " sec\n";
+  std::cout << "sparsemax (sort):  " << format_time(sort_seconds, 4)
+            << " sec, support " << support(sorted) << "\n";
+  std::cout << "sparsemax:         " << format_time(sparsemax_seconds, 4)
+            << " sec, support " << support(sparsemax_probs) << " (diff: "
+            << format_diff(max_abs_diff(sorted, sparsemax_probs)) << ")\n";
+  std::cout << "entmax-1.5:        " << format_time(entmax_seconds, 4)
+            << " sec, support " << support(entmax_probs) << "\n";
+}
+
+// Softmax, LayerNorm и RMSNorm на общем каркасе: одна и та же матрица,
+// скалярный однопоточный и векторный многопоточный варианты
+void report_normalization(std::size_t n) {
+  auto x = make_matrix(n);
+  for (float& v : x) v = 4.0f * v - 2.0f;
+  const auto gamma = make_values(n), beta = make_values(n);
+  const TensorShape shape({n, n});
+
+  const std::pair<std::string_view, SoftmaxMethod> methods[] = {
+      {"Sequential", SoftmaxMethod::kSequential},
+      {"OpenMP + SIMD", SoftmaxMethod::kOpenMPSimd}};
+  const auto report = [&](std::string_view op_name, const auto& op) {
+    for (const auto& [name, method] : methods) {
+      std::vector<float> result;
+      const double seconds = measure_best_seconds(
+          [&] {
+            std::vector<float> out(n * n);
+            reduce_map_rows(op, x.data(), n, out.data(), n, n, n, method);
+            return out;
+          },
+          result);
+      std::cout << op_name << ", " << name << ": "
+                << format_time(seconds, 4) << " sec\n";
+    }
+  };
+
+  LayerNormOp layer_norm_op;
+  layer_norm_op.gamma = gamma.data();
+  layer_norm_op.beta = beta.data();
+  RMSNormOp rms_norm_op;
+  rms_norm_op.gamma = gamma.data();
+  std::cout << "n = " << n << "\n";
+  report("Softmax", SoftmaxOp{});
+  report("LayerNorm", layer_norm_op);
+  report("RMSNorm", rms_norm_op);
+}
+
+// Ядра фиксированной длины против общего SoftmaxRowSimd в одном потоке;
+// рабочий набор 128 КиБ на вход и выход держится в L2, чтобы сравнивались
+// ядра, а не память
+void report_fixed_lengths() {
+  const std::size_t elements = 32 * 1024;
+  const int sweeps = 200;
+  const auto logits = make_values(elements);
+  std::cout << "Rows of fixed length, " << elements << " values x " << sweeps
+            << " sweeps\n";
+  for (const FixedSoftmaxEntry& entry : kFixedSoftmaxKernels) {
+    const std::size_t n = entry.cols;
+    const std::size_t rows = elements / n;
+    const auto sweep = [&](SoftmaxRowKernel kernel) {
+      std::vector<float> out(elements);
+      for (int s = 0; s < sweeps; ++s) {
+        for (std::size_t r = 0; r < rows; ++r) {
+          kernel(&logits[r * n], &out[r * n], n);
+        }
+      }
+      return out;
+    };
+    std::vector<float> generic, fixed;
+    const double generic_seconds =
+        measure_best_seconds([&] { return sweep(SoftmaxRowSimd); }, generic);
+    const double fixed_seconds =
+        measure_best_seconds([&] { return sweep(entry.kernel); }, fixed);
+    std::cout << "n = " << n << ": generic " << format_time(generic_seconds, 4)
+              << " sec, fixed " << format_time(fixed_seconds, 4)
+              << " sec (diff: " << format_diff(max_abs_diff(generic, fixed))
+              << ")\n";
+  }
+}
+
+// Ядра над Vec<float, W> на каждой доступной ширине против ручного AVX2
+void report_portable_vec() {
+  const std::size_t n = 1000, rows = 256;
+  const int sweeps = 20;
+  const auto logits = make_values(rows * n);
+  std::cout << "Softmax, " << rows << " rows x " << n << " cols x " << sweeps
+            << " sweeps, one thread\n";
+  std::vector<float> native;
+  const auto sweep = [&](SoftmaxRowKernel kernel) {
+    std::vector<float> out(rows * n);
+    for (int s = 0; s < sweeps; ++s) {
+      for (std::size_t r = 0; r < rows; ++r) {
+        kernel(&logits[r * n], &out[r * n], n);
+      }
+    }
+    return out;
+  };
+  const double native_seconds =
+      measure_best_seconds([&] { return sweep(SoftmaxRowSimd); }, native);
+  std::cout << "Production dispatch (SoftmaxRowSimd): "
+            << format_time(native_seconds, 4) << " sec\n";
+  const auto report_softmax = [&](std::string_view name,
+                                  SoftmaxRowKernel kernel) {
+    std::vector<float> out;
+    const double seconds =
+        measure_best_seconds([&] { return sweep(kernel); }, out);
+    std::cout << name << ": " << format_time(seconds, 4)
+              << " sec (diff: " << format_diff(max_abs_diff(native, out))
+              << ")\n";
+  };
+  report_softmax("SoftmaxRowVec<4> (SSE)", SoftmaxRowVec<4>);
+  report_softmax("SoftmaxRowVec<8> (AVX2)", SoftmaxRowVec<8>);
+#ifdef __AVX512F__
+  report_softmax("SoftmaxRowVec<16> (AVX-512)", SoftmaxRowVec<16>);
+#endif
+
+  const std::size_t m = 256;
+  const auto a = make_values(m * m);
+  const auto b = make_values(m * m);
+  const TensorShape shape({m, m});
+  std::cout << "GEMM " << m << "x" << m << "x" << m << ", one thread\n";
+  std::vector<float> scalar;
+  const double scalar_seconds = measure_best_seconds(
+      [&] { return gemm(a, b, m, m, m, GemmMethod::kSequential); }, scalar);
+  std::cout << "Scalar i-k-j: " << format_time(scalar_seconds, 4) << " sec\n";
+  const auto report_gemm = [&](std::string_view name, auto width) {
+    std::vector<float> c;
+    const double seconds = measure_best_seconds(
+        [&] {
+          std::vector<float> out(m * m);
+          gemm_vec<decltype(width)::value>(
+              make_view(a, shape), make_view(b, shape), make_view(out, shape),
+              GemmMethod::kSimd);
+          return out;
+        },
+        c);
+    std::cout << name << ": " << format_time(seconds, 4)
+              << " sec (diff: " << format_diff(max_abs_diff(scalar, c))
+              << ")\n";
+  };
+  report_gemm("GemmMicroKernel<4> (SSE, 4x8)",
+              std::integral_constant<std::size_t, 4>{});
+  report_gemm("GemmMicroKernel<8> (AVX2, 4x16)",
+              std::integral_constant<std::size_t, 8>{});
+#ifdef __AVX512F__
+  report_gemm("GemmMicroKernel<16> (AVX-512, 4x32)",
+              std::integral_constant<std::size_t, 16>{});
+#endif
+}
+
+// Softmax строки с последовательной суммой экспонент по дорожкам - схема
+// до попарного суммирования, для сравнения точности и времени
+void SoftmaxRowSerialSum(const float* row, float* out, std::size_t n) {
+  const std::size_t body = n / 8 * 8;
+  __m256 acc = _mm256_setzero_ps();
+  for (std::size_t i = 0; i < body; i += 8) {
+    const __m256 e = exp256_ps(loadu256_ps(row + i));
+    storeu256_ps(out + i, e);
+    acc = _mm256_add_ps(acc, e);
+  }
+  float sum = hsum256_ps(acc);
+  for (std::size_t i = body; i < n; ++i) {
+    out[i] = std::exp(row[i]);
+    sum += out[i];
+  }
+  const float scale = 1.0f / sum;
+  for (std::size_t i = 0; i < body; i += 8) {
+    storeu256_ps(out + i,
+                 _mm256_mul_ps(loadu256_ps(out + i), _mm256_set1_ps(scale)));
+  }
+  for (std::size_t i = body; i < n; ++i) out[i] *= scale;
+}
+
+// Последовательная и попарная сумма на одной длинной строке
+void report_pairwise(std::size_t n) {
+  const auto logits = make_values(n);
+  std::cout << "Softmax of one row, n = " << n << ", one thread\n";
+  const auto report_kernel = [&](std::string_view name,
+                                 SoftmaxRowKernel kernel) {
+    std::vector<float> y;
+    const double seconds = measure_best_seconds(
+        [&] {
+          std::vector<float> out(n);
+          kernel(logits.data(), out.data(), n);
+          return out;
+        },
+        y, 9);
+    std::cout << name << ": " << format_time(seconds, 4)
+              << " sec, max relative error "
+              << format_diff(softmax_relative_error(logits, y)) << "\n";
+  };
+  report_kernel("Serial lane sums", SoftmaxRowSerialSum);
+  report_kernel("Pairwise blocks (SoftmaxRowSimd)", SoftmaxRowSimd);
+}
+
+// Быстрый и воспроизводимый порядок редукций на строке из n значений
+void report_reproducible(std::size_t n) {
+  const auto values = make_values(n);
+  const std::vector<std::size_t> offsets = {0, n};
+  const std::size_t cols = 1024, rows = std::max<std::size_t>(1, n / cols);
+  const auto logits = make_values(rows * cols);
+  const TensorShape shape({rows, cols});
+  std::vector<std::size_t> targets(rows);
+  for (std::size_t r = 0; r < rows; ++r) targets[r] = r % cols;
+  std::cout << "n = " << n << ", " << omp_get_max_threads() << " threads\n";
+
+  const auto report_pair = [](std::string_view name, const auto& run) {
+    std::vector<float> fast, reproducible;
+    const double fast_seconds = measure_best_seconds(
+        [&] { return run(ReductionOrder::kFast); }, fast, 9);
+    const double reproducible_seconds = measure_best_seconds(
+        [&] { return run(ReductionOrder::kReproducible); }, reproducible, 9);
+    std::cout << name << ": fast " << format_time(fast_seconds, 5)
+              << " sec, reproducible " << format_time(reproducible_seconds, 5)
+              << " sec (diff: "
+              << format_diff(max_abs_diff(fast, reproducible)) << ")\n";
+  };
+  report_pair("CSR segment of n", [&](ReductionOrder order) {
+    std::vector<float> output(n);
+    softmax_segments(values.data(), output.data(), offsets.data(), 1,
+                     SoftmaxMethod::kOpenMPSimd, DenormalMode::kPreserve,
+                     order);
+    return output;
+  });
+  report_pair("Softmax state of n", [&](ReductionOrder order) {
+    const SoftmaxState state =
+        softmax_state(values.data(), n, SoftmaxMethod::kOpenMPSimd, order);
+    return std::vector<float>{state.max, state.sum};
+  });
+  report_pair("Mean cross-entropy, " + std::to_string(rows) + " x " +
+                  std::to_string(cols),
+              [&](ReductionOrder order) {
+                return std::vector<float>{softmax_cross_entropy(
+                    make_view(logits, shape), targets.data(), 0.0f, nullptr,
+                    {}, SoftmaxMethod::kOpenMPSimd, DenormalMode::kPreserve,
+                    order)};
+              });
+}
+
+// Цена флагов состояния: softmax_rows против softmax_rows_health
+void report_health(std::size_t n) {
+  // Длина строки вне kFixedSoftmaxKernels: оба пути идут через общий каркас
+  const std::size_t cols = n + 3;
+  auto logits = make_values(n * cols);
+  for (std::size_t r = 0; r < n; r += 97) {
+    logits[r * cols + r % cols] = std::numeric_limits<float>::quiet_NaN();
+  }
+  std::cout << "Matrix " << n << " x " << cols << ", "
+            << omp_get_max_threads() << " threads\n";
+
+  std::vector<RowHealth> health(n);
+  for (SoftmaxMethod method :
+       {SoftmaxMethod::kSimd, SoftmaxMethod::kOpenMPSimd}) {
+    std::vector<float> plain, checked;
+    const double plain_seconds = measure_best_seconds(
+        [&] {
+          std::vector<float> out(n * cols);
+          softmax_rows(logits.data(), cols, out.data(), cols, n, cols, method);
+          return out;
+        },
+        plain, 9);
+    const double checked_seconds = measure_best_seconds(
+        [&] {
+          std::vector<float> out(n * cols);
+          softmax_rows_health(logits.data(), cols, out.data(), cols, n, cols,
+                              health.data(), method);
+          return out;
+        },
+        checked, 9);
+    std::cout << (method == SoftmaxMethod::kSimd ? "SIMD" : "OpenMP + SIMD")
+              << ": plain " << format_time(plain_seconds, 4)
+              << " sec, with health flags " << format_time(checked_seconds, 4)
+              << " sec\n";
+  }
+  std::cout << "Row health: "
+            << format_health(summarize_health(health.data(), n)) << "\n";
+}
+
+// Печать каждого элемента (как PrintData) против сводки матрицы n x n
+void report_summary(std::size_t n) {
+  auto values = make_matrix(n, InputDistribution::kWideRange);
+  for (std::size_t i = 0; i < values.size(); i += 100003) {
+    values[i] = std::numeric_limits<float>::quiet_NaN();
+  }
+  std::cout << "Matrix " << n << " x " << n << ", " << omp_get_max_threads()
+            << " threads\n";
+
+  // Вывод в строку, а не в терминал: время форматирования без вывода
+  std::vector<float> printed;
+  const double print_seconds = measure_best_seconds(
+      [&] {
+        std::ostringstream out;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+          out << std::setw(10) << values[i];
+          if (i % 16 == 15) out << std::endl;
+        }
+        return std::vector<float>{static_cast<float>(out.str().size())};
+      },
+      printed, 1);
+  std::cout << "Print every element: " << format_time(print_seconds, 4)
+            << " sec, " << static_cast<std::size_t>(printed[0])
+            << " characters\n";
+
+  const auto report_type = [&](std::string_view name, const auto& typed) {
+    TensorSummary summary;
+    std::vector<float> unused;
+    const double seconds = measure_best_seconds(
+        [&] {
+          summary = summarize_tensor(typed.data(), typed.size());
+          return std::vector<float>{};
+        },
+        unused, 9);
+    std::cout << name << " summary: " << format_time(seconds, 4) << " sec\n";
+    return summary;
+  };
+  const TensorSummary summary = report_type("float32", values);
+  report_type("float16", convert_from_float<Half>(values));
+  report_type("bfloat16", convert_from_float<BFloat16>(values));
+  std::vector<std::int8_t> int8(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    int8[i] = static_cast<std::int8_t>(i * 37 % 256 - 128);
+  }
+  report_type("int8", int8);
+  std::cout << format_summary(summary);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // Если запуск с флагом --test, выполняем тестирование
+  if (argc == 2 && std::string(argv[1]) == "--test") {
+    return run_all_tests() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // Если запуск с флагом --debug N, выполняем отладку для конкретного размера
+  if (argc == 3 && std::string(argv[1]) == "--debug") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    debug_single_test(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --masked N, сравниваем способы маскирования
+  if (argc == 3 && std::string(argv[1]) == "--masked") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_masked(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --backward N, проверяем обратный проход
+  if (argc == 3 && std::string(argv[1]) == "--backward") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_backward(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --vec, сравниваем ширины Vec<float, W>
+  if (argc == 2 && std::string(argv[1]) == "--vec") {
+    report_portable_vec();
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --fixed, сравниваем ядра фиксированной длины
+  if (argc == 2 && std::string(argv[1]) == "--fixed") {
+    report_fixed_lengths();
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --pairwise N, сравниваем суммы на длинной строке
+  if (argc == 3 && std::string(argv[1]) == "--pairwise") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_pairwise(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --reproducible N, замеряем цену фиксированного
+  // порядка редукций
+  if (argc == 3 && std::string(argv[1]) == "--reproducible") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_reproducible(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --health N, замеряем цену флагов состояния строк
+  if (argc == 3 && std::string(argv[1]) == "--health") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_health(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --summary N, сравниваем сводку с печатью элементов
+  if (argc == 3 && std::string(argv[1]) == "--summary") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_summary(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --norm N, замеряем операции общего каркаса строк
+  if (argc == 3 && std::string(argv[1]) == "--norm") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_normalization(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --dropout N, сравниваем слитый dropout с отдельным
+  if (argc == 3 && std::string(argv[1]) == "--dropout") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_dropout(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --half N, сравниваем хранение в fp16/bf16
+  if (argc == 3 && std::string(argv[1]) == "--half") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_half(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --quantized N, сравниваем int8/int32 пути с float
+  if (argc == 3 && std::string(argv[1]) == "--quantized") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_quantized(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --lazy N, переносим нормализацию в эпилог GEMM
+  if (argc == 3 && std::string(argv[1]) == "--lazy") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_lazy(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --decode S, сравниваем пересчёт и состояние Softmax
+  if (argc == 3 && std::string(argv[1]) == "--decode") {
+    std::size_t steps = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_decode(steps);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --sparse N, сравниваем sparsemax/entmax с Softmax
+  if (argc == 3 && std::string(argv[1]) == "--sparse") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_sparse(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Если запуск с флагом --denormals N, сравниваем режимы FTZ/DAZ
+  if (argc == 3 && std::string(argv[1]) == "--denormals") {
+    std::size_t n = static_cast<std::size_t>(std::stoul(argv[2]));
+    report_denormal_impact(n);
+    return EXIT_SUCCESS;
+  }
+
+  // Обычный режим работы
+  try {
+    // --attention [B H S]: батч Softmax внимания; без размеров - набор
+    // типичных форм
+    if (argc >= 2 && std::string(argv[1]) == "--attention") {
+      if (argc == 5) {
+        report_attention(std::stoul(argv[2]), std::stoul(argv[3]),
+                         std::stoul(argv[4]));
+        return EXIT_SUCCESS;
+      }
+      const std::size_t shapes[][3] = {{1, 12, 128}, {8, 12, 128},
+                                       {32, 8, 64},  {4, 16, 512},
+                                       {1, 32, 1024}, {1, 12, 2048}};
+      for (const auto& bhs : shapes) {
+        report_attention(bhs[0], bhs[1], bhs[2]);
+      }
+      return EXIT_SUCCESS;
+    }
+
+    // --prologue B H S: масштаб, bias, ALiBi и температура в проходе Softmax
+    if (argc == 5 && std::string(argv[1]) == "--prologue") {
+      report_prologue(std::stoul(argv[2]), std::stoul(argv[3]),
+                      std::stoul(argv[4]));
+      return EXIT_SUCCESS;
+    }
+
+    // --segments N: N сегментов степенной длины в одном буфере
+    if (argc == 3 && std::string(argv[1]) == "--segments") {
+      report_segments(std::stoul(argv[2]));
+      return EXIT_SUCCESS;
+    }
+
+    // --hsoftmax V D: log p(target) по словарю V с векторами размера D
+    if (argc == 4 && std::string(argv[1]) == "--hsoftmax") {
+      report_hierarchical(std::stoul(argv[2]), std::stoul(argv[3]));
+      return EXIT_SUCCESS;
+    }
+
+    // --sample R V K: top-K и сэмплирование по R строкам словаря размера V
+    if (argc == 5 && std::string(argv[1]) == "--sample") {
+      report_sampling(std::stoul(argv[2]), std::stoul(argv[3]),
+                      std::stoul(argv[4]));
+      return EXIT_SUCCESS;
+    }
+
+    // --loss R V: cross-entropy по R строкам словаря размера V
+    if (argc == 4 && std::string(argv[1]) == "--loss") {
+      report_cross_entropy(std::stoul(argv[2]), std::stoul(argv[3]));
+      return EXIT_SUCCESS;
+    }
+
+    // --axis k d0 d1 ... dk: Softmax вдоль оси k тензора
+    if (argc >= 4 && std::string(argv[1]) == "--axis") {
+      const std::size_t axis = static_cast<std::size_t>(std::stoul(argv[2]));
+      std::vector<std::size_t> dims;
+      for (int i = 3; i < argc; ++i) {
+        dims.push_back(static_cast<std::size_t>(std::stoul(argv[i])));
+      }
+      const TensorShape shape(dims);
+      if (shape.numel() == 0) {
+        throw std::invalid_argument("Tensor dimensions must be positive");
+      }
+      report_axis(shape, axis);
+      return EXIT_SUCCESS;
+    }
+
+    // --shape d0 d1 ... dk: Softmax по последней оси тензора
+    if (argc >= 3 && std::string(argv[1]) == "--shape") {
+      std::vector<std::size_t> dims;
+      for (int i = 2; i < argc; ++i) {
+        dims.push_back(static_cast<std::size_t>(std::stoul(argv[i])));
+      }
+      const TensorShape shape(dims);
+      if (shape.numel() == 0) {
+        throw std::invalid_argument("Tensor dimensions must be positive");
+      }
+      report_tensor(shape);
+      return EXIT_SUCCESS;
+    }
+
+    if (argc != 2) {
+      std::cerr << "Usage: " << argv[0] << " <matrix_size_n>\n";
+      std::cerr << "       " << argv[0] << " --test     (запуск всех тестов)\n";
+      std::cerr << "       " << argv[0]
+                << " --debug N  (отладка для размера N)\n";
+      std::cerr << "       " << argv[0]
+                << " --denormals N  (замер FTZ/DAZ на широких логитах)\n";
+      std::cerr << "       " << argv[0]
+                << " --shape d0 ... dk  (Softmax по последней оси тензора)\n";
+      std::cerr << "       " << argv[0]
+                << " --axis k d0 ... dk  (Softmax вдоль оси k)\n";
+      std::cerr << "       " << argv[0]
+                << " --attention [B H S]  (батч Softmax внимания)\n";
+      std::cerr << "       " << argv[0]
+                << " --masked N  (Softmax со встроенной маской)\n";
+      std::cerr << "       " << argv[0]
+                << " --prologue B H S  (пролог Softmax в одном проходе)\n";
+      std::cerr << "       " << argv[0]
+                << " --loss R V  (слитые log-softmax и cross-entropy)\n";
+      std::cerr << "       " << argv[0]
+                << " --sample R V K  (top-k и сэмплирование без Softmax)\n";
+      std::cerr << "       " << argv[0]
+                << " --backward N  (обратный проход против double)\n";
+      std::cerr << "       " << argv[0]
+                << " --half N  (хранение в fp16/bf16, вычисления во float)\n";
+      std::cerr << "       " << argv[0]
+                << " --quantized N  (int8/int32 логиты, табличная exp)\n";
+      std::cerr << "       " << argv[0]
+                << " --lazy N  (нормализация Softmax в эпилоге GEMM)\n";
+      std::cerr << "       " << argv[0]
+                << " --decode S  (потоковое состояние Softmax, S шагов)\n";
+      std::cerr << "       " << argv[0]
+                << " --segments N  (Softmax по N сегментам CSR)\n";
+      std::cerr << "       " << argv[0]
+                << " --hsoftmax V D  (двухуровневый Softmax по словарю V)\n";
+      std::cerr << "       " << argv[0]
+                << " --sparse N  (sparsemax и entmax-1.5 против Softmax)\n";
+      std::cerr << "       " << argv[0]
+                << " --dropout N  (Softmax + dropout в одном проходе)\n";
+      std::cerr << "       " << argv[0]
+                << " --norm N  (Softmax, LayerNorm и RMSNorm на общем ядре)\n";
+      std::cerr << "       " << argv[0]
+                << " --fixed  (ядра фиксированной длины против общего)\n";
+      std::cerr << "       " << argv[0]
+                << " --vec  (Vec<float, W> на всех ширинах против AVX2)\n";
+      std::cerr << "       " << argv[0]
+                << " --pairwise N  (попарная сумма против последовательной)\n";
+      std::cerr << "       " << argv[0]
+                << " --reproducible N  (цена воспроизводимых редукций)\n";
+      std::cerr << "       " << argv[0]
+                << " --health N  (флаги NaN/Inf/опустошения строк)\n";
+      std::cerr << "       " << argv[0]
+                << " --summary N  (сводка тензора против печати элементов)\n";
+      return EXIT_FAILURE;
+    }
+
+    const std::size_t n = static_cast<std::size_t>(std::stoul(argv[1]));
+    if (n == 0) {
+      throw std::invalid_argument("Matrix size must be positive");
+    }
+
+    const auto input = make_matrix(n);
+
+    // Базовая последовательная версия
+    std::vector<float> sequential_result;
+    const double sequential_seconds = measure_seconds(
+        [&]() { return run_sequential(input, n); }, sequential_result);
+
+    // Тестируем оптимизированные версии
+    auto omp_res = run_test_case([&] { return run_openmp(input, n); },
+                                 sequential_result, "OpenMP");
+    auto simd_res = run_test_case([&] { return run_simd(input, n); },
+                                  sequential_result, "SIMD");
+    auto omp_simd_res = run_test_case([&] { return run_openmp_simd(input, n); },
+                                      sequential_result, "OpenMP + SIMD");
+
+    // Вывод результатов
+    std::cout << "Sequential: " << format_time(sequential_seconds) << " sec\n";
+    print_report("OpenMP", omp_res);
+    print_report("SIMD", simd_res);
+    print_report("OpenMP + SIMD", omp_simd_res);
+
+    // Сводка флагов состояния строк входа
+    std::vector<float> checked(n * n);
+    std::vector<RowHealth> health(n);
+    softmax_rows_health(input.data(), n, checked.data(), n, n, n,
+                        health.data(), SoftmaxMethod::kOpenMPSimd);
+    std::cout << "Row health: "
+              << format_health(summarize_health(health.data(), n)) << "\n";
 
     return EXIT_SUCCESS;
   } catch (const std::exception& ex) {
@@ -0,0 +1,165 @@
+/**
+ * @file normalization.h
+ * @brief LayerNorm и RMSNorm по последней оси на каркасе row_reduce.h
+ *
+ * Обе нормализации - та же схема, что у Softmax: суммы по строке, параметры
+ * строки, поэлементный map с весами по столбцам. Векторный путь, хвост под
+ * маской и запуск по строкам берутся из RowReduceMapSimd и reduce_map_rows.
+ */
+
+#ifndef NORMALIZATION_H
+#define NORMALIZATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "row_reduce.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+/**
+ * @brief y = (x - mean) / sqrt(var + eps) * gamma + beta
+ *
+ * Суммы x и x^2 считаются за один проход относительно первого элемента
+ * строки (pivot): для активаций с большим средним E[x^2] - mean^2 иначе
+ * теряет значащие цифры дисперсии. По той же причине map вычитает pivot и
+ * малую поправку shift по отдельности, а не округлённое до float среднее.
+ * gamma и beta (cols значений) могут быть nullptr - тогда множитель 1 и
+ * сдвиг 0.
+ */
+struct LayerNormOp {
+  static constexpr std::size_t kTerms = 2;
+  static constexpr bool kMapStored = false;
+
+  struct Params {
+    float shift;  // mean - pivot
+    float rstd;   // 1 / sqrt(var + eps)
+  };
+
+  const float* gamma = nullptr;
+  const float* beta = nullptr;
+  float eps = 1e-5f;
+  float pivot = 0.0f;
+
+  LayerNormOp at_row(const float* row, std::size_t) const {
+    LayerNormOp op = *this;
+    op.pivot = row[0];
+    return op;
+  }
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> x, const RowLanes<W>&,
+              Vec<float, W>* terms) const {
+    const auto d = x - Vec<float, W>::broadcast(pivot);
+    terms[0] = d;
+    terms[1] = d * d;
+  }
+  void reduce(float x, std::size_t, float* terms) const {
+    const float d = x - pivot;
+    terms[0] = d;
+    terms[1] = d * d;
+  }
+
+  Params combine(const float* sums, std::size_t n) const {
+    const float shift = sums[0] / n;
+    const float var = std::max(sums[1] / n - shift * shift, 0.0f);
+    return {shift, 1.0f / std::sqrt(var + eps)};
+  }
+
+  template <std::size_t W>
+  Vec<float, W> map(Vec<float, W> x, const RowLanes<W>& lanes,
+                    const Params& p) const {
+    using V = Vec<float, W>;
+    const V d = x - V::broadcast(pivot);
+    V y = (d - V::broadcast(p.shift)) * V::broadcast(p.rstd);
+    if (gamma != nullptr) y = y * lanes.load(gamma);
+    if (beta != nullptr) y = y + lanes.load(beta);
+    return y;
+  }
+  float map(float x, std::size_t j, const Params& p) const {
+    float y = ((x - pivot) - p.shift) * p.rstd;
+    if (gamma != nullptr) y *= gamma[j];
+    if (beta != nullptr) y += beta[j];
+    return y;
+  }
+};
+
+// y = x / sqrt(mean(x^2) + eps) * gamma; gamma может быть nullptr
+struct RMSNormOp {
+  static constexpr std::size_t kTerms = 1;
+  static constexpr bool kMapStored = false;
+
+  struct Params {
+    float rstd;  // 1 / sqrt(mean(x^2) + eps)
+  };
+
+  const float* gamma = nullptr;
+  float eps = 1e-6f;
+
+  RMSNormOp at_row(const float*, std::size_t) const { return *this; }
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> x, const RowLanes<W>&,
+              Vec<float, W>* terms) const {
+    terms[0] = x * x;
+  }
+  void reduce(float x, std::size_t, float* terms) const { terms[0] = x * x; }
+
+  Params combine(const float* sums, std::size_t n) const {
+    return {1.0f / std::sqrt(sums[0] / n + eps)};
+  }
+
+  template <std::size_t W>
+  Vec<float, W> map(Vec<float, W> x, const RowLanes<W>& lanes,
+                    const Params& p) const {
+    const auto y = x * Vec<float, W>::broadcast(p.rstd);
+    return gamma != nullptr ? y * lanes.load(gamma) : y;
+  }
+  float map(float x, std::size_t j, const Params& p) const {
+    const float y = x * p.rstd;
+    return gamma != nullptr ? y * gamma[j] : y;
+  }
+};
+
+// Построчная операция op по последней оси; ведущие оси должны сворачиваться
+// в строки
+template <typename Op>
+inline void reduce_map_last_axis(const Op& op, TensorView<const float> input,
+                                 TensorView<float> output,
+                                 SoftmaxMethod method,
+                                 DenormalMode mode = DenormalMode::kPreserve) {
+  if (input.shape.dims != output.shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (input.numel() == 0) return;
+  reduce_map_rows(op, input.data, input.shape.row_stride(), output.data,
+                  output.shape.row_stride(), input.shape.rows(),
+                  input.shape.last_dim(), method, mode);
+}
+
+// LayerNorm по последней оси; gamma и beta - last_dim() значений или nullptr
+inline void layer_norm(TensorView<const float> input,
+                       TensorView<float> output, const float* gamma,
+                       const float* beta, float eps, SoftmaxMethod method,
+                       DenormalMode mode = DenormalMode::kPreserve) {
+  LayerNormOp op;
+  op.gamma = gamma;
+  op.beta = beta;
+  op.eps = eps;
+  reduce_map_last_axis(op, input, output, method, mode);
+}
+
+// RMSNorm по последней оси; gamma - last_dim() значений или nullptr
+inline void rms_norm(TensorView<const float> input, TensorView<float> output,
+                     const float* gamma, float eps, SoftmaxMethod method,
+                     DenormalMode mode = DenormalMode::kPreserve) {
+  RMSNormOp op;
+  op.gamma = gamma;
+  op.eps = eps;
+  reduce_map_last_axis(op, input, output, method, mode);
+}
+
+#endif  // !NORMALIZATION_H
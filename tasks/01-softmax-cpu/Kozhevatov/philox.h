@@ -0,0 +1,141 @@
+/**
+ * @file philox.h
+ * @brief Счётчиковый генератор Philox4x32-10 (скалярный и AVX2)
+ *
+ * Случайное число - чистая функция ключа (seed) и счётчика (строка, блок
+ * столбцов), без состояния: одинаковый результат при любом числе потоков и
+ * любом порядке обхода, и обратный проход может заново получить те же числа.
+ * AVX2 версия вычисляет 8 счётчиков параллельно (32 числа за вызов).
+ *
+ * Salmon et al., "Parallel random numbers: as easy as 1, 2, 3" (SC'11).
+ */
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <immintrin.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+constexpr std::uint32_t kPhiloxM0 = 0xD2511F53;
+constexpr std::uint32_t kPhiloxM1 = 0xCD9E8D57;
+constexpr std::uint32_t kPhiloxW0 = 0x9E3779B9;
+constexpr std::uint32_t kPhiloxW1 = 0xBB67AE85;
+
+// Столбцов на один блок AVX2 генератора: 8 счётчиков × 4 выхода
+constexpr std::size_t kPhiloxBlockCols = 32;
+
+// Philox4x32-10 для одного счётчика
+inline std::array<std::uint32_t, 4> philox4x32(
+    std::array<std::uint32_t, 4> ctr, std::uint32_t k0, std::uint32_t k1) {
+  for (int round = 0; round < 10; ++round) {
+    const std::uint64_t p0 = std::uint64_t{kPhiloxM0} * ctr[0];
+    const std::uint64_t p1 = std::uint64_t{kPhiloxM1} * ctr[2];
+    ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+           static_cast<std::uint32_t>(p1),
+           static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+           static_cast<std::uint32_t>(p0)};
+    k0 += kPhiloxW0;
+    k1 += kPhiloxW1;
+  }
+  return ctr;
+}
+
+// Старшие 32 бита произведений 8 пар 32-битных чисел
+static inline __m256i mulhi_epu32(__m256i a, __m256i b) {
+  const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+  const __m256i odd =
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+// Philox4x32-10 для 8 счётчиков; ctr[i] - i-е слово счётчика каждой дорожки
+static inline void philox4x32_avx2(__m256i ctr[4], std::uint32_t k0,
+                                   std::uint32_t k1) {
+  const __m256i m0 = _mm256_set1_epi32(static_cast<int>(kPhiloxM0));
+  const __m256i m1 = _mm256_set1_epi32(static_cast<int>(kPhiloxM1));
+  for (int round = 0; round < 10; ++round) {
+    const __m256i key0 = _mm256_set1_epi32(static_cast<int>(k0));
+    const __m256i key1 = _mm256_set1_epi32(static_cast<int>(k1));
+    const __m256i hi0 = mulhi_epu32(ctr[0], m0);
+    const __m256i lo0 = _mm256_mullo_epi32(ctr[0], m0);
+    const __m256i hi1 = mulhi_epu32(ctr[2], m1);
+    const __m256i lo1 = _mm256_mullo_epi32(ctr[2], m1);
+    ctr[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, ctr[1]), key0);
+    ctr[1] = lo1;
+    ctr[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, ctr[3]), key1);
+    ctr[3] = lo0;
+    k0 += kPhiloxW0;
+    k1 += kPhiloxW1;
+  }
+}
+
+/**
+ * @brief Случайные биты для (seed, stream, row, col)
+ *
+ * Счётчик блока из kPhiloxBlockCols столбцов: (block * 8 + lane, row_lo,
+ * row_hi, stream); выход j дорожки lane соответствует столбцу
+ * block * 32 + j * 8 + lane. Так AVX2 генератор выдаёт 4 вектора по 8
+ * соседних столбцов без перестановок, а скалярная функция - те же числа.
+ * stream разделяет независимые потоки чисел (сэмплирование, dropout).
+ */
+inline std::uint32_t philox_bits(std::uint64_t seed, std::uint32_t stream,
+                                 std::uint64_t row, std::uint64_t col) {
+  const std::uint64_t block = col / kPhiloxBlockCols;
+  const std::uint32_t rem = static_cast<std::uint32_t>(col % kPhiloxBlockCols);
+  const auto out = philox4x32(
+      {static_cast<std::uint32_t>(block * 8 + rem % 8),
+       static_cast<std::uint32_t>(row), static_cast<std::uint32_t>(row >> 32),
+       stream},
+      static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32));
+  return out[rem / 8];
+}
+
+// 32 случайных слова для столбцов [block * 32, block * 32 + 32) строки row
+// (скалярно): bits[c] - столбец block * 32 + c
+inline void philox_block(std::uint64_t seed, std::uint32_t stream,
+                         std::uint64_t row, std::uint64_t block,
+                         std::uint32_t bits[kPhiloxBlockCols]) {
+  for (std::uint32_t lane = 0; lane < 8; ++lane) {
+    const auto out = philox4x32(
+        {static_cast<std::uint32_t>(block * 8 + lane),
+         static_cast<std::uint32_t>(row),
+         static_cast<std::uint32_t>(row >> 32), stream},
+        static_cast<std::uint32_t>(seed),
+        static_cast<std::uint32_t>(seed >> 32));
+    for (std::size_t j = 0; j < 4; ++j) bits[j * 8 + lane] = out[j];
+  }
+}
+
+// То же для AVX2: bits[j] - столбцы block * 32 + j * 8 + (0..7)
+static inline void philox_block_avx2(std::uint64_t seed, std::uint32_t stream,
+                                     std::uint64_t row, std::uint64_t block,
+                                     __m256i bits[4]) {
+  const auto word = [](std::uint64_t value) {
+    return _mm256_set1_epi32(
+        static_cast<int>(static_cast<std::uint32_t>(value)));
+  };
+  bits[0] = _mm256_add_epi32(word(block * 8),
+                             _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  bits[1] = word(row);
+  bits[2] = word(row >> 32);
+  bits[3] = word(stream);
+  philox4x32_avx2(bits, static_cast<std::uint32_t>(seed),
+                  static_cast<std::uint32_t>(seed >> 32));
+}
+
+// Равномерное число в (0, 1) из 23 старших бит: (k + 0.5) / 2^23 точно
+// представимо во float и не равно ни 0, ни 1 (безопасно под логарифм)
+inline float bits_to_open_unit(std::uint32_t bits) {
+  return (static_cast<float>(bits >> 9) + 0.5f) * (1.0f / 8388608.0f);
+}
+
+static inline __m256 bits_to_open_unit_ps(__m256i bits) {
+  const __m256 mantissa = _mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 9));
+  return _mm256_mul_ps(_mm256_add_ps(mantissa, _mm256_set1_ps(0.5f)),
+                       _mm256_set1_ps(1.0f / 8388608.0f));
+}
+
+#endif  // !PHILOX_H
@@ -0,0 +1,253 @@
+/**
+ * @file row_reduce.h
+ * @brief Общий каркас построчных ядер: редукция, свёртка, поэлементный map
+ *
+ * Softmax, LayerNorm и RMSNorm устроены одинаково: проход по строке копит
+ * суммы поэлементных слагаемых, из сумм получаются параметры строки, второй
+ * проход поэлементно пишет результат. Каркас реализует оба прохода один раз -
+ * скалярно и над Vec<float, W> с хвостом под маской (без скалярного
+ * остатка), а операция описывается функтором:
+ *
+ * @code
+ * struct Op {
+ *   static constexpr std::size_t kTerms = R;  // число сумм (1..4)
+ *   static constexpr bool kMapStored = ...;   // map читает слагаемое 0,
+ *                                             // сохранённое в out
+ *   struct Params;                            // параметры строки
+ *   Op at_row(const float* row, std::size_t n) const;  // привязка к строке
+ *   template <std::size_t W>
+ *   void reduce(Vec<float, W> x, const RowLanes<W>& lanes,
+ *               Vec<float, W> terms[R]) const;
+ *   void reduce(float x, std::size_t j, float terms[R]) const;
+ *   Params combine(const float sums[R], std::size_t n) const;
+ *   template <std::size_t W>
+ *   Vec<float, W> map(Vec<float, W> v, const RowLanes<W>& lanes,
+ *                     const Params& p) const;
+ *   float map(float v, std::size_t j, const Params& p) const;
+ * };
+ * @endcode
+ *
+ * Векторные методы - шаблоны по ширине: операция пишется один раз и
+ * собирается под SSE, AVX2 и AVX-512, рабочая ширина - NativeVec.
+ * Столбцы (RowLanes в векторной версии, j в скалярной) доступны и в
+ * reduce, и в map: операции, зависящие от столбца (смещения по ключам,
+ * ALiBi), читают по ним свои данные.
+ *
+ * Новая построчная операция получает векторный путь, хвост под маской и
+ * запуск по строкам (reduce_map_rows в softmax_kernels.h) без своего кода.
+ */
+
+#ifndef ROW_REDUCE_H
+#define ROW_REDUCE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "simd_vec.h"
+
+/**
+ * @brief Столбцы одного вектора в reduce и map: полные W или хвост
+ *
+ * Через load операция читает свои векторы по столбцам (gamma, beta,
+ * смещения) без выхода за конец строки.
+ */
+template <std::size_t W>
+struct RowLanes {
+  using V = Vec<float, W>;
+
+  std::size_t j;      // первый столбец вектора
+  std::size_t count;  // дорожек внутри строки (W, кроме хвоста)
+
+  V load(const float* column_values) const {
+    return count == W ? V::load(column_values + j)
+                      : V::load_tail(column_values + j, count);
+  }
+
+  // Номера столбцов дорожек во float
+  V columns() const {
+    return V::broadcast(static_cast<float>(j)) + V::iota();
+  }
+};
+
+// Максимум строки (-inf для пустой); скалярно или над NativeVec
+inline float RowMax(const float* row, std::size_t n, bool simd) {
+  float max = -std::numeric_limits<float>::infinity();
+  std::size_t i = 0;
+  if (simd) {
+    NativeVec max_vec = NativeVec::broadcast(max);
+    for (; i + kVecLanes <= n; i += kVecLanes) {
+      max_vec = vmax(max_vec, NativeVec::load(row + i));
+    }
+    max = vreduce_max(max_vec);
+  }
+  for (; i < n; ++i) max = std::max(max, row[i]);
+  return max;
+}
+
+// Проход суммы скалярной версии каркаса: последовательные суммы, при
+// kMapStored слагаемое 0 сохраняется в out
+template <typename Op>
+inline void RowReduce(const Op& row_op, const float* row, float* out,
+                      std::size_t n, float* sums) {
+  for (std::size_t k = 0; k < Op::kTerms; ++k) sums[k] = 0.0f;
+  for (std::size_t j = 0; j < n; ++j) {
+    float terms[Op::kTerms];
+    row_op.reduce(row[j], j, terms);
+    for (std::size_t k = 0; k < Op::kTerms; ++k) sums[k] += terms[k];
+    if (Op::kMapStored) out[j] = terms[0];
+  }
+}
+
+// Скалярная версия каркаса; возвращает параметры строки (пустая строка -
+// параметры по умолчанию)
+template <typename Op>
+inline typename Op::Params RowReduceMap(const Op& op, const float* row,
+                                        float* out, std::size_t n) {
+  if (n == 0) return {};
+  const Op row_op = op.at_row(row, n);
+  float sums[Op::kTerms];
+  RowReduce(row_op, row, out, n, sums);
+  const auto params = row_op.combine(sums, n);
+  const float* source = Op::kMapStored ? out : row;
+  for (std::size_t j = 0; j < n; ++j) {
+    out[j] = row_op.map(source[j], j, params);
+  }
+  return params;
+}
+
+/**
+ * @brief Проход суммы векторной версии каркаса
+ *
+ * Суммы копятся в векторах (горизонтальная сумма - одна на строку) блоками
+ * по kPairwiseBlock векторов, блоки складываются попарно (PairwiseSum), так
+ * что длинные строки не теряют точность сумм. Хвост читается загрузкой под
+ * маской, а его слагаемые обнуляются, поэтому reduce не обязан давать ноль
+ * на нулевом входе. row_op уже привязан к строке; при kMapStored слагаемое
+ * 0 сохраняется в out. Отдельно от map нужен тем, кто сам делит строку на
+ * части (огромные сегменты, куски состояния Softmax): ему достаточно
+ * kTerms, kMapStored и reduce.
+ *
+ * @param sums Op::kTerms сумм строки (пустая строка - нули)
+ */
+template <std::size_t W = kVecLanes, typename Op>
+inline void RowReduceSimd(const Op& row_op, const float* row, float* out,
+                          std::size_t n, float* sums) {
+  using V = Vec<float, W>;
+  const std::size_t body = n / W * W;
+
+  PairwiseSum<V, Op::kTerms> pairwise;
+  std::size_t i = 0;
+  while (i < body) {
+    const std::size_t block_end = std::min(body, i + W * kPairwiseBlock);
+    V acc[Op::kTerms];
+    for (std::size_t k = 0; k < Op::kTerms; ++k) acc[k] = V::zero();
+    for (; i < block_end; i += W) {
+      V terms[Op::kTerms];
+      row_op.reduce(V::load(row + i), RowLanes<W>{i, W}, terms);
+      for (std::size_t k = 0; k < Op::kTerms; ++k) acc[k] = acc[k] + terms[k];
+      if (Op::kMapStored) terms[0].store(out + i);
+    }
+    pairwise.push(acc);
+  }
+  if (i < n) {
+    const std::size_t tail = n - body;
+    V terms[Op::kTerms];
+    row_op.reduce(V::load_tail(row + i, tail), RowLanes<W>{i, tail}, terms);
+    for (std::size_t k = 0; k < Op::kTerms; ++k) {
+      terms[k] = vkeep_first(terms[k], tail);
+    }
+    if (Op::kMapStored) terms[0].store_tail(out + i, tail);
+    pairwise.push(terms);
+  }
+
+  V totals[Op::kTerms];
+  pairwise.total(totals);
+  for (std::size_t k = 0; k < Op::kTerms; ++k) {
+    sums[k] = vreduce_add(totals[k]);
+  }
+}
+
+/**
+ * @brief Сумма строки векторов, которые строит вызывающий, с сохранением
+ *
+ * Для строк, которые хранятся не во float (fp16, int8, int32) и поэтому не
+ * проходят через reduce: vector_at(j, count) возвращает Vec<float, W>
+ * столбцов j..j+count-1 (count < W только у хвоста, его лишние дорожки
+ * могут быть любыми). Векторы сохраняются в out (n float) и складываются
+ * блоками PairwiseSum, как в RowReduceSimd.
+ */
+template <std::size_t W, typename VectorAt>
+inline float RowSumStoredSimd(std::size_t n, float* out,
+                              const VectorAt& vector_at) {
+  using V = Vec<float, W>;
+  const std::size_t body = n / W * W;
+  PairwiseSum<V> pairwise;
+  std::size_t i = 0;
+  while (i < body) {
+    const std::size_t block_end = std::min(body, i + W * kPairwiseBlock);
+    V acc = V::zero();
+    for (; i < block_end; i += W) {
+      const V v = vector_at(i, W);
+      v.store(out + i);
+      acc = acc + v;
+    }
+    pairwise.push(&acc);
+  }
+  if (i < n) {
+    const std::size_t tail = n - body;
+    const V v = vkeep_first(vector_at(i, tail), tail);
+    v.store_tail(out + i, tail);
+    pairwise.push(&v);
+  }
+  V total;
+  pairwise.total(&total);
+  return vreduce_add(total);
+}
+
+/**
+ * @brief Векторная версия каркаса: проход суммы RowReduceSimd, затем map
+ *
+ * Возвращает параметры строки, как и скалярная версия. W - ширина вектора,
+ * по умолчанию самая широкая из доступных.
+ *
+ * @tparam kStream Писать результат map потоковыми записями в обход кэша;
+ * невыровненное начало строки пишется скалярным map. После потоковых
+ * записей вызывающий делает _mm_sfence.
+ */
+template <std::size_t W = kVecLanes, bool kStream = false, typename Op>
+inline typename Op::Params RowReduceMapSimd(const Op& op, const float* row,
+                                            float* out, std::size_t n) {
+  using V = Vec<float, W>;
+  if (n == 0) return {};
+  const Op row_op = op.at_row(row, n);
+  float sums[Op::kTerms];
+  RowReduceSimd<W>(row_op, row, out, n, sums);
+  const auto params = row_op.combine(sums, n);
+
+  const float* source = Op::kMapStored ? out : row;
+  std::size_t i = 0;
+  if (kStream) {
+    for (; i < n && reinterpret_cast<std::uintptr_t>(out + i) % sizeof(V) != 0;
+         ++i) {
+      out[i] = row_op.map(source[i], i, params);
+    }
+  }
+  for (; i + W <= n; i += W) {
+    const V y = row_op.map(V::load(source + i), RowLanes<W>{i, W}, params);
+    if (kStream) {
+      y.stream(out + i);
+    } else {
+      y.store(out + i);
+    }
+  }
+  if (i < n) {
+    const std::size_t tail = n - i;
+    row_op.map(V::load_tail(source + i, tail), RowLanes<W>{i, tail}, params)
+        .store_tail(out + i, tail);
+  }
+  return params;
+}
+
+#endif  // !ROW_REDUCE_H
@@ -0,0 +1,187 @@
+/**
+ * @file simd_utils.h
+ * @brief Базовые AVX2 примитивы, общие для всех Softmax ядер
+ *
+ * Векторная экспонента, горизонтальная сумма, обёртки загрузки/сохранения,
+ * преобразования fp16/bf16 <-> fp32 и управление режимом денормализованных
+ * чисел (FTZ/DAZ) в регистре MXCSR.
+ */
+
+#ifndef SIMD_UTILS_H
+#define SIMD_UTILS_H
+
+#include <immintrin.h>  // AVX инструкции (Intel Intrinsics)
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd_vec.h"
+
+// Векторная экспонента AVX2: vexp из simd_vec.h на ширине 8
+static inline __m256 exp256_ps(__m256 x) { return vexp(Vec<float, 8>{x}).v; }
+
+// Векторный натуральный логарифм, тот же источник, что у vexp
+// ("sse_mathfun.h", log_ps). Для x <= 0 результат - NaN, денормалы
+// заменяются минимальным нормализованным числом.
+static inline __m256 log256_ps(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 invalid_mask =
+      _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OS);
+
+  x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+  __m256i imm0 = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+
+  // Мантисса в [0.5, 1)
+  x = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(~0x7f800000)));
+  x = _mm256_or_ps(x, _mm256_set1_ps(0.5f));
+
+  imm0 = _mm256_sub_epi32(imm0, _mm256_set1_epi32(0x7f));
+  __m256 e = _mm256_add_ps(_mm256_cvtepi32_ps(imm0), one);
+
+  const __m256 mask =
+      _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OS);
+  __m256 tmp = _mm256_and_ps(x, mask);
+  x = _mm256_sub_ps(x, one);
+  e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+  x = _mm256_add_ps(x, tmp);
+
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 y = _mm256_set1_ps(7.0376836292E-2f);
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.1514610310E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.1676998740E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.2420140846E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(1.4249322787E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-1.6668057665E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(2.0000714765E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(-2.4999993993E-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(3.3333331174E-1f));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+  y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(-2.12194440e-4f)));
+  y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+  x = _mm256_add_ps(x, y);
+  x = _mm256_add_ps(x, _mm256_mul_ps(e, _mm256_set1_ps(0.693359375f)));
+  return _mm256_or_ps(x, invalid_mask);
+}
+
+// Сумма 8 float в векторе AVX
+static inline float hsum256_ps(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  __m128 sum128 = _mm_add_ps(lo, hi);
+  sum128 = _mm_hadd_ps(sum128, sum128);
+  sum128 = _mm_hadd_ps(sum128, sum128);
+  return _mm_cvtss_f32(sum128);
+}
+
+// Максимум 8 float в векторе AVX
+static inline float hmax256_ps(__m256 v) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+// Маска первых len дорожек (len <= 8) для маскированных загрузок хвоста
+static inline __m256i first_lanes_mask(std::size_t len) {
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(len)),
+                            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+// Вспомогательные функции для работы с AVX
+static inline void storeu256_ps(float* dst, __m256 v) {
+  _mm256_storeu_ps(dst, v);
+}
+static inline __m256 loadu256_ps(const float* src) {
+  return _mm256_loadu_ps(src);
+}
+
+// fp16 <-> fp32 (F16C: vcvtph2ps / vcvtps2ph), округление к ближайшему
+static inline __m256 loadu_f16_ps(const std::uint16_t* src) {
+  return _mm256_cvtph_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+static inline void storeu_f16_ps(std::uint16_t* dst, __m256 v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                   _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+static inline float f16_to_f32(std::uint16_t bits) { return _cvtsh_ss(bits); }
+static inline std::uint16_t f32_to_f16(float x) {
+  return _cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+}
+
+// bf16 -> fp32: старшие 16 бит float
+static inline __m256 loadu_bf16_ps(const std::uint16_t* src) {
+  const __m256i wide = _mm256_cvtepu16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(wide, 16));
+}
+
+// fp32 -> bf16 с округлением к ближайшему чётному; NaN остаётся (тихим) NaN
+static inline void storeu_bf16_ps(std::uint16_t* dst, __m256 v) {
+  const __m256i bits = _mm256_castps_si256(v);
+  const __m256i lsb =
+      _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+  __m256i rounded = _mm256_srli_epi32(
+      _mm256_add_epi32(bits, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7FFF))),
+      16);
+  const __m256i quiet_nan = _mm256_or_si256(_mm256_srli_epi32(bits, 16),
+                                            _mm256_set1_epi32(0x40));
+  const __m256 is_nan = _mm256_cmp_ps(v, v, _CMP_UNORD_Q);
+  rounded = _mm256_castps_si256(_mm256_blendv_ps(
+      _mm256_castsi256_ps(rounded), _mm256_castsi256_ps(quiet_nan), is_nan));
+  // 8 x u32 -> 8 x u16: packus работает внутри 128-битных половин
+  const __m256i packed = _mm256_permute4x64_epi64(
+      _mm256_packus_epi32(rounded, rounded), 0x08);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                   _mm256_castsi256_si128(packed));
+}
+static inline float bf16_to_f32(std::uint16_t bits) {
+  const std::uint32_t wide = static_cast<std::uint32_t>(bits) << 16;
+  float x;
+  std::memcpy(&x, &wide, sizeof(x));
+  return x;
+}
+static inline std::uint16_t f32_to_bf16(float x) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  if (x != x) return static_cast<std::uint16_t>((bits >> 16) | 0x40);
+  bits += 0x7FFF + ((bits >> 16) & 1);
+  return static_cast<std::uint16_t>(bits >> 16);
+}
+
+// Режим обработки денормализованных чисел в ядрах
+enum class DenormalMode {
+  kPreserve,     // IEEE-семантика, денормалы вычисляются микрокодом
+  kFlushToZero,  // FTZ + DAZ: денормалы на входе и выходе заменяются нулём
+};
+
+/**
+ * @brief RAII-переключатель FTZ/DAZ для текущего потока
+ *
+ * MXCSR - регистр потока, поэтому в OpenMP регионе объект создаётся в каждом
+ * потоке отдельно. Исходное значение MXCSR восстанавливается в деструкторе,
+ * так что режим не "утекает" в код вне ядра (в том числе в потоки пула OpenMP,
+ * которые переиспользуются следующими регионами).
+ */
+class ScopedDenormalMode {
+ public:
+  explicit ScopedDenormalMode(DenormalMode mode) : saved_csr_(_mm_getcsr()) {
+    if (mode == DenormalMode::kFlushToZero) {
+      _mm_setcsr(saved_csr_ | kFtzBit | kDazBit);
+    }
+  }
+  ~ScopedDenormalMode() { _mm_setcsr(saved_csr_); }
+
+  ScopedDenormalMode(const ScopedDenormalMode&) = delete;
+  ScopedDenormalMode& operator=(const ScopedDenormalMode&) = delete;
+
+ private:
+  static constexpr unsigned int kFtzBit = 0x8000;  // MXCSR bit 15
+  static constexpr unsigned int kDazBit = 0x0040;  // MXCSR bit 6
+
+  unsigned int saved_csr_;
+};
+
+#endif  // !SIMD_UTILS_H
@@ -0,0 +1,369 @@
+/**
+ * @file simd_vec.h
+ * @brief Переносимый вектор Vec<float, W> поверх SSE, AVX2 и AVX-512
+ *
+ * Ядро пишется один раз над Vec<float, W> и собирается под любой уровень
+ * x86: W = 4 - SSE4.1 (__m128), 8 - AVX2 (__m256), 16 - AVX-512F (__m512).
+ * Специализация ширины содержит только родной регистр и примитивы:
+ * загрузку/сохранение (и потоковую запись), хвост под маской, номера
+ * дорожек, арифметику, floor, 2^n, флаги сравнений и горизонтальные
+ * редукции. Всё остальное, включая
+ * экспоненту, - общие шаблоны над ними. Обёртка - тривиальная структура с
+ * одним полем, после встраивания компилятор выдаёт тот же код, что и прямые
+ * вызовы intrinsics.
+ *
+ * Ширины, не включённые флагами компиляции, не объявляются; kVecLanes -
+ * самая широкая из доступных, NativeVec - вектор этой ширины.
+ */
+
+#ifndef SIMD_VEC_H
+#define SIMD_VEC_H
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+template <typename T, std::size_t W>
+struct Vec;
+
+#ifdef __SSE4_1__
+template <>
+struct Vec<float, 4> {
+  static constexpr std::size_t kLanes = 4;
+  __m128 v;
+
+  static Vec zero() { return {_mm_setzero_ps()}; }
+  static Vec broadcast(float x) { return {_mm_set1_ps(x)}; }
+  static Vec iota() { return {_mm_setr_ps(0, 1, 2, 3)}; }
+  static Vec load(const float* src) { return {_mm_loadu_ps(src)}; }
+  void store(float* dst) const { _mm_storeu_ps(dst, v); }
+  // Потоковая запись в обход кэша; dst выровнен на размер вектора
+  void stream(float* dst) const { _mm_stream_ps(dst, v); }
+
+  // SSE не умеет маскированных загрузок: хвост через буфер на стеке
+  static Vec load_tail(const float* src, std::size_t n) {
+    alignas(16) float buffer[kLanes] = {};
+    std::memcpy(buffer, src, n * sizeof(float));
+    return {_mm_load_ps(buffer)};
+  }
+  void store_tail(float* dst, std::size_t n) const {
+    alignas(16) float buffer[kLanes];
+    _mm_store_ps(buffer, v);
+    std::memcpy(dst, buffer, n * sizeof(float));
+  }
+};
+
+inline Vec<float, 4> operator+(Vec<float, 4> a, Vec<float, 4> b) {
+  return {_mm_add_ps(a.v, b.v)};
+}
+inline Vec<float, 4> operator-(Vec<float, 4> a, Vec<float, 4> b) {
+  return {_mm_sub_ps(a.v, b.v)};
+}
+inline Vec<float, 4> operator*(Vec<float, 4> a, Vec<float, 4> b) {
+  return {_mm_mul_ps(a.v, b.v)};
+}
+inline Vec<float, 4> vmin(Vec<float, 4> a, Vec<float, 4> b) {
+  return {_mm_min_ps(a.v, b.v)};
+}
+inline Vec<float, 4> vmax(Vec<float, 4> a, Vec<float, 4> b) {
+  return {_mm_max_ps(a.v, b.v)};
+}
+inline Vec<float, 4> vfloor(Vec<float, 4> a) { return {_mm_floor_ps(a.v)}; }
+
+// 2^n для целых n из [-127, 128], записанных во float
+inline Vec<float, 4> vexp2i(Vec<float, 4> n) {
+  const __m128i biased =
+      _mm_add_epi32(_mm_cvttps_epi32(n.v), _mm_set1_epi32(0x7f));
+  return {_mm_castsi128_ps(_mm_slli_epi32(biased, 23))};
+}
+
+// Первые n дорожек без изменений, остальные - ноль
+inline Vec<float, 4> vkeep_first(Vec<float, 4> a, std::size_t n) {
+  const __m128i mask = _mm_cmpgt_epi32(_mm_set1_epi32(static_cast<int>(n)),
+                                       _mm_setr_epi32(0, 1, 2, 3));
+  return {_mm_and_ps(a.v, _mm_castsi128_ps(mask))};
+}
+
+// Флаги дорожек: 1.0f, где условие выполнено, иначе 0.0f (для подсчёта
+// суммой); a > b ложно при NaN
+inline Vec<float, 4> vflag_gt(Vec<float, 4> a, Vec<float, 4> b) {
+  return {_mm_and_ps(_mm_cmpgt_ps(a.v, b.v), _mm_set1_ps(1.0f))};
+}
+inline Vec<float, 4> vflag_nan(Vec<float, 4> a) {
+  return {_mm_and_ps(_mm_cmpunord_ps(a.v, a.v), _mm_set1_ps(1.0f))};
+}
+
+// Порядок сложений как в hsum256_ps: (s0 + s1) + (s2 + s3)
+inline float vreduce_add(Vec<float, 4> a) {
+  __m128 s = _mm_hadd_ps(a.v, a.v);
+  s = _mm_hadd_ps(s, s);
+  return _mm_cvtss_f32(s);
+}
+inline float vreduce_max(Vec<float, 4> a) {
+  __m128 m = _mm_max_ps(a.v, _mm_movehl_ps(a.v, a.v));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+#endif  // __SSE4_1__
+
+#ifdef __AVX2__
+template <>
+struct Vec<float, 8> {
+  static constexpr std::size_t kLanes = 8;
+  __m256 v;
+
+  static Vec zero() { return {_mm256_setzero_ps()}; }
+  static Vec broadcast(float x) { return {_mm256_set1_ps(x)}; }
+  static Vec iota() { return {_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)}; }
+  static Vec load(const float* src) { return {_mm256_loadu_ps(src)}; }
+  void store(float* dst) const { _mm256_storeu_ps(dst, v); }
+  void stream(float* dst) const { _mm256_stream_ps(dst, v); }
+
+  static __m256i tail_mask(std::size_t n) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(n)),
+                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  }
+  static Vec load_tail(const float* src, std::size_t n) {
+    return {_mm256_maskload_ps(src, tail_mask(n))};
+  }
+  void store_tail(float* dst, std::size_t n) const {
+    _mm256_maskstore_ps(dst, tail_mask(n), v);
+  }
+};
+
+inline Vec<float, 8> operator+(Vec<float, 8> a, Vec<float, 8> b) {
+  return {_mm256_add_ps(a.v, b.v)};
+}
+inline Vec<float, 8> operator-(Vec<float, 8> a, Vec<float, 8> b) {
+  return {_mm256_sub_ps(a.v, b.v)};
+}
+inline Vec<float, 8> operator*(Vec<float, 8> a, Vec<float, 8> b) {
+  return {_mm256_mul_ps(a.v, b.v)};
+}
+inline Vec<float, 8> vmin(Vec<float, 8> a, Vec<float, 8> b) {
+  return {_mm256_min_ps(a.v, b.v)};
+}
+inline Vec<float, 8> vmax(Vec<float, 8> a, Vec<float, 8> b) {
+  return {_mm256_max_ps(a.v, b.v)};
+}
+inline Vec<float, 8> vfloor(Vec<float, 8> a) {
+  return {_mm256_floor_ps(a.v)};
+}
+
+inline Vec<float, 8> vexp2i(Vec<float, 8> n) {
+  const __m256i biased =
+      _mm256_add_epi32(_mm256_cvttps_epi32(n.v), _mm256_set1_epi32(0x7f));
+  return {_mm256_castsi256_ps(_mm256_slli_epi32(biased, 23))};
+}
+
+inline Vec<float, 8> vkeep_first(Vec<float, 8> a, std::size_t n) {
+  const __m256i mask = Vec<float, 8>::tail_mask(n);
+  return {_mm256_and_ps(a.v, _mm256_castsi256_ps(mask))};
+}
+
+inline Vec<float, 8> vflag_gt(Vec<float, 8> a, Vec<float, 8> b) {
+  return {_mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ),
+                        _mm256_set1_ps(1.0f))};
+}
+inline Vec<float, 8> vflag_nan(Vec<float, 8> a) {
+  return {_mm256_and_ps(_mm256_cmp_ps(a.v, a.v, _CMP_UNORD_Q),
+                        _mm256_set1_ps(1.0f))};
+}
+
+inline float vreduce_add(Vec<float, 8> a) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(a.v),
+                        _mm256_extractf128_ps(a.v, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  return _mm_cvtss_f32(s);
+}
+inline float vreduce_max(Vec<float, 8> a) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(a.v),
+                        _mm256_extractf128_ps(a.v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+#endif  // __AVX2__
+
+#ifdef __AVX512F__
+template <>
+struct Vec<float, 16> {
+  static constexpr std::size_t kLanes = 16;
+  __m512 v;
+
+  static Vec zero() { return {_mm512_setzero_ps()}; }
+  static Vec broadcast(float x) { return {_mm512_set1_ps(x)}; }
+  static Vec iota() {
+    return {_mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                           15)};
+  }
+  static Vec load(const float* src) { return {_mm512_loadu_ps(src)}; }
+  void store(float* dst) const { _mm512_storeu_ps(dst, v); }
+  void stream(float* dst) const { _mm512_stream_ps(dst, v); }
+
+  static __mmask16 tail_mask(std::size_t n) {
+    return static_cast<__mmask16>((1u << n) - 1u);
+  }
+  static Vec load_tail(const float* src, std::size_t n) {
+    return {_mm512_maskz_loadu_ps(tail_mask(n), src)};
+  }
+  void store_tail(float* dst, std::size_t n) const {
+    _mm512_mask_storeu_ps(dst, tail_mask(n), v);
+  }
+};
+
+inline Vec<float, 16> operator+(Vec<float, 16> a, Vec<float, 16> b) {
+  return {_mm512_add_ps(a.v, b.v)};
+}
+inline Vec<float, 16> operator-(Vec<float, 16> a, Vec<float, 16> b) {
+  return {_mm512_sub_ps(a.v, b.v)};
+}
+inline Vec<float, 16> operator*(Vec<float, 16> a, Vec<float, 16> b) {
+  return {_mm512_mul_ps(a.v, b.v)};
+}
+inline Vec<float, 16> vmin(Vec<float, 16> a, Vec<float, 16> b) {
+  return {_mm512_min_ps(a.v, b.v)};
+}
+inline Vec<float, 16> vmax(Vec<float, 16> a, Vec<float, 16> b) {
+  return {_mm512_max_ps(a.v, b.v)};
+}
+inline Vec<float, 16> vfloor(Vec<float, 16> a) {
+  return {_mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF)};
+}
+
+inline Vec<float, 16> vexp2i(Vec<float, 16> n) {
+  const __m512i biased =
+      _mm512_add_epi32(_mm512_cvttps_epi32(n.v), _mm512_set1_epi32(0x7f));
+  return {_mm512_castsi512_ps(_mm512_slli_epi32(biased, 23))};
+}
+
+inline Vec<float, 16> vkeep_first(Vec<float, 16> a, std::size_t n) {
+  return {_mm512_maskz_mov_ps(Vec<float, 16>::tail_mask(n), a.v)};
+}
+
+inline Vec<float, 16> vflag_gt(Vec<float, 16> a, Vec<float, 16> b) {
+  return {_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ),
+                              _mm512_set1_ps(1.0f))};
+}
+inline Vec<float, 16> vflag_nan(Vec<float, 16> a) {
+  return {_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a.v, a.v, _CMP_UNORD_Q),
+                              _mm512_set1_ps(1.0f))};
+}
+
+inline float vreduce_add(Vec<float, 16> a) {
+  return _mm512_reduce_add_ps(a.v);
+}
+inline float vreduce_max(Vec<float, 16> a) {
+  return _mm512_reduce_max_ps(a.v);
+}
+#endif  // __AVX512F__
+
+#if defined(__AVX512F__)
+constexpr std::size_t kVecLanes = 16;
+#elif defined(__AVX2__)
+constexpr std::size_t kVecLanes = 8;
+#else
+constexpr std::size_t kVecLanes = 4;
+#endif
+
+using NativeVec = Vec<float, kVecLanes>;
+
+// a * b + c; с FMA - одно округление, без него - два (как mul + add)
+template <std::size_t W>
+inline Vec<float, W> vfmadd(Vec<float, W> a, Vec<float, W> b,
+                            Vec<float, W> c) {
+#ifdef __FMA__
+  if constexpr (W == 4) return {_mm_fmadd_ps(a.v, b.v, c.v)};
+  if constexpr (W == 8) return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+#endif
+#ifdef __AVX512F__
+  if constexpr (W == 16) return {_mm512_fmadd_ps(a.v, b.v, c.v)};
+#endif
+  return a * b + c;
+}
+
+/**
+ * @brief Экспонента на любой ширине (аппроксимация полиномом Cephes)
+ *
+ * Алгоритм exp_ps из "sse_mathfun.h" (Julien Pommier),
+ * https://github.com/RJVB/sse_mathfun/blob/master/sse_mathfun.h.
+ * Единственная реализация экспоненты: exp256_ps в simd_utils.h - она же
+ * при W = 8. Аргумент обрезается до [-88.38, 88.38]. Поправка
+ * "floor(fx) > fx" из оригинала опущена: floor никогда не больше
+ * аргумента, и поправка всегда нулевая.
+ */
+template <std::size_t W>
+inline Vec<float, W> vexp(Vec<float, W> x) {
+  using V = Vec<float, W>;
+  x = vmin(x, V::broadcast(88.3762626647949f));
+  x = vmax(x, V::broadcast(-88.3762626647949f));
+
+  // n = round(x / ln 2), x -= n * ln 2 (ln 2 разбит на C1 + C2)
+  const V fx = vfloor(x * V::broadcast(1.44269504088896341) +
+                      V::broadcast(0.5f));
+  x = x - fx * V::broadcast(0.693359375);
+  x = x - fx * V::broadcast(-2.12194440e-4);
+  const V z = x * x;
+
+  V y = V::broadcast(1.9875691500E-4);
+  y = y * x + V::broadcast(1.3981999507E-3);
+  y = y * x + V::broadcast(8.3334519073E-3);
+  y = y * x + V::broadcast(4.1665795894E-2);
+  y = y * x + V::broadcast(1.6666665459E-1);
+  y = y * x + V::broadcast(5.0000001201E-1);
+  y = y * z + x + V::broadcast(1.0f);
+  return y * vexp2i(fx);
+}
+
+// Векторов в блоке попарного суммирования: внутри блока суммы копятся
+// последовательно по дорожкам, блоки складываются деревом
+constexpr std::size_t kPairwiseBlock = 16;
+
+/**
+ * @brief Попарное (каскадное) суммирование блоков по kTerms суммам
+ *
+ * Последовательная сумма n слагаемых во float накапливает ошибку O(n)·eps:
+ * на строке в 1M значений это ~1e-3 относительной погрешности. Здесь
+ * каждая дорожка копит сумму только внутри блока из kPairwiseBlock
+ * векторов, а суммы блоков сливаются как в двоичном счётчике: уровень l
+ * хранит сумму 2^l блоков, и перенос складывает равные по размеру части.
+ * Ошибка - O(kPairwiseBlock + log n)·eps без прохода в double; на блок
+ * приходится в среднем одно дополнительное сложение вектора.
+ */
+template <typename V, std::size_t kTerms = 1>
+class PairwiseSum {
+ public:
+  // Добавить суммы очередного блока
+  void push(const V* block) {
+    V carry[kTerms];
+    for (std::size_t k = 0; k < kTerms; ++k) carry[k] = block[k];
+    std::size_t l = 0;
+    for (; (blocks_ >> l) & 1u; ++l) {
+      for (std::size_t k = 0; k < kTerms; ++k) {
+        carry[k] = level_[l][k] + carry[k];
+      }
+    }
+    for (std::size_t k = 0; k < kTerms; ++k) level_[l][k] = carry[k];
+    ++blocks_;
+  }
+
+  // Сумма всех блоков; без блоков - нули
+  void total(V* sums) const {
+    for (std::size_t k = 0; k < kTerms; ++k) sums[k] = V::zero();
+    for (std::size_t l = 0; (blocks_ >> l) != 0; ++l) {
+      if (((blocks_ >> l) & 1u) == 0) continue;
+      for (std::size_t k = 0; k < kTerms; ++k) {
+        sums[k] = sums[k] + level_[l][k];
+      }
+    }
+  }
+
+ private:
+  V level_[64][kTerms];  // заполнены только уровни с единичным битом
+  std::uint64_t blocks_ = 0;
+};
+
+#endif  // !SIMD_VEC_H
@@ -0,0 +1,106 @@
+/**
+ * @file softmax_attention.h
+ * @brief Батч Softmax для матриц внимания [B, H, S, T] в одном OpenMP регионе
+ *
+ * Вызов run_openmp_simd для каждой пары (batch, head) открывает и закрывает
+ * параллельный регион B*H раз, а при малом S каждая матрица слишком мала,
+ * чтобы загрузить все ядра. Здесь весь тензор разбивается на задачи
+ * (b, h, блок строк), которые распределяются между потоками одним регионом.
+ */
+
+#ifndef SOFTMAX_ATTENTION_H
+#define SOFTMAX_ATTENTION_H
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Минимальный объём работы одной задачи: строки блока вместе занимают не
+// меньше ~32 КиБ, чтобы накладные расходы планирования были незаметны
+constexpr std::size_t kAttentionTaskBytes = 32 * 1024;
+
+/**
+ * @brief Число строк в задаче (b, h, блок строк) для матриц queries×keys
+ *
+ * Размер строки задаёт число ключей (последняя ось): блок не меньше
+ * kAttentionTaskBytes, но задач должно хватать на все потоки - при
+ * B*H < threads блоки дробятся вплоть до одной строки.
+ */
+inline std::size_t attention_rows_per_task(std::size_t matrices,
+                                           std::size_t queries,
+                                           std::size_t keys,
+                                           std::size_t threads) {
+  const std::size_t row_bytes = std::max<std::size_t>(keys, 1) * 4;
+  std::size_t rows = std::max<std::size_t>(1, kAttentionTaskBytes / row_bytes);
+  rows = std::min(rows, queries);
+  while (rows > 1 && matrices * ((queries + rows - 1) / rows) < 4 * threads) {
+    rows /= 2;
+  }
+  return rows;
+}
+
+/**
+ * @brief Softmax по последней оси тензора оценок внимания [B, H, S, T]
+ *
+ * Задачи нумеруются в порядке (b, h, блок строк), и статическое расписание
+ * раздаёт каждому потоку непрерывный диапазон: соседние блоки одной матрицы
+ * попадают в один поток. Оси B и H могут иметь произвольные шаги (срезы
+ * больших буферов), строки внутри матрицы - непрерывны.
+ */
+inline void softmax_attention(TensorView<const float> scores,
+                              TensorView<float> probs, SoftmaxMethod method,
+                              DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = scores.shape;
+  const TensorShape& out_shape = probs.shape;
+  if (in_shape.rank() != 4) {
+    throw std::invalid_argument("Attention scores must be [B, H, S, T]");
+  }
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!in_shape.last_axis_contiguous() || !out_shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Attention rows must be contiguous");
+  }
+  if (in_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t matrices = in_shape.dims[0] * in_shape.dims[1];
+  const std::size_t rows = in_shape.dims[2];
+  const std::size_t cols = in_shape.dims[3];
+  const SoftmaxRowKernel row_kernel = softmax_row_kernel(cols, simd);
+  const std::size_t in_rs = in_shape.strides[2];
+  const std::size_t out_rs = out_shape.strides[2];
+  const std::size_t threads =
+      parallel ? static_cast<std::size_t>(omp_get_max_threads()) : 1;
+  const std::size_t block =
+      attention_rows_per_task(matrices, rows, cols, threads);
+  const std::size_t blocks_per_matrix = (rows + block - 1) / block;
+  const std::size_t tasks = matrices * blocks_per_matrix;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for schedule(static)
+    for (std::size_t t = 0; t < tasks; ++t) {
+      const std::size_t bh = t / blocks_per_matrix;
+      const std::size_t row_begin = (t % blocks_per_matrix) * block;
+      const std::size_t row_end = std::min(row_begin + block, rows);
+      const float* in = scores.data + in_shape.offset_of(bh, 2);
+      float* out = probs.data + out_shape.offset_of(bh, 2);
+      for (std::size_t r = row_begin; r < row_end; ++r) {
+        row_kernel(in + r * in_rs, out + r * out_rs, cols);
+      }
+    }
+  }
+}
+
+#endif  // !SOFTMAX_ATTENTION_H
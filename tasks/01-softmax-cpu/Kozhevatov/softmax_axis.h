@@ -0,0 +1,241 @@
+/**
+ * @file softmax_axis.h
+ * @brief Softmax вдоль произвольной (не последней) оси без транспонирования
+ *
+ * Тензор сворачивается в форму [outer, len, inner], где len - длина оси
+ * Softmax, а inner - произведение осей после неё. Элементы одной "строки"
+ * Softmax лежат с шагом inner, поэтому вместо горизонтальной редукции
+ * используется вертикальная: полоса из 8*k соседних столбцов проходит по оси
+ * целиком, и каждый AVX-регистр накапливает суммы 8 независимых столбцов.
+ */
+
+#ifndef SOFTMAX_AXIS_H
+#define SOFTMAX_AXIS_H
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Бюджет кэша на одну полосу столбцов: экспоненты первого прохода должны
+// дожить до второго прохода (нормализации) в L2
+constexpr std::size_t kAxisStripCacheBytes = 256 * 1024;
+
+// Скалярный Softmax одного столбца длины len (шаги входа и выхода заданы
+// отдельно)
+inline void SoftmaxColumn(const float* in, std::size_t in_stride, float* out,
+                          std::size_t out_stride, std::size_t len) {
+  float sum_exp = 0.0f;
+  for (std::size_t a = 0; a < len; ++a) {
+    const float e = std::exp(in[a * in_stride]);
+    out[a * out_stride] = e;
+    sum_exp += e;
+  }
+
+  // Защита от деления на ноль
+  if (sum_exp == 0.0f) {
+    for (std::size_t a = 0; a < len; ++a) out[a * out_stride] = 1.0f / len;
+    return;
+  }
+
+  const float inv_sum = 1.0f / sum_exp;
+  for (std::size_t a = 0; a < len; ++a) out[a * out_stride] *= inv_sum;
+}
+
+/**
+ * @brief Softmax полосы из 8*kVectors соседних столбцов (вертикальная SIMD)
+ *
+ * Первый проход считает экспоненты и суммы по столбцам в kVectors
+ * регистрах-аккумуляторах, второй - умножает на обратные суммы. Суммы
+ * копятся блоками по kPairwiseBlock строк, блоки складываются попарно
+ * (PairwiseSum), поэтому длинная ось не теряет точность. Для столбцов с
+ * нулевой суммой результат равен 1/len, как в SoftmaxRowSimd.
+ */
+template <std::size_t kVectors>
+inline void SoftmaxColumnStripSimd(const float* in, std::size_t in_stride,
+                                   float* out, std::size_t out_stride,
+                                   std::size_t len) {
+  using V = Vec<float, 8>;
+  PairwiseSum<V, kVectors> pairwise;
+  for (std::size_t a = 0; a < len;) {
+    const std::size_t block_end = std::min(len, a + kPairwiseBlock);
+    V acc[kVectors];
+    for (std::size_t v = 0; v < kVectors; ++v) acc[v] = V::zero();
+    for (; a < block_end; ++a) {
+      const float* src = in + a * in_stride;
+      float* dst = out + a * out_stride;
+      for (std::size_t v = 0; v < kVectors; ++v) {
+        const V e = vexp(V::load(src + 8 * v));
+        e.store(dst + 8 * v);
+        acc[v] = acc[v] + e;
+      }
+    }
+    pairwise.push(acc);
+  }
+  V sum[kVectors];
+  pairwise.total(sum);
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 uniform = _mm256_set1_ps(1.0f / len);
+  __m256 inv[kVectors];
+  __m256 degenerate[kVectors];
+  for (std::size_t v = 0; v < kVectors; ++v) {
+    inv[v] = _mm256_div_ps(_mm256_set1_ps(1.0f), sum[v].v);
+    degenerate[v] = _mm256_cmp_ps(sum[v].v, zero, _CMP_EQ_OQ);
+  }
+
+  for (std::size_t a = 0; a < len; ++a) {
+    float* dst = out + a * out_stride;
+    for (std::size_t v = 0; v < kVectors; ++v) {
+      __m256 r = _mm256_mul_ps(loadu256_ps(dst + 8 * v), inv[v]);
+      storeu256_ps(dst + 8 * v, _mm256_blendv_ps(r, uniform, degenerate[v]));
+    }
+  }
+}
+
+// Ширина полосы (в AVX-векторах), при которой len строк полосы помещаются
+// в kAxisStripCacheBytes
+inline std::size_t axis_strip_vectors(std::size_t len) {
+  for (std::size_t vectors : {4u, 2u}) {
+    if (len * vectors * 8 * sizeof(float) <= kAxisStripCacheBytes) {
+      return vectors;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Softmax тензора вдоль оси axis
+ *
+ * Тензор рассматривается как [outer, len, inner]: оси после axis должны
+ * лежать плотно (внутри них работают SIMD-полосы), а смещение каждого из
+ * outer блоков вычисляется по шагам, так что срезы и подблоки большего
+ * буфера обрабатываются без копирования. Транспонирование не материализуется.
+ *
+ * Параллелизм - по независимым парам (outer, полоса столбцов), поэтому
+ * потоки загружены даже при outer = 1 (Softmax по оси 0 матрицы).
+ */
+inline void softmax_axis(TensorView<const float> input,
+                         TensorView<float> output, std::size_t axis,
+                         SoftmaxMethod method,
+                         DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = output.shape;
+  if (axis >= in_shape.rank()) {
+    throw std::invalid_argument("Softmax axis is out of range");
+  }
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (in_shape.numel() == 0) return;
+
+  std::size_t outer = 1, inner = 1;
+  for (std::size_t i = 0; i < axis; ++i) outer *= in_shape.dims[i];
+  for (std::size_t i = axis + 1; i < in_shape.rank(); ++i) {
+    inner *= in_shape.dims[i];
+  }
+  const std::size_t len = in_shape.dims[axis];
+
+  // Хвостовые оси единичной длины: это Softmax по последней оси
+  if (inner == 1) {
+    const auto trim = [axis](const TensorShape& shape) {
+      return TensorShape(
+          {shape.dims.begin(), shape.dims.begin() + axis + 1},
+          {shape.strides.begin(), shape.strides.begin() + axis + 1});
+    };
+    softmax_last_axis(TensorView<const float>(input.data, trim(in_shape)),
+                      TensorView<float>(output.data, trim(out_shape)), method,
+                      mode);
+    return;
+  }
+  if (!in_shape.contiguous_from(axis + 1) ||
+      !out_shape.contiguous_from(axis + 1)) {
+    throw std::invalid_argument(
+        "Axes after the softmax axis must be contiguous");
+  }
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t in_step = in_shape.strides[axis];
+  const std::size_t out_step = out_shape.strides[axis];
+
+  // Полосы по 8*vectors столбцов; хвост (< ширины полосы) добивается
+  // полосами по 8, а последние inner % 8 столбцов - скалярно
+  const std::size_t vectors = simd ? axis_strip_vectors(len) : 1;
+  const std::size_t strip = simd ? 8 * vectors : 1;
+  const std::size_t wide_strips = inner / strip;
+  const std::size_t narrow_begin = wide_strips * strip;
+  const std::size_t narrow_strips = simd ? (inner - narrow_begin) / 8 : 0;
+  const std::size_t scalar_begin = narrow_begin + narrow_strips * 8;
+  const std::size_t tasks_per_outer =
+      wide_strips + narrow_strips + (inner - scalar_begin);
+  const std::size_t tasks = outer * tasks_per_outer;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for schedule(static)
+    for (std::size_t t = 0; t < tasks; ++t) {
+      const std::size_t o = t / tasks_per_outer;
+      const std::size_t k = t % tasks_per_outer;
+      const float* in = input.data + in_shape.offset_of(o, axis);
+      float* out = output.data + out_shape.offset_of(o, axis);
+
+      std::size_t col = 0;
+      std::size_t width = 0;  // 0 - скалярный столбец
+      if (!simd) {
+        col = k;
+      } else if (k < wide_strips) {
+        col = k * strip;
+        width = vectors;
+      } else if (k < wide_strips + narrow_strips) {
+        col = narrow_begin + (k - wide_strips) * 8;
+        width = 1;
+      } else {
+        col = scalar_begin + (k - wide_strips - narrow_strips);
+      }
+
+      switch (width) {
+        case 4:
+          SoftmaxColumnStripSimd<4>(in + col, in_step, out + col, out_step,
+                                    len);
+          break;
+        case 2:
+          SoftmaxColumnStripSimd<2>(in + col, in_step, out + col, out_step,
+                                    len);
+          break;
+        case 1:
+          SoftmaxColumnStripSimd<1>(in + col, in_step, out + col, out_step,
+                                    len);
+          break;
+        default:
+          SoftmaxColumn(in + col, in_step, out + col, out_step, len);
+          break;
+      }
+    }
+  }
+}
+
+// Вариант для тензора в std::vector: результат - плотный тензор той же формы
+inline std::vector<float> softmax_axis(
+    const std::vector<float>& input, const TensorShape& shape,
+    std::size_t axis, SoftmaxMethod method,
+    DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape dense(shape.dims);
+  std::vector<float> result(dense.numel());
+  softmax_axis(make_view(input, shape), make_view(result, dense), axis, method,
+               mode);
+  return result;
+}
+
+#endif  // !SOFTMAX_AXIS_H
@@ -0,0 +1,142 @@
+/**
+ * @file softmax_backward.h
+ * @brief Обратный проход Softmax: dx = y ⊙ (dy - Σ(dy ⊙ y))
+ *
+ * Произведение якобиана Softmax на вектор dy - операция каркаса
+ * row_reduce.h над строкой y: скалярное произведение Σ(dy ⊙ y) - сумма
+ * прохода reduce (попарная, хвост под маской), map сразу записывает dx.
+ * Запуск по строкам - тот же, что у softmax_rows; большие результаты
+ * записываются потоковыми записями в обход кэша, так как dx до следующего
+ * слоя из кэша всё равно вытесняется.
+ */
+
+#ifndef SOFTMAX_BACKWARD_H
+#define SOFTMAX_BACKWARD_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <cstddef>
+#include <stdexcept>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Объём dx, начиная с которого результат пишется потоковыми записями
+// (заведомо больше кэша последнего уровня одного ядра)
+constexpr std::size_t kBackwardStreamBytes = 8 * 1024 * 1024;
+
+/**
+ * @brief Обратный проход строки как операция каркаса row_reduce.h
+ *
+ * Строка каркаса - y; dy той же строки читается по столбцам. Слагаемое -
+ * dy ⊙ y, map пишет y ⊙ (dy - dot). map читает dy до записи тех же
+ * столбцов, поэтому dx может совпадать с dy (обновление на месте).
+ */
+struct SoftmaxBackwardOp {
+  static constexpr std::size_t kTerms = 1;
+  static constexpr bool kMapStored = false;
+
+  struct Params {
+    float dot;  // Σ(dy ⊙ y)
+  };
+
+  const float* dy;
+
+  SoftmaxBackwardOp at_row(const float*, std::size_t) const { return *this; }
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> y, const RowLanes<W>& lanes,
+              Vec<float, W>* terms) const {
+    terms[0] = lanes.load(dy) * y;
+  }
+  void reduce(float y, std::size_t j, float* terms) const {
+    terms[0] = dy[j] * y;
+  }
+
+  Params combine(const float* sums, std::size_t) const { return {sums[0]}; }
+
+  template <std::size_t W>
+  Vec<float, W> map(Vec<float, W> y, const RowLanes<W>& lanes,
+                    const Params& p) const {
+    return y * (lanes.load(dy) - Vec<float, W>::broadcast(p.dot));
+  }
+  float map(float y, std::size_t j, const Params& p) const {
+    return y * (dy[j] - p.dot);
+  }
+};
+
+// Обратный проход для одной строки (скалярная версия)
+inline void SoftmaxBackwardRow(const float* y, const float* dy, float* dx,
+                               std::size_t n) {
+  RowReduceMap(SoftmaxBackwardOp{dy}, y, dx, n);
+}
+
+/**
+ * @brief Обратный проход для одной строки (векторизованная версия)
+ *
+ * @tparam kStream Записывать dx потоковыми записями: невыровненное начало
+ * строки пишется обычными записями.
+ */
+template <bool kStream>
+inline void SoftmaxBackwardRowSimd(const float* y, const float* dy, float* dx,
+                                   std::size_t n) {
+  RowReduceMapSimd<kVecLanes, kStream>(SoftmaxBackwardOp{dy}, y, dx, n);
+}
+
+/**
+ * @brief Обратный проход Softmax для rows строк длины cols
+ *
+ * @param y Результат прямого прохода, шаг строк y_stride
+ * @param dy Градиент по выходу Softmax, шаг строк dy_stride
+ * @param dx Градиент по входу Softmax, шаг строк dx_stride
+ */
+inline void softmax_backward_rows(const float* y, std::size_t y_stride,
+                                  const float* dy, std::size_t dy_stride,
+                                  float* dx, std::size_t dx_stride,
+                                  std::size_t rows, std::size_t cols,
+                                  SoftmaxMethod method,
+                                  DenormalMode mode = DenormalMode::kPreserve) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const bool stream = rows * cols * sizeof(float) >= kBackwardStreamBytes;
+  const auto row_kernel =
+      !simd ? SoftmaxBackwardRow
+            : (stream ? SoftmaxBackwardRowSimd<true>
+                      : SoftmaxBackwardRowSimd<false>);
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t i = 0; i < rows; ++i) {
+      row_kernel(y + i * y_stride, dy + i * dy_stride, dx + i * dx_stride,
+                 cols);
+    }
+    // Потоковые записи слабо упорядочены: делаем их видимыми до выхода
+    if (stream) _mm_sfence();
+  }
+}
+
+// Обратный проход по последней оси тензоров y, dy, dx одной формы; ведущие
+// оси каждого тензора должны сворачиваться в строки
+inline void softmax_backward(TensorView<const float> y,
+                             TensorView<const float> dy, TensorView<float> dx,
+                             SoftmaxMethod method,
+                             DenormalMode mode = DenormalMode::kPreserve) {
+  if (y.shape.dims != dy.shape.dims || y.shape.dims != dx.shape.dims) {
+    throw std::invalid_argument("Backward operand shapes differ");
+  }
+  if (y.numel() == 0) return;
+  softmax_backward_rows(y.data, y.shape.row_stride(), dy.data,
+                        dy.shape.row_stride(), dx.data,
+                        dx.shape.row_stride(), y.shape.rows(),
+                        y.shape.last_dim(), method, mode);
+}
+
+#endif  // !SOFTMAX_BACKWARD_H
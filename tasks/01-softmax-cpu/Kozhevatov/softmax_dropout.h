@@ -0,0 +1,315 @@
+/**
+ * @file softmax_dropout.h
+ * @brief Softmax со слитым dropout: маска из Philox прямо в регистрах
+ *
+ * При обучении внимания dropout применяется сразу после Softmax: отдельный
+ * проход читает и переписывает вероятности и хранит маску. Здесь маска
+ * вычисляется при записи нормализованной строки: бит (строка, столбец) -
+ * чистая функция Philox от (seed, row, col), поэтому маску не нужно ни
+ * хранить, ни передавать в обратный проход - он получает те же биты заново.
+ * Прямой проход дополнительно сохраняет log Σ exp каждой строки (одно число
+ * на строку), и обратный проход восстанавливает y = exp(x - lse) по
+ * логитам, не храня и сами вероятности.
+ */
+
+#ifndef SOFTMAX_DROPOUT_H
+#define SOFTMAX_DROPOUT_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include "philox.h"
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Поток Philox для dropout (сэмплирование - kSamplingStream = 1)
+constexpr std::uint32_t kDropoutStream = 2;
+
+/**
+ * @brief Параметры dropout: доля обнуляемых элементов и seed
+ *
+ * Элемент (row, col) сохраняется, если philox_bits(seed, kDropoutStream,
+ * row, col) >= threshold, где threshold = rate * 2^32; сохранённые
+ * элементы умножаются на 1 / (1 - rate). row - линейный номер строки
+ * тензора.
+ */
+struct Dropout {
+  float rate;
+  std::uint64_t seed;
+  std::uint32_t threshold;
+  float scale;
+
+  Dropout(float rate_, std::uint64_t seed_) : rate(rate_), seed(seed_) {
+    if (!(rate >= 0.0f && rate < 1.0f)) {
+      throw std::invalid_argument("Dropout rate must be in [0, 1)");
+    }
+    threshold = static_cast<std::uint32_t>(
+        std::min(static_cast<double>(rate) * 4294967296.0, 4294967295.0));
+    scale = 1.0f / (1.0f - rate);
+  }
+
+  // Сохраняется ли элемент (скалярная проверка, эталон для ядер)
+  bool keep(std::uint64_t row, std::uint64_t col) const {
+    return philox_bits(seed, kDropoutStream, row, col) >= threshold;
+  }
+};
+
+// Маски сохранения 8 столбцов: bits >= threshold без знака
+static inline __m256 dropout_keep_mask(__m256i bits, __m256i threshold) {
+  return _mm256_castsi256_ps(
+      _mm256_cmpeq_epi32(_mm256_max_epu32(bits, threshold), bits));
+}
+
+/**
+ * @brief Применение маски к строке: out[j] = keep ? values[j] * scale : 0
+ *
+ * values и out могут совпадать. Столбцы идут блоками по kPhiloxBlockCols:
+ * один вызов генератора даёт биты 32 столбцов, в SIMD версии - сразу
+ * четырьмя векторами без перестановок.
+ */
+inline void DropoutApplyRow(const float* values, float* out, std::size_t n,
+                            float scale, const Dropout& dropout,
+                            std::uint64_t row, bool simd) {
+  std::size_t base = 0;
+  if (simd) {
+    const __m256i threshold =
+        _mm256_set1_epi32(static_cast<int>(dropout.threshold));
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    for (; base + kPhiloxBlockCols <= n; base += kPhiloxBlockCols) {
+      __m256i bits[4];
+      philox_block_avx2(dropout.seed, kDropoutStream, row,
+                        base / kPhiloxBlockCols, bits);
+      for (std::size_t k = 0; k < 4; ++k) {
+        const std::size_t j = base + k * 8;
+        storeu256_ps(out + j,
+                     _mm256_and_ps(
+                         _mm256_mul_ps(loadu256_ps(values + j), scale_vec),
+                         dropout_keep_mask(bits[k], threshold)));
+      }
+    }
+  }
+  std::uint32_t bits[kPhiloxBlockCols];
+  for (; base < n; base += kPhiloxBlockCols) {
+    philox_block(dropout.seed, kDropoutStream, row, base / kPhiloxBlockCols,
+                 bits);
+    const std::size_t end = std::min(n, base + kPhiloxBlockCols);
+    for (std::size_t j = base; j < end; ++j) {
+      out[j] = bits[j - base] >= dropout.threshold ? values[j] * scale : 0.0f;
+    }
+  }
+}
+
+/**
+ * @brief Softmax строки с dropout при записи нормализованного результата
+ *
+ * exp(x - max) пишется в out проходом суммы каркаса row_reduce.h
+ * (ShiftedExpOp: попарная сумма, хвост под маской), затем тот же буфер (из
+ * кэша) умножается на scale / sum и маску. Строка из одних -inf даёт
+ * равномерное распределение (как SoftmaxRow) и lse = -inf.
+ *
+ * @return log Σ exp(x) строки
+ */
+inline float SoftmaxDropoutRow(const float* row, float* out, std::size_t n,
+                               const Dropout& dropout, std::uint64_t row_id,
+                               bool simd) {
+  const float max = RowMax(row, n, simd);
+  if (max == -std::numeric_limits<float>::infinity()) {
+    std::fill(out, out + n, 1.0f);
+    DropoutApplyRow(out, out, n, dropout.scale / n, dropout, row_id, simd);
+    return max;
+  }
+
+  float sum;
+  if (simd) {
+    RowReduceSimd(ShiftedExpOp<true>{max}, row, out, n, &sum);
+  } else {
+    RowReduce(ShiftedExpOp<true>{max}, row, out, n, &sum);
+  }
+  DropoutApplyRow(out, out, n, dropout.scale / sum, dropout, row_id, simd);
+  return max + std::log(sum);
+}
+
+/**
+ * @brief Обратный проход Softmax + dropout для одной строки
+ *
+ * g = keep ⊙ scale ⊙ dout - градиент по y; dx = y ⊙ (g - Σ g ⊙ y). Первый
+ * проход восстанавливает y = exp(x - lse) в dx и накапливает Σ g ⊙ y, второй
+ * (из кэша) заново получает ту же маску и пишет dx.
+ */
+inline void SoftmaxDropoutBackwardRow(const float* row, float lse,
+                                      const float* dout, float* dx,
+                                      std::size_t n, const Dropout& dropout,
+                                      std::uint64_t row_id, bool simd) {
+  if (lse == -std::numeric_limits<float>::infinity()) {
+    std::fill(dx, dx + n, 1.0f / n);
+  } else {
+    std::size_t i = 0;
+    if (simd) {
+      const __m256 shift = _mm256_set1_ps(lse);
+      for (; i + 7 < n; i += 8) {
+        storeu256_ps(dx + i,
+                     exp256_ps(_mm256_sub_ps(loadu256_ps(row + i), shift)));
+      }
+    }
+    for (; i < n; ++i) dx[i] = std::exp(row[i] - lse);
+  }
+
+  // g = dropout(dout) по блокам: Σ g ⊙ y, затем dx = y ⊙ (g - dot)
+  std::uint32_t bits[kPhiloxBlockCols];
+  const auto scalar_block = [&](std::size_t base, auto&& body) {
+    philox_block(dropout.seed, kDropoutStream, row_id,
+                 base / kPhiloxBlockCols, bits);
+    const std::size_t end = std::min(n, base + kPhiloxBlockCols);
+    for (std::size_t j = base; j < end; ++j) {
+      body(j, bits[j - base] >= dropout.threshold ? dout[j] * dropout.scale
+                                                  : 0.0f);
+    }
+  };
+
+  float dot = 0.0f;
+  std::size_t base = 0;
+  const std::size_t full = simd ? n / kPhiloxBlockCols * kPhiloxBlockCols : 0;
+  const __m256i threshold =
+      _mm256_set1_epi32(static_cast<int>(dropout.threshold));
+  const __m256 scale_vec = _mm256_set1_ps(dropout.scale);
+  const auto simd_grad = [&](std::size_t j, __m256i block_bits) {
+    return _mm256_and_ps(_mm256_mul_ps(loadu256_ps(dout + j), scale_vec),
+                         dropout_keep_mask(block_bits, threshold));
+  };
+  if (simd) {
+    __m256 dot_vec = _mm256_setzero_ps();
+    for (; base < full; base += kPhiloxBlockCols) {
+      __m256i block_bits[4];
+      philox_block_avx2(dropout.seed, kDropoutStream, row_id,
+                        base / kPhiloxBlockCols, block_bits);
+      for (std::size_t k = 0; k < 4; ++k) {
+        const std::size_t j = base + k * 8;
+        dot_vec = _mm256_add_ps(
+            dot_vec, _mm256_mul_ps(simd_grad(j, block_bits[k]),
+                                   loadu256_ps(dx + j)));
+      }
+    }
+    dot = hsum256_ps(dot_vec);
+  }
+  for (; base < n; base += kPhiloxBlockCols) {
+    scalar_block(base, [&](std::size_t j, float g) { dot += g * dx[j]; });
+  }
+
+  base = 0;
+  if (simd) {
+    const __m256 dot_bcast = _mm256_set1_ps(dot);
+    for (; base < full; base += kPhiloxBlockCols) {
+      __m256i block_bits[4];
+      philox_block_avx2(dropout.seed, kDropoutStream, row_id,
+                        base / kPhiloxBlockCols, block_bits);
+      for (std::size_t k = 0; k < 4; ++k) {
+        const std::size_t j = base + k * 8;
+        const __m256 g = simd_grad(j, block_bits[k]);
+        storeu256_ps(dx + j, _mm256_mul_ps(loadu256_ps(dx + j),
+                                           _mm256_sub_ps(g, dot_bcast)));
+      }
+    }
+  }
+  for (; base < n; base += kPhiloxBlockCols) {
+    scalar_block(base,
+                 [&](std::size_t j, float g) { dx[j] = dx[j] * (g - dot); });
+  }
+}
+
+// Проверка форм: одинаковые размеры, непрерывная последняя ось
+inline void check_dropout_operands(const TensorShape& a, const TensorShape& b) {
+  if (a.dims != b.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!a.last_axis_contiguous() || !b.last_axis_contiguous()) {
+    throw std::invalid_argument("Softmax rows must be contiguous");
+  }
+}
+
+/**
+ * @brief dropout(softmax(x)) по последней оси за один проход записи
+ *
+ * @param row_lse rows() значений log Σ exp(x) для обратного прохода, в
+ * порядке строк тензора; nullptr, если обратный проход не нужен
+ */
+inline void softmax_dropout(TensorView<const float> logits,
+                            TensorView<float> output, float* row_lse,
+                            const Dropout& dropout, SoftmaxMethod method,
+                            DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = logits.shape;
+  const TensorShape& out_shape = output.shape;
+  check_dropout_operands(in_shape, out_shape);
+  if (in_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  const std::size_t lead = in_shape.rank() - 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float lse = SoftmaxDropoutRow(
+          logits.data + in_shape.offset_of(r, lead),
+          output.data + out_shape.offset_of(r, lead), cols, dropout, r, simd);
+      if (row_lse != nullptr) row_lse[r] = lse;
+    }
+  }
+}
+
+/**
+ * @brief Градиент по логитам для dropout(softmax(x))
+ *
+ * @param logits Те же логиты, что в прямом проходе
+ * @param row_lse log Σ exp, сохранённые прямым проходом
+ * @param grad_output Градиент по выходу dropout
+ * @param grad_input Градиент по логитам; не должен совпадать с
+ * grad_output (в него сначала восстанавливается y)
+ */
+inline void softmax_dropout_backward(
+    TensorView<const float> logits, const float* row_lse,
+    TensorView<const float> grad_output, TensorView<float> grad_input,
+    const Dropout& dropout, SoftmaxMethod method,
+    DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& x_shape = logits.shape;
+  check_dropout_operands(x_shape, grad_output.shape);
+  check_dropout_operands(x_shape, grad_input.shape);
+  if (x_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = x_shape.rows();
+  const std::size_t cols = x_shape.last_dim();
+  const std::size_t lead = x_shape.rank() - 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      SoftmaxDropoutBackwardRow(
+          logits.data + x_shape.offset_of(r, lead), row_lse[r],
+          grad_output.data + grad_output.shape.offset_of(r, lead),
+          grad_input.data + grad_input.shape.offset_of(r, lead), cols,
+          dropout, r, simd);
+    }
+  }
+}
+
+#endif  // !SOFTMAX_DROPOUT_H
@@ -0,0 +1,94 @@
+/**
+ * @file softmax_fixed.h
+ * @brief Softmax ядра для длин строк, известных при компиляции
+ *
+ * Большинство строк имеют одну из немногих длин (64 ... 4096). При известной
+ * длине не нужны проверка и маска хвоста, а число итераций - константа
+ * компиляции: два прохода блоками по 64 столбца, внутри блока векторы
+ * NativeVec развёрнуты через index_sequence и копят четыре независимые
+ * суммы. Вариант "вся строка в регистрах" для N <= 128 не быстрее:
+ * константы vexp и векторы строки не помещаются в регистровый файл, и спилы
+ * съедают выигрыш от отсутствия второго чтения из L1.
+ * Семантика - как у SoftmaxRowSimd (без вычитания максимума, нулевая сумма
+ * даёт 1/n).
+ */
+
+#ifndef SOFTMAX_FIXED_H
+#define SOFTMAX_FIXED_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "simd_vec.h"
+
+// Столбцов в блоке: не меньше одного вектора на каждую из 4 сумм
+constexpr std::size_t kSoftmaxFixedBlock = 64;
+
+// Построчное Softmax ядро: (вход, выход, длина строки)
+using SoftmaxRowKernel = void (*)(const float*, float*, std::size_t);
+
+// Вызов f(integral_constant<K>) для K = 0..sizeof...(K)-1 без цикла
+template <typename F, std::size_t... K>
+inline void unroll_indices(F&& f, std::index_sequence<K...>) {
+  (f(std::integral_constant<std::size_t, K>{}), ...);
+}
+
+template <std::size_t Count, typename F>
+inline void unroll(F&& f) {
+  unroll_indices(f, std::make_index_sequence<Count>{});
+}
+
+// Softmax строки из N значений: экспоненты в выход, затем нормировка из кэша
+template <std::size_t N>
+inline void SoftmaxRowFixed(const float* row_begin, float* row_result,
+                            std::size_t) {
+  using V = NativeVec;
+  constexpr std::size_t kVectors = kSoftmaxFixedBlock / kVecLanes;
+  static_assert(N % kSoftmaxFixedBlock == 0);
+  static_assert(kVectors % 4 == 0);
+  V acc[4] = {V::zero(), V::zero(), V::zero(), V::zero()};
+  for (std::size_t b = 0; b < N; b += kSoftmaxFixedBlock) {
+    unroll<kVectors>([&](auto k) {
+      const V e = vexp(V::load(row_begin + b + kVecLanes * k));
+      e.store(row_result + b + kVecLanes * k);
+      acc[k % 4] = acc[k % 4] + e;
+    });
+  }
+  const float sum = vreduce_add((acc[0] + acc[1]) + (acc[2] + acc[3]));
+
+  if (sum == 0.0f) {
+    std::fill(row_result, row_result + N, 1.0f / N);
+    return;
+  }
+  const V scale = V::broadcast(1.0f / sum);
+  for (std::size_t b = 0; b < N; b += kSoftmaxFixedBlock) {
+    unroll<kVectors>([&](auto k) {
+      float* out = row_result + b + kVecLanes * k;
+      (V::load(out) * scale).store(out);
+    });
+  }
+}
+
+// Таблица специализированных длин
+struct FixedSoftmaxEntry {
+  std::size_t cols;
+  SoftmaxRowKernel kernel;
+};
+
+inline constexpr FixedSoftmaxEntry kFixedSoftmaxKernels[] = {
+    {64, SoftmaxRowFixed<64>},     {128, SoftmaxRowFixed<128>},
+    {256, SoftmaxRowFixed<256>},   {512, SoftmaxRowFixed<512>},
+    {1024, SoftmaxRowFixed<1024>}, {2048, SoftmaxRowFixed<2048>},
+    {4096, SoftmaxRowFixed<4096>},
+};
+
+// Специализированное ядро для длины n или nullptr, если его нет
+inline SoftmaxRowKernel fixed_softmax_row_kernel(std::size_t n) {
+  for (const FixedSoftmaxEntry& entry : kFixedSoftmaxKernels) {
+    if (entry.cols == n) return entry.kernel;
+  }
+  return nullptr;
+}
+
+#endif  // !SOFTMAX_FIXED_H
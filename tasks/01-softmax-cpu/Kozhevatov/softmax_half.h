@@ -0,0 +1,265 @@
+/**
+ * @file softmax_half.h
+ * @brief Softmax с хранением в fp16/bf16 и вычислениями в fp32
+ *
+ * Вход и выход могут быть float, Half (fp16) или BFloat16 в любом сочетании.
+ * 16-битные значения расширяются до float прямо в регистрах (F16C vcvtph2ps
+ * для fp16, сдвиг для bf16), без временной float-матрицы; экспоненты и сумма
+ * считаются во float. Softmax упирается в пропускную способность памяти,
+ * поэтому вдвое меньше байт на элемент - почти вдвое меньше времени.
+ * Промежуточные экспоненты хранятся в строке-буфере потока (float), которая
+ * не покидает кэш.
+ *
+ * Для fp16 входа есть точная табличная экспонента: у fp16 всего 65536
+ * значений, и exp каждого заранее вычислен в double и округлён до float.
+ */
+
+#ifndef SOFTMAX_HALF_H
+#define SOFTMAX_HALF_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Способ вычисления экспоненты для 16-битного входа
+enum class HalfExp {
+  kPolynomial,  // exp256_ps над расширенными до float значениями
+  kTable,       // таблица exp на все 65536 значений fp16 (только Half)
+};
+
+// Загрузка/сохранение 8 элементов и скалярные преобразования типа хранения
+template <typename T>
+struct StorageTraits;
+
+template <>
+struct StorageTraits<float> {
+  static __m256 load(const float* src) { return loadu256_ps(src); }
+  static void store(float* dst, __m256 v) { storeu256_ps(dst, v); }
+  static float to_float(float x) { return x; }
+  static float from_float(float x) { return x; }
+};
+
+template <>
+struct StorageTraits<Half> {
+  static __m256 load(const Half* src) {
+    return loadu_f16_ps(reinterpret_cast<const std::uint16_t*>(src));
+  }
+  static void store(Half* dst, __m256 v) {
+    storeu_f16_ps(reinterpret_cast<std::uint16_t*>(dst), v);
+  }
+  static float to_float(Half x) { return f16_to_f32(x.bits); }
+  static Half from_float(float x) { return {f32_to_f16(x)}; }
+};
+
+template <>
+struct StorageTraits<BFloat16> {
+  static __m256 load(const BFloat16* src) {
+    return loadu_bf16_ps(reinterpret_cast<const std::uint16_t*>(src));
+  }
+  static void store(BFloat16* dst, __m256 v) {
+    storeu_bf16_ps(reinterpret_cast<std::uint16_t*>(dst), v);
+  }
+  static float to_float(BFloat16 x) { return bf16_to_f32(x.bits); }
+  static BFloat16 from_float(float x) { return {f32_to_bf16(x)}; }
+};
+
+/**
+ * @brief Таблица exp(x) для всех 65536 значений fp16 (256 КиБ)
+ *
+ * Аргумент ограничен тем же диапазоном, что и в exp256_ps, поэтому
+ * табличный и полиномиальный пути совпадают на больших логитах. Таблица
+ * строится при первом обращении (инициализация static потокобезопасна).
+ */
+inline const float* half_exp_table() {
+  static const std::vector<float> table = [] {
+    std::vector<float> values(1 << 16);
+    for (std::size_t bits = 0; bits < values.size(); ++bits) {
+      const double x = f16_to_f32(static_cast<std::uint16_t>(bits));
+      values[bits] = static_cast<float>(
+          std::exp(std::isnan(x) ? x : std::clamp(x, -88.3762626647949,
+                                                  88.3762626647949)));
+    }
+    return values;
+  }();
+  return table.data();
+}
+
+// exp 8 элементов входа: полиномом или по таблице (gather по битам fp16)
+template <typename In, HalfExp kExp>
+inline __m256 exp8(const In* src, const float* table) {
+  if constexpr (kExp == HalfExp::kTable) {
+    const __m256i index = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    return _mm256_i32gather_ps(table, index, 4);
+  } else {
+    return exp256_ps(StorageTraits<In>::load(src));
+  }
+}
+
+template <typename In, HalfExp kExp>
+inline float exp1(In x, const float* table) {
+  if constexpr (kExp == HalfExp::kTable) {
+    return table[x.bits];
+  } else {
+    return std::exp(StorageTraits<In>::to_float(x));
+  }
+}
+
+/**
+ * @brief Softmax строки с произвольными типами хранения (векторизованная)
+ *
+ * Ненормализованные экспоненты в 16-битный выход не помещаются (fp16
+ * переполняется уже на exp(11.1)), поэтому для него они сохраняются в
+ * буфер scratch из n float - строку потока, которая остаётся в кэше. Для
+ * float выхода схема та же, что в SoftmaxRowSimd, и scratch не нужен.
+ * Сумма экспонент - попарная, с хвостом под маской (RowSumStoredSimd).
+ */
+template <typename In, typename Out, HalfExp kExp = HalfExp::kPolynomial>
+inline void SoftmaxRowSimdStorage(const In* row_begin, Out* row_result,
+                                  std::size_t n, float* scratch) {
+  if (n == 0) return;
+  float* exps = scratch;
+  if constexpr (std::is_same_v<Out, float>) exps = row_result;
+  const float* table = kExp == HalfExp::kTable ? half_exp_table() : nullptr;
+
+  using V = Vec<float, 8>;
+  const auto exp_at = [&](std::size_t j, std::size_t count) {
+    if (count == 8) return V{exp8<In, kExp>(row_begin + j, table)};
+    // Хвост - через буфер с нулями: лишние дорожки обнуляет каркас
+    In tail[8] = {};
+    std::copy(row_begin + j, row_begin + j + count, tail);
+    return V{exp8<In, kExp>(tail, table)};
+  };
+  const float sum_exp = RowSumStoredSimd<8>(n, exps, exp_at);
+
+  if (sum_exp == 0.0f) {
+    std::fill(row_result, row_result + n,
+              StorageTraits<Out>::from_float(1.0f / n));
+    return;
+  }
+
+  const float inv_sum = 1.0f / sum_exp;
+  const __m256 inv_vec = _mm256_set1_ps(inv_sum);
+  std::size_t i = 0;
+  for (; i + 7 < n; i += 8) {
+    StorageTraits<Out>::store(row_result + i,
+                              _mm256_mul_ps(loadu256_ps(exps + i), inv_vec));
+  }
+  for (; i < n; ++i) {
+    row_result[i] = StorageTraits<Out>::from_float(exps[i] * inv_sum);
+  }
+}
+
+// Softmax строки с произвольными типами хранения (скалярная версия)
+template <typename In, typename Out, HalfExp kExp = HalfExp::kPolynomial>
+inline void SoftmaxRowStorage(const In* row_begin, Out* row_result,
+                              std::size_t n, float* scratch) {
+  const float* table = kExp == HalfExp::kTable ? half_exp_table() : nullptr;
+  float sum_exp = 0.0f;
+  for (std::size_t j = 0; j < n; ++j) {
+    scratch[j] = exp1<In, kExp>(row_begin[j], table);
+    sum_exp += scratch[j];
+  }
+
+  if (sum_exp == 0.0f) {
+    std::fill(row_result, row_result + n,
+              StorageTraits<Out>::from_float(1.0f / n));
+    return;
+  }
+
+  const float div_sum_exp = 1.0f / sum_exp;
+  for (std::size_t j = 0; j < n; ++j) {
+    row_result[j] = StorageTraits<Out>::from_float(scratch[j] * div_sum_exp);
+  }
+}
+
+/**
+ * @brief Softmax для rows строк длины cols с хранением в fp16/bf16
+ *
+ * Аналог softmax_rows для других типов входа и выхода (float, Half,
+ * BFloat16). HalfExp::kTable допустим только для входа Half.
+ */
+template <typename In, typename Out>
+inline void softmax_rows(const In* input, std::size_t input_stride,
+                         Out* output, std::size_t output_stride,
+                         std::size_t rows, std::size_t cols,
+                         SoftmaxMethod method,
+                         DenormalMode mode = DenormalMode::kPreserve,
+                         HalfExp exp = HalfExp::kPolynomial) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+
+  void (*row_kernel)(const In*, Out*, std::size_t, float*) =
+      simd ? SoftmaxRowSimdStorage<In, Out> : SoftmaxRowStorage<In, Out>;
+  if (exp == HalfExp::kTable) {
+    if constexpr (std::is_same_v<In, Half>) {
+      half_exp_table();  // построение таблицы вне параллельного региона
+      row_kernel = simd ? SoftmaxRowSimdStorage<In, Out, HalfExp::kTable>
+                        : SoftmaxRowStorage<In, Out, HalfExp::kTable>;
+    } else {
+      throw std::invalid_argument("Table exp requires fp16 input");
+    }
+  }
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+    std::vector<float> scratch(cols);
+#pragma omp for
+    for (std::size_t i = 0; i < rows; ++i) {
+      row_kernel(input + i * input_stride, output + i * output_stride, cols,
+                 scratch.data());
+    }
+  }
+}
+
+// Softmax по последней оси для 16-битных представлений; ведущие оси должны
+// сворачиваться в строки
+template <typename In, typename Out>
+inline void softmax_last_axis(TensorView<const In> input,
+                              TensorView<Out> output, SoftmaxMethod method,
+                              DenormalMode mode = DenormalMode::kPreserve,
+                              HalfExp exp = HalfExp::kPolynomial) {
+  if (input.shape.dims != output.shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (input.numel() == 0) return;
+  softmax_rows(input.data, input.shape.row_stride(), output.data,
+               output.shape.row_stride(), input.shape.rows(),
+               input.shape.last_dim(), method, mode, exp);
+}
+
+// Преобразование буфера float в тип хранения и обратно
+template <typename T>
+inline std::vector<T> convert_from_float(const std::vector<float>& values) {
+  std::vector<T> result(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    result[i] = StorageTraits<T>::from_float(values[i]);
+  }
+  return result;
+}
+
+template <typename T>
+inline std::vector<float> convert_to_float(const std::vector<T>& values) {
+  std::vector<float> result(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    result[i] = StorageTraits<T>::to_float(values[i]);
+  }
+  return result;
+}
+
+#endif  // !SOFTMAX_HALF_H
@@ -0,0 +1,182 @@
+/**
+ * @file softmax_health.h
+ * @brief Флаги состояния строк Softmax: NaN, +Inf, опустошение суммы, обрезка
+ * аргумента exp
+ *
+ * vexp обрезает аргумент до [-88.38, 88.38], а NaN проходит min/max как
+ * граница диапазона, поэтому NaN и +Inf на входе дают не NaN на выходе, а
+ * правдоподобные, но неверные вероятности. Проверка встроена в проход суммы
+ * каркаса row_reduce.h: каждая причина копится своим слагаемым-счётчиком
+ * (NaN, +Inf, конечное x > 88.38), поэтому повторного прохода по строке нет
+ * и флаги верны и при вызове на месте (input == output), когда вход к
+ * моменту свёртки уже заменён экспонентами.
+ */
+
+#ifndef SOFTMAX_HEALTH_H
+#define SOFTMAX_HEALTH_H
+
+#include <omp.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Битовая маска состояния строки
+using RowHealth = std::uint8_t;
+
+constexpr RowHealth kRowHealthy = 0;
+constexpr RowHealth kRowNaN = 1 << 0;           // есть NaN
+constexpr RowHealth kRowPosInf = 1 << 1;        // есть +Inf
+constexpr RowHealth kRowSumUnderflow = 1 << 2;  // Σ exp = 0, выход - 1/n
+constexpr RowHealth kRowExpClamped = 1 << 3;    // конечный x > kExpClampHigh
+
+// Верхняя граница аргумента vexp: выше экспонента переполняет float.
+// Нижняя обрезка не отмечается: она меняет только значения меньше
+// FLT_MIN и срабатывает на каждом замаскированном -inf
+constexpr float kExpClampHigh = 88.3762626647949f;
+
+/**
+ * @brief Softmax с флагами состояния как операция каркаса row_reduce.h
+ *
+ * Слагаемое 0 - exp(x), как в SoftmaxOp (выход побитово тот же);
+ * слагаемые 1-3 - число NaN, +Inf и конечных x > kExpClampHigh. +Inf -
+ * единственное значение больше FLT_MAX, поэтому хватает сравнения "больше".
+ */
+struct SoftmaxHealthOp {
+  static constexpr std::size_t kTerms = 4;
+  static constexpr bool kMapStored = true;
+
+  struct Params {
+    float scale;       // 1/sum или 1/n
+    bool uniform;      // сумма равна нулю
+    RowHealth health;  // флаги строки
+  };
+
+  SoftmaxHealthOp at_row(const float*, std::size_t) const { return *this; }
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> x, const RowLanes<W>&,
+              Vec<float, W>* terms) const {
+    using V = Vec<float, W>;
+    const V inf = vflag_gt(x, V::broadcast(std::numeric_limits<float>::max()));
+    terms[0] = vexp(x);
+    terms[1] = vflag_nan(x);
+    terms[2] = inf;
+    terms[3] = vflag_gt(x, V::broadcast(kExpClampHigh)) - inf;
+  }
+  void reduce(float x, std::size_t, float* terms) const {
+    const bool inf = x == std::numeric_limits<float>::infinity();
+    terms[0] = std::exp(x);
+    terms[1] = x != x ? 1.0f : 0.0f;
+    terms[2] = inf ? 1.0f : 0.0f;
+    terms[3] = x > kExpClampHigh && !inf ? 1.0f : 0.0f;
+  }
+
+  Params combine(const float* sums, std::size_t n) const {
+    RowHealth health = kRowHealthy;
+    if (sums[1] != 0.0f) health |= kRowNaN;
+    if (sums[2] != 0.0f) health |= kRowPosInf;
+    if (sums[3] != 0.0f) health |= kRowExpClamped;
+    if (sums[0] == 0.0f) {
+      health |= kRowSumUnderflow;
+      return {1.0f / n, true, health};
+    }
+    return {1.0f / sums[0], false, health};
+  }
+
+  template <std::size_t W>
+  Vec<float, W> map(Vec<float, W> e, const RowLanes<W>&,
+                    const Params& p) const {
+    const auto scale = Vec<float, W>::broadcast(p.scale);
+    return p.uniform ? scale : e * scale;
+  }
+  float map(float e, std::size_t, const Params& p) const {
+    return p.uniform ? p.scale : e * p.scale;
+  }
+};
+
+/**
+ * @brief Softmax для rows строк длины cols с флагами каждой строки
+ *
+ * Шаги строк - как в softmax_rows. Ядра фиксированной длины не
+ * используются: проверка встроена в общий каркас.
+ *
+ * @param health Флаги строк (rows значений)
+ */
+inline void softmax_rows_health(const float* input, std::size_t input_stride,
+                                float* output, std::size_t output_stride,
+                                std::size_t rows, std::size_t cols,
+                                RowHealth* health, SoftmaxMethod method,
+                                DenormalMode mode = DenormalMode::kPreserve) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t i = 0; i < rows; ++i) {
+      const float* in = input + i * input_stride;
+      float* out = output + i * output_stride;
+      const SoftmaxHealthOp::Params params =
+          simd ? RowReduceMapSimd(SoftmaxHealthOp{}, in, out, cols)
+               : RowReduceMap(SoftmaxHealthOp{}, in, out, cols);
+      health[i] = params.health;
+    }
+  }
+}
+
+// Softmax по последней оси с флагами строк; ведущие оси должны
+// сворачиваться в строки
+inline void softmax_last_axis_health(
+    TensorView<const float> input, TensorView<float> output,
+    RowHealth* health, SoftmaxMethod method,
+    DenormalMode mode = DenormalMode::kPreserve) {
+  if (input.shape.dims != output.shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!input.shape.rows_collapsible() || !output.shape.rows_collapsible()) {
+    throw std::invalid_argument("Health flags need rows with a fixed stride");
+  }
+  if (input.numel() == 0) return;
+  softmax_rows_health(input.data, input.shape.row_stride(), output.data,
+                      output.shape.row_stride(), input.shape.rows(),
+                      input.shape.last_dim(), health, method, mode);
+}
+
+// Число строк с каждым флагом
+struct HealthSummary {
+  std::size_t rows = 0;
+  std::size_t unhealthy = 0;
+  std::size_t nan = 0;
+  std::size_t pos_inf = 0;
+  std::size_t sum_underflow = 0;
+  std::size_t exp_clamped = 0;
+};
+
+inline HealthSummary summarize_health(const RowHealth* health,
+                                      std::size_t rows) {
+  HealthSummary summary;
+  summary.rows = rows;
+  for (std::size_t r = 0; r < rows; ++r) {
+    const RowHealth h = health[r];
+    summary.unhealthy += h != kRowHealthy;
+    summary.nan += (h & kRowNaN) != 0;
+    summary.pos_inf += (h & kRowPosInf) != 0;
+    summary.sum_underflow += (h & kRowSumUnderflow) != 0;
+    summary.exp_clamped += (h & kRowExpClamped) != 0;
+  }
+  return summary;
+}
+
+#endif  // !SOFTMAX_HEALTH_H
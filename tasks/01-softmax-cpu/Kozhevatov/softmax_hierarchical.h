@@ -0,0 +1,298 @@
+/**
+ * @file softmax_hierarchical.h
+ * @brief Двухуровневый Softmax для словарей из сотен тысяч классов
+ *
+ * Классы разбиты на C кластеров: p(v | h) = p(c(v) | h) * p(v | c(v), h).
+ * Логиты кластеров z_c = <W_c, h> нормализуются по C значениям, логиты
+ * членов кластера z_v = <W_v, h> - только по членам выбранного кластера.
+ * Для вероятности заданной метки считается C + |c(v)| скалярных
+ * произведений вместо V; при C ~ √V и равных кластерах это O(√V) на токен.
+ * Нормализация обоих уровней - LogitStatsRowSimd из softmax_loss.h (с
+ * вычитанием максимума: логиты линейного слоя не ограничены).
+ */
+
+#ifndef SOFTMAX_HIERARCHICAL_H
+#define SOFTMAX_HIERARCHICAL_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+#include "softmax_loss.h"
+#include "tensor.h"
+
+/**
+ * @brief Разбиение словаря на кластеры
+ *
+ * members - классы, сгруппированные по кластерам: кластер c занимает
+ * members[offsets[c], offsets[c + 1]); slot[v] - позиция класса v в members.
+ */
+struct ClusterTable {
+  std::vector<std::size_t> cluster_of;  // кластер каждого класса, [V]
+  std::vector<std::size_t> offsets;     // границы кластеров, [C + 1]
+  std::vector<std::size_t> members;     // классы по кластерам, [V]
+  std::vector<std::size_t> slot;        // позиция класса в members, [V]
+
+  std::size_t vocab() const { return cluster_of.size(); }
+  std::size_t clusters() const { return offsets.size() - 1; }
+  std::size_t cluster_size(std::size_t c) const {
+    return offsets[c + 1] - offsets[c];
+  }
+
+  // Таблица по произвольному назначению класс -> кластер (сортировка
+  // подсчётом, порядок классов внутри кластера сохраняется)
+  static ClusterTable from_assignment(std::vector<std::size_t> assignment,
+                                      std::size_t clusters) {
+    ClusterTable table;
+    table.offsets.assign(clusters + 1, 0);
+    for (std::size_t c : assignment) {
+      if (c >= clusters) {
+        throw std::invalid_argument("Cluster id is out of range");
+      }
+      ++table.offsets[c + 1];
+    }
+    for (std::size_t c = 0; c < clusters; ++c) {
+      table.offsets[c + 1] += table.offsets[c];
+    }
+    table.members.resize(assignment.size());
+    table.slot.resize(assignment.size());
+    std::vector<std::size_t> next(table.offsets.begin(),
+                                  table.offsets.end() - 1);
+    for (std::size_t v = 0; v < assignment.size(); ++v) {
+      const std::size_t position = next[assignment[v]]++;
+      table.members[position] = v;
+      table.slot[v] = position;
+    }
+    table.cluster_of = std::move(assignment);
+    return table;
+  }
+
+  // Подряд идущие классы в clusters кластеров почти равного размера
+  static ClusterTable contiguous(std::size_t vocab, std::size_t clusters) {
+    std::vector<std::size_t> assignment(vocab);
+    for (std::size_t v = 0; v < vocab; ++v) {
+      assignment[v] = v * clusters / vocab;
+    }
+    return from_assignment(std::move(assignment), clusters);
+  }
+};
+
+// Скалярное произведение векторов длины n
+inline float dot_product(const float* a, const float* b, std::size_t n,
+                         bool simd) {
+  std::size_t i = 0;
+  float dot = 0.0f;
+  if (simd) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 15 < n; i += 16) {
+      acc0 = _mm256_add_ps(
+          acc0, _mm256_mul_ps(loadu256_ps(a + i), loadu256_ps(b + i)));
+      acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(loadu256_ps(a + i + 8),
+                                               loadu256_ps(b + i + 8)));
+    }
+    for (; i + 7 < n; i += 8) {
+      acc0 = _mm256_add_ps(
+          acc0, _mm256_mul_ps(loadu256_ps(a + i), loadu256_ps(b + i)));
+    }
+    dot = hsum256_ps(_mm256_add_ps(acc0, acc1));
+  }
+  for (; i < n; ++i) dot += a[i] * b[i];
+  return dot;
+}
+
+/**
+ * @brief Параметры двухуровневого Softmax
+ *
+ * cluster_weights - [C, d], строка c - вектор кластера; class_weights -
+ * [V, d], строка v - вектор класса (выходное представление). Строки весов
+ * должны быть непрерывны, пустые кластеры не допускаются.
+ */
+struct HierarchicalSoftmax {
+  TensorView<const float> cluster_weights;
+  TensorView<const float> class_weights;
+  ClusterTable table;
+
+  HierarchicalSoftmax(TensorView<const float> cluster_weights_,
+                      TensorView<const float> class_weights_,
+                      ClusterTable table_)
+      : cluster_weights(std::move(cluster_weights_)),
+        class_weights(std::move(class_weights_)),
+        table(std::move(table_)) {
+    if (cluster_weights.rank() != 2 || class_weights.rank() != 2 ||
+        cluster_weights.shape.dims[1] != class_weights.shape.dims[1]) {
+      throw std::invalid_argument("Weights must be [C, d] and [V, d]");
+    }
+    if (!cluster_weights.shape.last_axis_contiguous() ||
+        !class_weights.shape.last_axis_contiguous()) {
+      throw std::invalid_argument("Weight rows must be contiguous");
+    }
+    if (cluster_weights.shape.dims[0] != table.clusters() ||
+        class_weights.shape.dims[0] != table.vocab()) {
+      throw std::invalid_argument("Cluster table does not match weights");
+    }
+    // Пустой кластер забирал бы долю вероятности верхнего уровня
+    for (std::size_t c = 0; c < table.clusters(); ++c) {
+      if (table.cluster_size(c) == 0) {
+        throw std::invalid_argument("Every cluster must contain a class");
+      }
+    }
+  }
+
+  std::size_t hidden() const { return class_weights.shape.dims[1]; }
+
+  const float* cluster_row(std::size_t c) const {
+    return cluster_weights.data + c * cluster_weights.shape.strides[0];
+  }
+  const float* class_row(std::size_t v) const {
+    return class_weights.data + v * class_weights.shape.strides[0];
+  }
+
+  // Логиты кластеров для скрытого вектора h, [C] значений в logits
+  void cluster_logits(const float* h, float* logits, bool simd) const {
+    for (std::size_t c = 0; c < table.clusters(); ++c) {
+      logits[c] = dot_product(cluster_row(c), h, hidden(), simd);
+    }
+  }
+
+  // Логиты членов кластера c в порядке members, [|c|] значений
+  void member_logits(std::size_t c, const float* h, float* logits,
+                     bool simd) const {
+    const std::size_t* member = table.members.data() + table.offsets[c];
+    for (std::size_t k = 0; k < table.cluster_size(c); ++k) {
+      logits[k] = dot_product(class_row(member[k]), h, hidden(), simd);
+    }
+  }
+};
+
+// log-нормализатор строки логитов (скалярно или SIMD)
+inline float hierarchical_lse(const float* logits, std::size_t n,
+                              bool simd) {
+  return simd ? LogitStatsRowSimd(logits, n).lse
+              : LogitStatsRow(logits, n).lse;
+}
+
+/**
+ * @brief log p(target | h) для каждой строки h
+ *
+ * @param hidden Скрытые векторы [N, d]
+ * @param targets N меток классов
+ * @param log_probs N значений log p(target | h)
+ */
+inline void hierarchical_log_prob(const HierarchicalSoftmax& model,
+                                  TensorView<const float> hidden,
+                                  const std::size_t* targets,
+                                  float* log_probs, SoftmaxMethod method) {
+  if (hidden.rank() != 2 || hidden.shape.dims[1] != model.hidden() ||
+      !hidden.shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Hidden states must be [N, d]");
+  }
+  const std::size_t tokens = hidden.shape.dims[0];
+  for (std::size_t t = 0; t < tokens; ++t) {
+    if (targets[t] >= model.table.vocab()) {
+      throw std::invalid_argument("Target class is out of range");
+    }
+  }
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  std::size_t widest = 0;
+  for (std::size_t c = 0; c < model.table.clusters(); ++c) {
+    widest = std::max(widest, model.table.cluster_size(c));
+  }
+
+#pragma omp parallel if (parallel)
+  {
+    std::vector<float> top(model.table.clusters()), inner(widest);
+#pragma omp for
+    for (std::size_t t = 0; t < tokens; ++t) {
+      const float* h = hidden.data + t * hidden.shape.strides[0];
+      const std::size_t target = targets[t];
+      const std::size_t c = model.table.cluster_of[target];
+      model.cluster_logits(h, top.data(), simd);
+      model.member_logits(c, h, inner.data(), simd);
+      const std::size_t k = model.table.slot[target] - model.table.offsets[c];
+      log_probs[t] = top[c] - hierarchical_lse(top.data(), top.size(), simd) +
+                     inner[k] -
+                     hierarchical_lse(inner.data(),
+                                      model.table.cluster_size(c), simd);
+    }
+  }
+}
+
+/**
+ * @brief Полное распределение p(v | h) по всем V классам (запасной путь)
+ *
+ * Стоит O(V d), как и плоский Softmax, но даёт те же вероятности, что
+ * hierarchical_log_prob: нужен для сэмплирования и оценки по всему словарю.
+ *
+ * @param probs Вероятности [N, V] в порядке номеров классов
+ */
+inline void hierarchical_softmax_full(const HierarchicalSoftmax& model,
+                                      TensorView<const float> hidden,
+                                      TensorView<float> probs,
+                                      SoftmaxMethod method) {
+  if (hidden.rank() != 2 || hidden.shape.dims[1] != model.hidden() ||
+      !hidden.shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Hidden states must be [N, d]");
+  }
+  const std::size_t tokens = hidden.shape.dims[0];
+  if (probs.rank() != 2 || probs.shape.dims[0] != tokens ||
+      probs.shape.dims[1] != model.table.vocab() ||
+      !probs.shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Probabilities must be [N, V]");
+  }
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  std::size_t widest = 0;
+  for (std::size_t c = 0; c < model.table.clusters(); ++c) {
+    widest = std::max(widest, model.table.cluster_size(c));
+  }
+
+#pragma omp parallel if (parallel)
+  {
+    std::vector<float> top(model.table.clusters()), inner(widest);
+#pragma omp for
+    for (std::size_t t = 0; t < tokens; ++t) {
+      const float* h = hidden.data + t * hidden.shape.strides[0];
+      float* row = probs.data + t * probs.shape.strides[0];
+      model.cluster_logits(h, top.data(), simd);
+      const float top_lse = hierarchical_lse(top.data(), top.size(), simd);
+      for (std::size_t c = 0; c < model.table.clusters(); ++c) {
+        const std::size_t size = model.table.cluster_size(c);
+        model.member_logits(c, h, inner.data(), simd);
+        // p(v) = exp(z_c - lse_top + z_v - lse_c)
+        const float shift =
+            hierarchical_lse(inner.data(), size, simd) - (top[c] - top_lse);
+        std::size_t k = 0;
+        if (simd) {
+          const __m256 shift_vec = _mm256_set1_ps(shift);
+          for (; k + 7 < size; k += 8) {
+            storeu256_ps(inner.data() + k,
+                         exp256_ps(_mm256_sub_ps(loadu256_ps(inner.data() + k),
+                                                 shift_vec)));
+          }
+        }
+        for (; k < size; ++k) inner[k] = std::exp(inner[k] - shift);
+        const std::size_t* member =
+            model.table.members.data() + model.table.offsets[c];
+        for (k = 0; k < size; ++k) row[member[k]] = inner[k];
+      }
+    }
+  }
+}
+
+#endif  // !SOFTMAX_HIERARCHICAL_H
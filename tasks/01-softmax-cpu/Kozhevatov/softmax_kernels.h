@@ -0,0 +1,294 @@
+/**
+ * @file softmax_kernels.h
+ * @brief Построчные Softmax ядра и их запуск над набором строк
+ *
+ * Строка - единица работы для всех методов: матрица n×n, тензор с
+ * произвольным числом осей и батч внимания сводятся к вызову softmax_rows
+ * (или к построчному обходу, если строки нельзя свернуть в одну ось).
+ */
+
+#ifndef SOFTMAX_KERNELS_H
+#define SOFTMAX_KERNELS_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_fixed.h"
+#include "tensor.h"
+
+/**
+ * @brief Softmax строки как операция каркаса row_reduce.h
+ *
+ * Редукция - Σ exp(x); экспоненты сохраняются в выходную строку, и map
+ * только умножает их на 1/sum. Нулевая сумма (все exp опустошились) даёт
+ * равномерное распределение 1/n.
+ */
+struct SoftmaxOp {
+  static constexpr std::size_t kTerms = 1;
+  static constexpr bool kMapStored = true;
+
+  struct Params {
+    float scale;   // 1/sum или 1/n
+    bool uniform;  // сумма равна нулю
+  };
+
+  SoftmaxOp at_row(const float*, std::size_t) const { return *this; }
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> x, const RowLanes<W>&,
+              Vec<float, W>* terms) const {
+    terms[0] = vexp(x);
+  }
+  void reduce(float x, std::size_t, float* terms) const {
+    terms[0] = std::exp(x);
+  }
+
+  Params combine(const float* sums, std::size_t n) const {
+    if (sums[0] == 0.0f) return {1.0f / n, true};
+    return {1.0f / sums[0], false};
+  }
+
+  template <std::size_t W>
+  Vec<float, W> map(Vec<float, W> e, const RowLanes<W>&,
+                    const Params& p) const {
+    const auto scale = Vec<float, W>::broadcast(p.scale);
+    return p.uniform ? scale : e * scale;
+  }
+  float map(float e, std::size_t, const Params& p) const {
+    return p.uniform ? p.scale : e * p.scale;
+  }
+};
+
+/**
+ * @brief Слагаемое exp(x - shift) для проходов суммы RowReduce и
+ * RowReduceSimd
+ *
+ * Сдвиг - обычно максимум строки. При kStoreExp экспоненты сохраняются в
+ * out: так ядра, которые нормируют строку сами (отложенный масштаб,
+ * dropout), получают сумму и экспоненты за один проход.
+ */
+template <bool kStoreExp = false>
+struct ShiftedExpOp {
+  static constexpr std::size_t kTerms = 1;
+  static constexpr bool kMapStored = kStoreExp;
+
+  float shift;
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> x, const RowLanes<W>&,
+              Vec<float, W>* terms) const {
+    terms[0] = vexp(x - Vec<float, W>::broadcast(shift));
+  }
+  void reduce(float x, std::size_t, float* terms) const {
+    terms[0] = std::exp(x - shift);
+  }
+};
+
+// Softmax для одной строки (скалярная версия)
+inline void SoftmaxRow(const float* row_begin, float* row_result,
+                       std::size_t n) {
+  RowReduceMap(SoftmaxOp{}, row_begin, row_result, n);
+}
+
+/**
+ * @brief Softmax строки над Vec<float, W> - одна реализация для SSE, AVX2 и
+ * AVX-512
+ *
+ * Каркас RowReduceMapSimd с SoftmaxOp: экспоненты в выход, попарная сумма
+ * блоков, хвост под маской, нулевая сумма даёт 1/n.
+ */
+template <std::size_t W>
+inline void SoftmaxRowVec(const float* row_begin, float* row_result,
+                          std::size_t n) {
+  RowReduceMapSimd<W>(SoftmaxOp{}, row_begin, row_result, n);
+}
+
+// Softmax для одной строки (векторизованная версия на ширине NativeVec)
+inline void SoftmaxRowSimd(const float* row_begin, float* row_result,
+                           std::size_t n) {
+  SoftmaxRowVec<kVecLanes>(row_begin, row_result, n);
+}
+
+// Ядро строки длины n: специализированное по длине (softmax_fixed.h), если
+// оно есть, иначе общее
+inline SoftmaxRowKernel softmax_row_kernel(std::size_t n, bool simd) {
+  if (!simd) return SoftmaxRow;
+  const SoftmaxRowKernel fixed = fixed_softmax_row_kernel(n);
+  return fixed != nullptr ? fixed : SoftmaxRowSimd;
+}
+
+// Метод вычисления Softmax
+enum class SoftmaxMethod {
+  kSequential,  // скалярно, один поток
+  kOpenMP,      // скалярно, строки распределены между потоками
+  kSimd,        // SIMD (NativeVec), один поток
+  kOpenMPSimd,  // SIMD, строки распределены между потоками
+};
+
+/**
+ * @brief Порядок слияния частичных сумм, посчитанных разными потоками
+ *
+ * Построчные ядра воспроизводимы всегда: строку целиком считает один поток.
+ * Редукции внутри строки (огромные сегменты, состояние Softmax длинной
+ * строки, средняя потеря по батчу) в быстром режиме режутся по числу
+ * потоков. В воспроизводимом режиме куски и порядок их слияния зависят
+ * только от формы данных, и результат побитово один и тот же при любом
+ * числе потоков, в том числе у kOpenMP и kSequential (kOpenMPSimd и kSimd).
+ */
+enum class ReductionOrder {
+  kFast,          // куски по потокам, результат зависит от их числа
+  kReproducible,  // куски фиксированного размера, слияние в их порядке
+};
+
+/**
+ * @brief Операция каркаса row_reduce.h для rows строк длины cols
+ *
+ * Общий запуск построчных операций (Softmax, LayerNorm, RMSNorm): строки с
+ * шагами, скалярный или векторный вариант, распределение строк между
+ * потоками и режим денормалов в каждом потоке.
+ */
+template <typename Op>
+inline void reduce_map_rows(const Op& op, const float* input,
+                            std::size_t input_stride, float* output,
+                            std::size_t output_stride, std::size_t rows,
+                            std::size_t cols, SoftmaxMethod method,
+                            DenormalMode mode = DenormalMode::kPreserve) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+
+#pragma omp parallel if (parallel)
+  {
+    // MXCSR у каждого потока свой - переключаем режим внутри региона
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t i = 0; i < rows; ++i) {
+      if (simd) {
+        RowReduceMapSimd(op, input + i * input_stride,
+                         output + i * output_stride, cols);
+      } else {
+        RowReduceMap(op, input + i * input_stride, output + i * output_stride,
+                     cols);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Softmax для rows строк длины cols
+ *
+ * @param input Начало первой входной строки
+ * @param input_stride Расстояние (в элементах) между началами входных строк
+ * @param output Начало первой выходной строки
+ * @param output_stride Расстояние между началами выходных строк
+ *
+ * Шаги строк позволяют обрабатывать строки с выравниванием (leading
+ * dimension > cols) без копирования во временный буфер. Для длин из
+ * kFixedSoftmaxKernels ядро выбирается один раз на вызов.
+ */
+inline void softmax_rows(const float* input, std::size_t input_stride,
+                         float* output, std::size_t output_stride,
+                         std::size_t rows, std::size_t cols,
+                         SoftmaxMethod method,
+                         DenormalMode mode = DenormalMode::kPreserve) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const SoftmaxRowKernel fixed = simd ? fixed_softmax_row_kernel(cols)
+                                      : nullptr;
+  if (fixed == nullptr) {
+    reduce_map_rows(SoftmaxOp{}, input, input_stride, output, output_stride,
+                    rows, cols, method, mode);
+    return;
+  }
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t i = 0; i < rows; ++i) {
+      fixed(input + i * input_stride, output + i * output_stride, cols);
+    }
+  }
+}
+
+/**
+ * @brief Softmax по последней оси тензора, заданного представлениями
+ *
+ * Быстрый путь: последняя ось непрерывна, а ведущие оси сворачиваются в
+ * строки с постоянным шагом - работа уходит в softmax_rows без копий. Иначе
+ * (срез по средней оси, переставленные оси) смещение каждой строки
+ * вычисляется по шагам; строка с ненулевым шагом последней оси собирается во
+ * временный буфер потока.
+ */
+inline void softmax_last_axis(TensorView<const float> input,
+                              TensorView<float> output, SoftmaxMethod method,
+                              DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = output.shape;
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (in_shape.numel() == 0) return;
+
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  if (in_shape.rows_collapsible() && out_shape.rows_collapsible()) {
+    softmax_rows(input.data, in_shape.row_stride(), output.data,
+                 out_shape.row_stride(), rows, cols, method, mode);
+    return;
+  }
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const SoftmaxRowKernel row_kernel = softmax_row_kernel(cols, simd);
+  const std::size_t lead = in_shape.rank() - 1;
+  const std::size_t in_step = in_shape.strides.back();
+  const std::size_t out_step = out_shape.strides.back();
+  const bool gather = !in_shape.last_axis_contiguous() ||
+                      !out_shape.last_axis_contiguous();
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+    std::vector<float> in_row(gather ? cols : 0), out_row(gather ? cols : 0);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float* src = input.data + in_shape.offset_of(r, lead);
+      float* dst = output.data + out_shape.offset_of(r, lead);
+      if (!gather) {
+        row_kernel(src, dst, cols);
+        continue;
+      }
+      for (std::size_t j = 0; j < cols; ++j) in_row[j] = src[j * in_step];
+      row_kernel(in_row.data(), out_row.data(), cols);
+      for (std::size_t j = 0; j < cols; ++j) dst[j * out_step] = out_row[j];
+    }
+  }
+}
+
+// Вариант для тензора в std::vector: результат - плотный тензор той же формы
+inline std::vector<float> softmax_last_axis(
+    const std::vector<float>& input, const TensorShape& shape,
+    SoftmaxMethod method, DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape dense(shape.dims);
+  std::vector<float> result(dense.numel());
+  softmax_last_axis(make_view(input, shape), make_view(result, dense), method,
+                    mode);
+  return result;
+}
+
+#endif  // !SOFTMAX_KERNELS_H
@@ -0,0 +1,132 @@
+/**
+ * @file softmax_lazy.h
+ * @brief Softmax с отложенной нормализацией: exp(x - max) и масштаб строки
+ *
+ * Обычный Softmax после экспонент ещё раз читает и переписывает всю матрицу,
+ * умножая её на 1/sum. Если следующая операция - умножение на матрицу
+ * (внимание: P×V), нормализацию выгоднее перенести в её эпилог: строка i
+ * результата C = P×V умножается на тот же 1/sum_i, а C [S, d] намного меньше
+ * P [S, S]. softmax_unnormalized пишет exp(x - max) и вектор масштабов
+ * строк; масштаб применяется либо в gemm(..., row_scale), либо по запросу
+ * функцией apply_row_scale.
+ */
+
+#ifndef SOFTMAX_LAZY_H
+#define SOFTMAX_LAZY_H
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+/**
+ * @brief exp(x - max) строки: максимум, затем проход суммы каркаса
+ * row_reduce.h с сохранением экспонент (ShiftedExpOp)
+ *
+ * В SIMD версии сумма попарная, хвост под маской; второе чтение строки
+ * обычно попадает в кэш.
+ *
+ * @return Масштаб строки 1 / Σ exp(x - max). Если все логиты равны -inf,
+ * как и в SoftmaxRow, получается равномерное распределение: exps = 1,
+ * масштаб 1/n.
+ */
+inline float SoftmaxRowUnnormalized(const float* row, float* exps,
+                                    std::size_t n, bool simd) {
+  const float max = RowMax(row, n, simd);
+  if (max == -std::numeric_limits<float>::infinity()) {
+    std::fill(exps, exps + n, 1.0f);
+    return 1.0f / n;
+  }
+
+  float sum_exp;
+  if (simd) {
+    RowReduceSimd(ShiftedExpOp<true>{max}, row, exps, n, &sum_exp);
+  } else {
+    RowReduce(ShiftedExpOp<true>{max}, row, exps, n, &sum_exp);
+  }
+  return 1.0f / sum_exp;
+}
+
+/**
+ * @brief Ненормализованный Softmax по последней оси
+ *
+ * @param exps exp(x - max) той же формы, что input
+ * @param row_scale Масштабы строк 1 / Σ exp(x - max), rows() значений в
+ * порядке строк тензора; softmax(x) = exps * row_scale
+ */
+inline void softmax_unnormalized(TensorView<const float> input,
+                                 TensorView<float> exps, float* row_scale,
+                                 SoftmaxMethod method,
+                                 DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = exps.shape;
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!in_shape.last_axis_contiguous() || !out_shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Softmax rows must be contiguous");
+  }
+  if (in_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  const std::size_t lead = in_shape.rank() - 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      row_scale[r] = SoftmaxRowUnnormalized(
+          input.data + in_shape.offset_of(r, lead),
+          exps.data + out_shape.offset_of(r, lead), cols, simd);
+    }
+  }
+}
+
+// Нормализация по запросу: values[r, :] *= row_scale[r]
+inline void apply_row_scale(TensorView<float> values, const float* row_scale,
+                            SoftmaxMethod method) {
+  const TensorShape& shape = values.shape;
+  if (!shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Softmax rows must be contiguous");
+  }
+  if (shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = shape.rows();
+  const std::size_t cols = shape.last_dim();
+  const std::size_t lead = shape.rank() - 1;
+
+#pragma omp parallel for if (parallel)
+  for (std::size_t r = 0; r < rows; ++r) {
+    float* row = values.data + shape.offset_of(r, lead);
+    const float scale = row_scale[r];
+    std::size_t j = 0;
+    if (simd) {
+      const NativeVec scale_vec = NativeVec::broadcast(scale);
+      for (; j + kVecLanes <= cols; j += kVecLanes) {
+        (NativeVec::load(row + j) * scale_vec).store(row + j);
+      }
+    }
+    for (; j < cols; ++j) row[j] *= scale;
+  }
+}
+
+#endif  // !SOFTMAX_LAZY_H
@@ -0,0 +1,261 @@
+/**
+ * @file softmax_loss.h
+ * @brief Log-softmax и Softmax + cross-entropy (потеря и градиент)
+ *
+ * В отличие от Softmax ядер из softmax_kernels.h здесь вычитается максимум
+ * строки: log-softmax и потеря требуют logsumexp без переполнения на
+ * произвольных логитах. Максимум, Σ exp(x - max) и сумма логитов
+ * считаются одним чтением строки (онлайн-состояние SoftmaxState: сумма
+ * домножается на exp(старый max - новый max), когда максимум растёт);
+ * второй проход (только если нужен результат размера строки) записывает
+ * log-softmax или градиент. Вместо четырёх проходов (Softmax, log, выборка
+ * метки, градиент) - один или два.
+ */
+
+#ifndef SOFTMAX_LOSS_H
+#define SOFTMAX_LOSS_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "softmax_state.h"
+#include "tensor.h"
+
+// Статистики строки логитов для log-softmax и потери
+struct LogitStats {
+  float max = 0.0f;  // максимум строки
+  float lse = 0.0f;  // log(sum(exp(x))), вычисленный через max
+  float sum = 0.0f;  // сумма логитов (для сглаживания меток)
+};
+
+// Статистики строки за одно чтение (скалярная версия); n > 0
+inline LogitStats LogitStatsRow(const float* row, std::size_t n) {
+  LogitStats stats;
+  SoftmaxState state;
+  for (std::size_t j = 0; j < n; ++j) {
+    state.append(row[j]);
+    stats.sum += row[j];
+  }
+  stats.max = state.max;
+  stats.lse = state.log_normalizer();
+  return stats;
+}
+
+// Статистики строки за одно чтение (векторизованная версия); n > 0.
+// Дорожки Softmax и Σ x копятся блоками по kPairwiseBlock векторов, блоки
+// складываются попарно, как суммы в row_reduce.h
+inline LogitStats LogitStatsRowSimd(const float* row, std::size_t n) {
+  using V = Vec<float, 8>;
+  PairwiseSum<SoftmaxLanes> lanes_pairwise;
+  PairwiseSum<V> sum_pairwise;
+  const std::size_t body = n / 8 * 8;
+  std::size_t i = 0;
+  // Блок начинает с максимумов предыдущего: иначе в начале каждого блока
+  // почти каждый вектор поднимает максимум и платит вторую экспоненту
+  __m256 running_max =
+      _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+  while (i < body) {
+    const std::size_t block_end = std::min(body, i + 8 * kPairwiseBlock);
+    SoftmaxLanes lanes;
+    lanes.max = running_max;
+    __m256 sum_vec = _mm256_setzero_ps();
+    for (; i < block_end; i += 8) {
+      const __m256 v = loadu256_ps(row + i);
+      lanes.append(v);
+      sum_vec = _mm256_add_ps(sum_vec, v);
+    }
+    running_max = lanes.max;
+    // Копии: адреса аккумуляторов блока не уходят в PairwiseSum
+    const SoftmaxLanes block_lanes = lanes;
+    const V block_sum{sum_vec};
+    lanes_pairwise.push(&block_lanes);
+    sum_pairwise.push(&block_sum);
+  }
+  SoftmaxLanes lanes;
+  lanes_pairwise.total(&lanes);
+  V sum_vec;
+  sum_pairwise.total(&sum_vec);
+
+  LogitStats stats;
+  SoftmaxState state = lanes.reduce(body);
+  stats.sum = hsum256_ps(sum_vec.v);
+  for (; i < n; ++i) {
+    state.append(row[i]);
+    stats.sum += row[i];
+  }
+  stats.max = state.max;
+  stats.lse = state.log_normalizer();
+  return stats;
+}
+
+// log-softmax строки: x - lse
+inline void LogSoftmaxRow(const float* row, float* result, std::size_t n,
+                          bool simd) {
+  if (n == 0) return;
+  const float lse = simd ? LogitStatsRowSimd(row, n).lse
+                         : LogitStatsRow(row, n).lse;
+  std::size_t i = 0;
+  if (simd) {
+    const __m256 lse_vec = _mm256_set1_ps(lse);
+    for (; i + 7 < n; i += 8) {
+      storeu256_ps(result + i,
+                   _mm256_sub_ps(loadu256_ps(row + i), lse_vec));
+    }
+  }
+  for (; i < n; ++i) {
+    result[i] = row[i] - lse;
+  }
+}
+
+/**
+ * @brief Градиент потери по логитам: softmax(x) - q
+ *
+ * q - целевое распределение со сглаживанием: (1 - smoothing) на метке
+ * target и smoothing / n равномерно по всем классам.
+ */
+inline void CrossEntropyGradRow(const float* row, float* grad, std::size_t n,
+                                const LogitStats& stats, std::size_t target,
+                                float smoothing, bool simd) {
+  const float uniform = smoothing / static_cast<float>(n);
+  std::size_t i = 0;
+  if (simd) {
+    const __m256 lse_vec = _mm256_set1_ps(stats.lse);
+    const __m256 uniform_vec = _mm256_set1_ps(uniform);
+    for (; i + 7 < n; i += 8) {
+      const __m256 p =
+          exp256_ps(_mm256_sub_ps(loadu256_ps(row + i), lse_vec));
+      storeu256_ps(grad + i, _mm256_sub_ps(p, uniform_vec));
+    }
+  }
+  for (; i < n; ++i) {
+    grad[i] = std::exp(row[i] - stats.lse) - uniform;
+  }
+  grad[target] -= 1.0f - smoothing;
+}
+
+/**
+ * @brief log-softmax по последней оси
+ *
+ * Строки должны быть непрерывны (шаг последней оси 1), ведущие оси - любые.
+ */
+inline void log_softmax(TensorView<const float> input,
+                        TensorView<float> output, SoftmaxMethod method,
+                        DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = output.shape;
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!in_shape.last_axis_contiguous() || !out_shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Log-softmax expects contiguous rows");
+  }
+  if (in_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  const std::size_t lead = in_shape.rank() - 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      LogSoftmaxRow(input.data + in_shape.offset_of(r, lead),
+                    output.data + out_shape.offset_of(r, lead), cols, simd);
+    }
+  }
+}
+
+/**
+ * @brief Softmax + cross-entropy по последней оси: потеря и градиент
+ *
+ * @param targets Метка класса для каждой строки (rows() элементов)
+ * @param smoothing Сглаживание меток, 0 - обычная cross-entropy
+ * @param losses Потеря каждой строки (rows() элементов) или nullptr
+ * @param grad Градиент по логитам той же формы или пустое представление:
+ * без градиента строка читается один раз и ничего размера строки не пишется
+ * @param order kReproducible - сумма потерь не зависит от числа потоков
+ * @return Средняя потеря по строкам
+ */
+inline float softmax_cross_entropy(
+    TensorView<const float> logits, const std::size_t* targets,
+    float smoothing, float* losses, TensorView<float> grad,
+    SoftmaxMethod method, DenormalMode mode = DenormalMode::kPreserve,
+    ReductionOrder order = ReductionOrder::kFast) {
+  const TensorShape& shape = logits.shape;
+  const bool with_grad = grad.data != nullptr;
+  if (with_grad && grad.shape.dims != shape.dims) {
+    throw std::invalid_argument("Logits and gradient shapes differ");
+  }
+  if (!shape.last_axis_contiguous() ||
+      (with_grad && !grad.shape.last_axis_contiguous())) {
+    throw std::invalid_argument("Cross-entropy expects contiguous rows");
+  }
+  if (smoothing < 0.0f || smoothing > 1.0f) {
+    throw std::invalid_argument("Label smoothing must be in [0, 1]");
+  }
+  const std::size_t rows = shape.rows();
+  const std::size_t cols = shape.last_dim();
+  if (shape.numel() == 0) return 0.0f;
+  for (std::size_t r = 0; r < rows; ++r) {
+    if (targets[r] >= cols) {
+      throw std::out_of_range("Target class is out of range");
+    }
+  }
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t lead = shape.rank() - 1;
+  const float uniform = smoothing / static_cast<float>(cols);
+  double total = 0.0;
+  // Воспроизводимо: потери строк сохраняются и суммируются по порядку строк
+  const bool reproducible = order == ReductionOrder::kReproducible;
+  std::vector<float> scratch;
+  float* row_losses = losses;
+  if (reproducible && row_losses == nullptr) {
+    scratch.resize(rows);
+    row_losses = scratch.data();
+  }
+
+#pragma omp parallel if (parallel) reduction(+ : total)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float* row = logits.data + shape.offset_of(r, lead);
+      const LogitStats stats =
+          simd ? LogitStatsRowSimd(row, cols) : LogitStatsRow(row, cols);
+      // -log q·p = lse - (1 - s) x[t] - s/n sum(x)
+      const float loss = stats.lse - (1.0f - smoothing) * row[targets[r]] -
+                         uniform * stats.sum;
+      if (row_losses != nullptr) row_losses[r] = loss;
+      if (!reproducible) total += loss;
+      if (with_grad) {
+        CrossEntropyGradRow(row, grad.data + grad.shape.offset_of(r, lead),
+                            cols, stats, targets[r], smoothing, simd);
+      }
+    }
+  }
+  if (reproducible) {
+    for (std::size_t r = 0; r < rows; ++r) total += row_losses[r];
+  }
+  return static_cast<float>(total / static_cast<double>(rows));
+}
+
+#endif  // !SOFTMAX_LOSS_H
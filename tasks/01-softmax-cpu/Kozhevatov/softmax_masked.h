@@ -0,0 +1,147 @@
+/**
+ * @file softmax_masked.h
+ * @brief Softmax со встроенной структурной маской (causal, окно, длина)
+ *
+ * Вместо записи -inf в замаскированные позиции и полного Softmax по строке
+ * ядро получает описание маски, считает Softmax только по допустимому
+ * диапазону [lo, hi) строки, а остальное заполняет нулями потоковыми
+ * записями (в обход кэша). Для causal маски это примерно половина работы.
+ */
+
+#ifndef SOFTMAX_MASKED_H
+#define SOFTMAX_MASKED_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Вид структурной маски
+enum class MaskKind {
+  kNone,           // без маски
+  kCausal,         // строка q видит столбцы j <= q
+  kSlidingWindow,  // строка q видит столбцы q - window < j <= q
+  kValidLength,    // строка r видит столбцы j < valid_lengths[r]
+};
+
+/**
+ * @brief Описание маски для Softmax по последней оси
+ *
+ * Для kCausal и kSlidingWindow номер запроса q - индекс строки по
+ * предпоследней оси (внутри одной матрицы внимания). Для kValidLength длины
+ * задаются на каждую строку тензора в порядке обхода (rows() элементов).
+ * Полностью замаскированная строка заполняется нулями.
+ */
+struct SoftmaxMask {
+  MaskKind kind = MaskKind::kNone;
+  std::size_t window = 0;
+  const std::size_t* valid_lengths = nullptr;
+
+  static SoftmaxMask causal() { return {MaskKind::kCausal, 0, nullptr}; }
+  static SoftmaxMask sliding_window(std::size_t window) {
+    return {MaskKind::kSlidingWindow, window, nullptr};
+  }
+  static SoftmaxMask valid_length(const std::size_t* lengths) {
+    return {MaskKind::kValidLength, 0, lengths};
+  }
+
+  // Допустимый диапазон столбцов [lo, hi) строки row с номером запроса q
+  void range(std::size_t row, std::size_t q, std::size_t cols,
+             std::size_t& lo, std::size_t& hi) const {
+    lo = 0;
+    hi = cols;
+    switch (kind) {
+      case MaskKind::kNone:
+        break;
+      case MaskKind::kCausal:
+        hi = std::min(cols, q + 1);
+        break;
+      case MaskKind::kSlidingWindow:
+        hi = std::min(cols, q + 1);
+        lo = q + 1 > window ? std::min(hi, q + 1 - window) : 0;
+        break;
+      case MaskKind::kValidLength:
+        hi = std::min(cols, valid_lengths[row]);
+        break;
+    }
+  }
+};
+
+// Заполнение нулями: невыровненное начало обычными записями, основная часть
+// потоковыми (_mm256_stream_ps), чтобы не вытеснять полезные данные из кэша
+inline void zero_fill_stream(float* dst, std::size_t count) {
+  std::size_t i = 0;
+  while (i < count && (reinterpret_cast<std::uintptr_t>(dst + i) & 31) != 0) {
+    dst[i++] = 0.0f;
+  }
+  const __m256 zero = _mm256_setzero_ps();
+  for (; i + 8 <= count; i += 8) {
+    _mm256_stream_ps(dst + i, zero);
+  }
+  for (; i < count; ++i) {
+    dst[i] = 0.0f;
+  }
+}
+
+/**
+ * @brief Softmax по последней оси с маской
+ *
+ * Строки должны быть непрерывны (шаг последней оси 1), ведущие оси - любые.
+ * Стоимость строки пропорциональна длине допустимого диапазона, поэтому
+ * строки раздаются потокам по одной (static, 1): треугольник causal маски
+ * делится между потоками поровну.
+ */
+inline void softmax_masked(TensorView<const float> input,
+                           TensorView<float> output, const SoftmaxMask& mask,
+                           SoftmaxMethod method,
+                           DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = output.shape;
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!in_shape.last_axis_contiguous() || !out_shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Masked softmax expects contiguous rows");
+  }
+  if (mask.kind == MaskKind::kValidLength && mask.valid_lengths == nullptr) {
+    throw std::invalid_argument("Valid-length mask requires lengths");
+  }
+  if (in_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const auto row_kernel = simd ? SoftmaxRowSimd : SoftmaxRow;
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  const std::size_t lead = in_shape.rank() - 1;
+  const std::size_t queries = lead > 0 ? in_shape.dims[lead - 1] : 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for schedule(static, 1)
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float* src = input.data + in_shape.offset_of(r, lead);
+      float* dst = output.data + out_shape.offset_of(r, lead);
+      std::size_t lo = 0, hi = cols;
+      mask.range(r, r % queries, cols, lo, hi);
+
+      zero_fill_stream(dst, lo);
+      if (lo < hi) row_kernel(src + lo, dst + lo, hi - lo);
+      zero_fill_stream(dst + hi, cols - hi);
+    }
+    // Потоковые записи слабо упорядочены: делаем их видимыми до выхода
+    _mm_sfence();
+  }
+}
+
+#endif  // !SOFTMAX_MASKED_H
@@ -0,0 +1,251 @@
+/**
+ * @file softmax_prologue.h
+ * @brief Пролог Softmax: масштаб, смещения, ALiBi и температура в одном проходе
+ *
+ * Цепочка "x / sqrt(d) + bias + alibi, затем / T" обычно выполняется
+ * отдельными проходами по матрице. Здесь она задаётся композицией функторов
+ * на этапе компиляции и применяется к каждому вектору сразу после загрузки
+ * в проходе суммы Softmax - вся цепочка стоит одного чтения матрицы.
+ * Softmax с прологом - операция каркаса row_reduce.h (SoftmaxPrologueOp):
+ * векторный путь, хвост под маской и попарная сумма - общие.
+ *
+ * Каждый функтор пролога предоставляет at_row(row): привязку к строке, в
+ * которой вычисляются построчные параметры (один раз на строку), и которая
+ * применяется к вектору Vec<float, W> со столбцами RowLanes<W> или к
+ * скаляру со столбцом col.
+ */
+
+#ifndef SOFTMAX_PROLOGUE_H
+#define SOFTMAX_PROLOGUE_H
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+namespace prologue {
+
+// x * scale для всего тензора (1/sqrt(d) или 1/T)
+struct Scale {
+  float scale;
+
+  struct Row {
+    float value;
+    template <std::size_t W>
+    Vec<float, W> operator()(Vec<float, W> x, const RowLanes<W>&) const {
+      return x * Vec<float, W>::broadcast(value);
+    }
+    float operator()(float x, std::size_t) const { return x * value; }
+  };
+  Row at_row(std::size_t) const { return {scale}; }
+};
+
+// Температура семплирования: x / T
+inline Scale Temperature(float temperature) { return {1.0f / temperature}; }
+
+// x * scales[row]
+struct RowScale {
+  const float* scales;
+
+  Scale::Row at_row(std::size_t row) const { return {scales[row]}; }
+};
+
+// x + bias для всего тензора
+struct Bias {
+  float bias;
+
+  struct Row {
+    float value;
+    template <std::size_t W>
+    Vec<float, W> operator()(Vec<float, W> x, const RowLanes<W>&) const {
+      return x + Vec<float, W>::broadcast(value);
+    }
+    float operator()(float x, std::size_t) const { return x + value; }
+  };
+  Row at_row(std::size_t) const { return {bias}; }
+};
+
+// x + biases[row]
+struct RowBias {
+  const float* biases;
+
+  Bias::Row at_row(std::size_t row) const { return {biases[row]}; }
+};
+
+// x + biases[col]: вектор смещений по столбцам (например, по ключам)
+struct ColumnBias {
+  const float* biases;
+
+  struct Row {
+    const float* biases;
+    template <std::size_t W>
+    Vec<float, W> operator()(Vec<float, W> x,
+                             const RowLanes<W>& lanes) const {
+      return x + lanes.load(biases);
+    }
+    float operator()(float x, std::size_t col) const {
+      return x + biases[col];
+    }
+  };
+  Row at_row(std::size_t) const { return {biases}; }
+};
+
+// x + bias[row, col]: полная матрица смещений с шагом строки row_stride
+// (строки матрицы смещений повторяются с периодом rows)
+struct MatrixBias {
+  const float* bias;
+  std::size_t rows;
+  std::size_t row_stride;
+
+  ColumnBias::Row at_row(std::size_t row) const {
+    return {bias + (row % rows) * row_stride};
+  }
+};
+
+/**
+ * @brief ALiBi: x + slope[head] * (col - q)
+ *
+ * Строка row тензора [H, S_q, S_k] (или [B, H, S_q, S_k]) соответствует
+ * запросу q = row % queries и голове (row / queries) % heads.
+ */
+struct Alibi {
+  const float* slopes;
+  std::size_t queries;
+  std::size_t heads;
+
+  struct Row {
+    float slope;
+    float offset;  // -slope * q
+    template <std::size_t W>
+    Vec<float, W> operator()(Vec<float, W> x,
+                             const RowLanes<W>& lanes) const {
+      using V = Vec<float, W>;
+      return x + V::broadcast(slope) * lanes.columns() + V::broadcast(offset);
+    }
+    float operator()(float x, std::size_t col) const {
+      return x + slope * static_cast<float>(col) + offset;
+    }
+  };
+  Row at_row(std::size_t row) const {
+    const float slope = slopes[(row / queries) % heads];
+    const float q = static_cast<float>(row % queries);
+    return {slope, -slope * q};
+  }
+};
+
+// Композиция функторов: применяются слева направо
+template <typename... Ops>
+struct Chain {
+  std::tuple<Ops...> ops;
+
+  struct Row {
+    std::tuple<decltype(std::declval<const Ops&>().at_row(0))...> ops;
+
+    template <typename T, typename Column>
+    T operator()(T x, const Column& col) const {
+      return std::apply(
+          [&](const auto&... op) {
+            ((x = op(x, col)), ...);
+            return x;
+          },
+          ops);
+    }
+  };
+  Row at_row(std::size_t row) const {
+    return std::apply(
+        [row](const auto&... op) { return Row{{op.at_row(row)...}}; }, ops);
+  }
+};
+
+}  // namespace prologue
+
+// Пролог из нескольких функторов, например
+// make_prologue(Scale{1/sqrt(d)}, ColumnBias{b}, Alibi{...}, Temperature(T))
+template <typename... Ops>
+prologue::Chain<Ops...> make_prologue(Ops... ops) {
+  return {{ops...}};
+}
+
+/**
+ * @brief Softmax с прологом как операция каркаса row_reduce.h
+ *
+ * reduce применяет пролог строки к загруженному вектору до экспоненты;
+ * исходные данные не изменяются и второй раз не читаются. Свёртка и map -
+ * как у SoftmaxOp.
+ */
+template <typename RowPrologue>
+struct SoftmaxPrologueOp : SoftmaxOp {
+  RowPrologue prologue;
+
+  explicit SoftmaxPrologueOp(const RowPrologue& row_prologue)
+      : prologue(row_prologue) {}
+
+  SoftmaxPrologueOp at_row(const float*, std::size_t) const { return *this; }
+
+  template <std::size_t W>
+  void reduce(Vec<float, W> x, const RowLanes<W>& lanes,
+              Vec<float, W>* terms) const {
+    terms[0] = vexp(prologue(x, lanes));
+  }
+  void reduce(float x, std::size_t j, float* terms) const {
+    terms[0] = std::exp(prologue(x, j));
+  }
+};
+
+/**
+ * @brief Softmax по последней оси с прологом
+ *
+ * @param prologue Функтор пролога или композиция make_prologue(...); номер
+ * строки для построчных параметров - индекс строки в порядке обхода rows().
+ */
+template <typename Prologue>
+inline void softmax_prologue(TensorView<const float> input,
+                             TensorView<float> output,
+                             const Prologue& prologue, SoftmaxMethod method,
+                             DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = output.shape;
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!in_shape.last_axis_contiguous() || !out_shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Prologue softmax expects contiguous rows");
+  }
+  if (in_shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  const std::size_t lead = in_shape.rank() - 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float* src = input.data + in_shape.offset_of(r, lead);
+      float* dst = output.data + out_shape.offset_of(r, lead);
+      const SoftmaxPrologueOp op(prologue.at_row(r));
+      if (simd) {
+        RowReduceMapSimd(op, src, dst, cols);
+      } else {
+        RowReduceMap(op, src, dst, cols);
+      }
+    }
+  }
+}
+
+#endif  // !SOFTMAX_PROLOGUE_H
@@ -0,0 +1,280 @@
+/**
+ * @file softmax_quantized.h
+ * @brief Softmax над квантованными логитами int8/int32 с табличной экспонентой
+ *
+ * Логит задаётся целым q и общим для тензора масштабом: x = scale * q.
+ * Вместо деквантования матрицы во float максимум строки ищется в целых
+ * числах, а exp(x - max) = exp(-scale * (max - q)) зависит только от целой
+ * разности d = max - q. Для int8 d лежит в [0, 255], и экспонента - одна
+ * выборка из таблицы на 256 значений (vgatherdps). Для int32 разность
+ * раскладывается на байты: exp(-s*d) = T_hi[d >> 8] * T_lo[d & 255].
+ *
+ * Выход - вероятности во float, fp16 или uint8 (p * 255 с округлением).
+ */
+
+#ifndef SOFTMAX_QUANTIZED_H
+#define SOFTMAX_QUANTIZED_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_half.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Масштаб uint8 вероятностей: p = q / 255
+constexpr float kUInt8ProbScale = 255.0f;
+
+// Разность d = max - q, начиная с которой int32 путь считает exp(-s*d) = 0
+constexpr std::uint32_t kQuantizedMaxDiff = 0xFFFF;
+
+/**
+ * @brief Таблицы exp(-scale * d) для квантованных логитов
+ *
+ * lo[d] = exp(-scale * d) и hi[h] = exp(-scale * 256 * h), d, h < 256.
+ * Для int8 достаточно lo; int32 использует обе, если exp(-scale * 65535)
+ * уже равен нулю во float. Иначе (очень мелкий масштаб) отбрасывать
+ * разности больше 65535 нельзя, и int32 путь считает exp полиномом.
+ */
+struct QuantizedExpTables {
+  std::array<float, 256> lo;
+  std::array<float, 256> hi;
+  float scale;
+  bool exact_int32;
+
+  explicit QuantizedExpTables(float scale_) : scale(scale_) {
+    for (std::size_t d = 0; d < 256; ++d) {
+      lo[d] = static_cast<float>(std::exp(-double(scale) * double(d)));
+      hi[d] = static_cast<float>(std::exp(-double(scale) * 256.0 * double(d)));
+    }
+    exact_int32 = std::exp(-double(scale) * kQuantizedMaxDiff) <
+                  std::numeric_limits<float>::denorm_min();
+  }
+};
+
+// Сохранение 8 (и одной) вероятностей в тип выхода
+template <typename Out>
+struct ProbabilityStore {
+  static void store(Out* dst, __m256 p) { StorageTraits<Out>::store(dst, p); }
+  static Out from_float(float p) { return StorageTraits<Out>::from_float(p); }
+};
+
+template <>
+struct ProbabilityStore<std::uint8_t> {
+  static void store(std::uint8_t* dst, __m256 p) {
+    const __m256i q = _mm256_cvtps_epi32(
+        _mm256_mul_ps(p, _mm256_set1_ps(kUInt8ProbScale)));
+    // 8 x i32 -> 8 x u8 с насыщением
+    const __m128i q16 = _mm_packus_epi32(_mm256_castsi256_si128(q),
+                                         _mm256_extracti128_si256(q, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst),
+                     _mm_packus_epi16(q16, q16));
+  }
+  static std::uint8_t from_float(float p) {
+    return static_cast<std::uint8_t>(
+        std::clamp(std::nearbyint(p * kUInt8ProbScale), 0.0f, 255.0f));
+  }
+};
+
+// Максимум строки в целых числах
+inline std::int32_t QuantizedRowMax(const std::int8_t* row, std::size_t n,
+                                    bool simd) {
+  std::int32_t max = std::numeric_limits<std::int8_t>::min();
+  std::size_t i = 0;
+  if (simd && n >= 32) {
+    __m256i max_vec = _mm256_set1_epi8(std::numeric_limits<std::int8_t>::min());
+    for (; i + 31 < n; i += 32) {
+      max_vec = _mm256_max_epi8(
+          max_vec,
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+    }
+    alignas(32) std::int8_t lanes[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), max_vec);
+    max = *std::max_element(lanes, lanes + 32);
+  }
+  for (; i < n; ++i) max = std::max<std::int32_t>(max, row[i]);
+  return max;
+}
+
+inline std::int32_t QuantizedRowMax(const std::int32_t* row, std::size_t n,
+                                    bool simd) {
+  std::int32_t max = std::numeric_limits<std::int32_t>::min();
+  std::size_t i = 0;
+  if (simd && n >= 8) {
+    __m256i max_vec = _mm256_set1_epi32(max);
+    for (; i + 7 < n; i += 8) {
+      max_vec = _mm256_max_epi32(
+          max_vec,
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+    }
+    alignas(32) std::int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), max_vec);
+    max = *std::max_element(lanes, lanes + 8);
+  }
+  for (; i < n; ++i) max = std::max(max, row[i]);
+  return max;
+}
+
+// Разность max - q как беззнаковое целое (точна при любых int32)
+inline std::uint32_t quantized_diff(std::int32_t max, std::int32_t q) {
+  return static_cast<std::uint32_t>(max) - static_cast<std::uint32_t>(q);
+}
+
+// exp(-scale * (max - q)) одного элемента
+inline float quantized_exp(std::int8_t q, std::int32_t max,
+                           const QuantizedExpTables& tables) {
+  return tables.lo[quantized_diff(max, q)];
+}
+
+inline float quantized_exp(std::int32_t q, std::int32_t max,
+                           const QuantizedExpTables& tables) {
+  const std::uint32_t d = quantized_diff(max, q);
+  if (!tables.exact_int32) {
+    return std::exp(-tables.scale * static_cast<float>(d));
+  }
+  if (d > kQuantizedMaxDiff) return 0.0f;
+  return tables.hi[d >> 8] * tables.lo[d & 255];
+}
+
+// exp 8 элементов: разность в целых числах, выборка из таблиц
+inline __m256 quantized_exp8(const std::int8_t* src, __m256i max,
+                             const QuantizedExpTables& tables) {
+  const __m256i q = _mm256_cvtepi8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+  return _mm256_i32gather_ps(tables.lo.data(), _mm256_sub_epi32(max, q), 4);
+}
+
+inline __m256 quantized_exp8(const std::int32_t* src, __m256i max,
+                             const QuantizedExpTables& tables) {
+  const __m256i d = _mm256_sub_epi32(
+      max, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+  if (!tables.exact_int32) {
+    // Беззнаковая разность до 2^32 - 1: старший бит складывается отдельно
+    const __m256 hi_bit = _mm256_castsi256_ps(
+        _mm256_and_si256(_mm256_srai_epi32(d, 31),
+                         _mm256_castps_si256(_mm256_set1_ps(2147483648.0f))));
+    const __m256 diff = _mm256_add_ps(
+        _mm256_cvtepi32_ps(_mm256_and_si256(d, _mm256_set1_epi32(0x7FFFFFFF))),
+        hi_bit);
+    return exp256_ps(_mm256_mul_ps(diff, _mm256_set1_ps(-tables.scale)));
+  }
+  const __m256i clamped =
+      _mm256_min_epu32(d, _mm256_set1_epi32(kQuantizedMaxDiff + 1));
+  const __m256i overflow =
+      _mm256_cmpeq_epi32(clamped, _mm256_set1_epi32(kQuantizedMaxDiff + 1));
+  const __m256 hi = _mm256_i32gather_ps(
+      tables.hi.data(),
+      _mm256_and_si256(_mm256_srli_epi32(clamped, 8), _mm256_set1_epi32(255)),
+      4);
+  const __m256 lo = _mm256_i32gather_ps(
+      tables.lo.data(), _mm256_and_si256(clamped, _mm256_set1_epi32(255)), 4);
+  return _mm256_andnot_ps(_mm256_castsi256_ps(overflow),
+                          _mm256_mul_ps(hi, lo));
+}
+
+/**
+ * @brief Softmax строки квантованных логитов
+ *
+ * Экспоненты сохраняются в строку-буфер потока scratch (n float), затем
+ * нормализуются и записываются в тип выхода. Строка содержит максимум,
+ * поэтому сумма экспонент не меньше 1 и защита от нуля не нужна. В SIMD
+ * версии сумма попарная, с хвостом под маской (RowSumStoredSimd).
+ */
+template <typename In, typename Out>
+inline void SoftmaxRowQuantized(const In* row, Out* result, std::size_t n,
+                                const QuantizedExpTables& tables,
+                                float* scratch, bool simd) {
+  if (n == 0) return;
+  const std::int32_t max = QuantizedRowMax(row, n, simd);
+
+  float sum_exp = 0.0f;
+  if (simd) {
+    using V = Vec<float, 8>;
+    const __m256i max_vec = _mm256_set1_epi32(max);
+    const auto exp_at = [&](std::size_t j, std::size_t count) {
+      if (count == 8) return V{quantized_exp8(row + j, max_vec, tables)};
+      // Хвост - через буфер, дополненный максимумом: индексы таблиц
+      // остаются в границах, лишние дорожки обнуляет каркас
+      In tail[8];
+      std::fill(tail, tail + 8, static_cast<In>(max));
+      std::copy(row + j, row + j + count, tail);
+      return V{quantized_exp8(tail, max_vec, tables)};
+    };
+    sum_exp = RowSumStoredSimd<8>(n, scratch, exp_at);
+  } else {
+    for (std::size_t j = 0; j < n; ++j) {
+      scratch[j] = quantized_exp(row[j], max, tables);
+      sum_exp += scratch[j];
+    }
+  }
+
+  const float inv_sum = 1.0f / sum_exp;
+  std::size_t i = 0;
+  if (simd) {
+    const __m256 inv_vec = _mm256_set1_ps(inv_sum);
+    for (; i + 7 < n; i += 8) {
+      ProbabilityStore<Out>::store(
+          result + i, _mm256_mul_ps(loadu256_ps(scratch + i), inv_vec));
+    }
+  }
+  for (; i < n; ++i) {
+    result[i] = ProbabilityStore<Out>::from_float(scratch[i] * inv_sum);
+  }
+}
+
+/**
+ * @brief Softmax по последней оси квантованного тензора
+ *
+ * @param logits Логиты int8 или int32; значение логита - scale * q
+ * @param scale Масштаб квантования (> 0)
+ * @param probs Вероятности float, Half или uint8 (p * 255)
+ */
+template <typename In, typename Out>
+inline void softmax_quantized(TensorView<const In> logits, float scale,
+                              TensorView<Out> probs, SoftmaxMethod method) {
+  static_assert(std::is_same_v<In, std::int8_t> ||
+                    std::is_same_v<In, std::int32_t>,
+                "Quantized logits must be int8 or int32");
+  if (logits.shape.dims != probs.shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!(scale > 0.0f)) {
+    throw std::invalid_argument("Quantization scale must be positive");
+  }
+  if (logits.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = logits.shape.rows();
+  const std::size_t cols = logits.shape.last_dim();
+  const std::size_t in_rs = logits.shape.row_stride();
+  const std::size_t out_rs = probs.shape.row_stride();
+  const QuantizedExpTables tables(scale);
+
+#pragma omp parallel if (parallel)
+  {
+    std::vector<float> scratch(cols);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      SoftmaxRowQuantized(logits.data + r * in_rs, probs.data + r * out_rs,
+                          cols, tables, scratch.data(), simd);
+    }
+  }
+}
+
+#endif  // !SOFTMAX_QUANTIZED_H
@@ -0,0 +1,455 @@
+/**
+ * @file softmax_sampling.h
+ * @brief Потребители Softmax без полной нормализации: top-k и сэмплирование
+ *
+ * Если за Softmax следует argmax, top-k или выбор токена, вектор из n
+ * вероятностей не нужен. Оба ядра читают строку логитов один раз и не пишут
+ * ничего размера n:
+ *  - softmax_topk отбирает k наибольших логитов (векторное сравнение с
+ *    текущим порогом, кандидаты - в кучу размера k) и считает Softmax только
+ *    по ним;
+ *  - sample_softmax выбирает индекс argmax(x / T + g), g = -log(-log(u)) -
+ *    шум Гумбеля; это точная выборка из softmax(x / T). u берутся из
+ *    Philox4x32-10 по ключу (seed, строка, столбец). Второй способ -
+ *    обратная функция распределения по суммам блоков строки, после которой
+ *    повторно читается только один блок.
+ */
+
+#ifndef SOFTMAX_SAMPLING_H
+#define SOFTMAX_SAMPLING_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "philox.h"
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Поток Philox для сэмплирования (другие потребители берут свои номера)
+constexpr std::uint32_t kSamplingStream = 1;
+
+// Кандидат top-k: значение логита и его столбец
+struct TopKEntry {
+  float value;
+  std::int32_t index;
+};
+
+// Порядок top-k: большее значение раньше, при равенстве - меньший индекс
+inline bool topk_before(const TopKEntry& a, const TopKEntry& b) {
+  return a.value > b.value || (a.value == b.value && a.index < b.index);
+}
+
+/**
+ * @brief Отбор k наибольших логитов строки
+ *
+ * heap - куча размера k с худшим кандидатом на вершине. Логит, не больший
+ * вершины, отбрасывается одним сравнением; в SIMD версии 8 логитов
+ * сравниваются с порогом сразу, и в кучу идут только биты маски. NaN не
+ * отбираются. Результат отсортирован в порядке topk_before.
+ */
+inline void TopKRow(const float* row, std::size_t n, std::size_t k,
+                    std::vector<TopKEntry>& heap, bool simd) {
+  heap.clear();
+  float threshold = -std::numeric_limits<float>::infinity();
+  const auto consider = [&](float value, std::size_t j) {
+    const TopKEntry entry{value, static_cast<std::int32_t>(j)};
+    if (heap.size() < k) {
+      heap.push_back(entry);
+      std::push_heap(heap.begin(), heap.end(), topk_before);
+    } else {
+      std::pop_heap(heap.begin(), heap.end(), topk_before);
+      heap.back() = entry;
+      std::push_heap(heap.begin(), heap.end(), topk_before);
+    }
+    if (heap.size() == k) threshold = heap.front().value;
+  };
+
+  std::size_t i = 0;
+  if (simd) {
+    // Пока куча не заполнена, принимается всё, кроме NaN
+    for (; i < n && heap.size() < k; ++i) {
+      if (!(row[i] != row[i])) consider(row[i], i);
+    }
+    for (; i + 7 < n; i += 8) {
+      const int mask = _mm256_movemask_ps(_mm256_cmp_ps(
+          loadu256_ps(row + i), _mm256_set1_ps(threshold), _CMP_GT_OQ));
+      if (mask == 0) continue;
+      for (std::size_t lane = 0; lane < 8; ++lane) {
+        // Порог мог вырасти после предыдущего бита этой же маски
+        if (((mask >> lane) & 1) != 0 && row[i + lane] > threshold) {
+          consider(row[i + lane], i + lane);
+        }
+      }
+    }
+  }
+  for (; i < n; ++i) {
+    if (heap.size() < k ? !(row[i] != row[i]) : row[i] > threshold) {
+      consider(row[i], i);
+    }
+  }
+  std::sort(heap.begin(), heap.end(), topk_before);
+}
+
+/**
+ * @brief Top-k по последней оси и Softmax по отобранным логитам
+ *
+ * @param indices Столбцы k наибольших логитов, форма [..., k]
+ * @param probs Softmax по k отобранным логитам, форма [..., k]
+ * Если в строке меньше k логитов, не равных NaN, хвост заполняется
+ * индексом -1 и нулевой вероятностью.
+ */
+inline void softmax_topk(TensorView<const float> logits, std::size_t k,
+                         TensorView<std::int32_t> indices,
+                         TensorView<float> probs, SoftmaxMethod method) {
+  const TensorShape& shape = logits.shape;
+  std::vector<std::size_t> out_dims = shape.dims;
+  if (!out_dims.empty()) out_dims.back() = k;
+  if (indices.shape.dims != out_dims || probs.shape.dims != out_dims) {
+    throw std::invalid_argument("Top-k outputs must have shape [..., k]");
+  }
+  if (k == 0 || k > shape.last_dim()) {
+    throw std::invalid_argument("k must be in [1, row length]");
+  }
+  if (shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t rows = shape.rows();
+  const std::size_t cols = shape.last_dim();
+  const std::size_t in_rs = shape.row_stride();
+  const std::size_t idx_rs = indices.shape.row_stride();
+  const std::size_t prob_rs = probs.shape.row_stride();
+
+#pragma omp parallel if (parallel)
+  {
+    std::vector<TopKEntry> heap;
+    heap.reserve(k);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      TopKRow(logits.data + r * in_rs, cols, k, heap, simd);
+      std::int32_t* idx = indices.data + r * idx_rs;
+      float* p = probs.data + r * prob_rs;
+
+      float sum_exp = 0.0f;
+      for (std::size_t j = 0; j < heap.size(); ++j) {
+        p[j] = std::exp(heap[j].value - heap.front().value);
+        sum_exp += p[j];
+      }
+      for (std::size_t j = 0; j < heap.size(); ++j) {
+        idx[j] = heap[j].index;
+        p[j] /= sum_exp;
+      }
+      for (std::size_t j = heap.size(); j < k; ++j) {
+        idx[j] = -1;
+        p[j] = 0.0f;
+      }
+    }
+  }
+}
+
+// Верхняя граница шума Гумбеля: u <= 1 - 2^-24, -log(-log(u)) < 16.7
+constexpr float kGumbelNoiseMax = 17.0f;
+
+// Столбцов в блоке однопроходной обратной функции распределения
+constexpr std::size_t kCdfBlockCols = 256;
+
+// Argmax строки с шумом Гумбеля (скалярная версия)
+inline std::int32_t GumbelArgmaxRow(const float* row, std::size_t n,
+                                    float inv_temperature, std::uint64_t seed,
+                                    std::uint64_t row_id) {
+  float best = -std::numeric_limits<float>::infinity();
+  std::int32_t best_index = -1;
+  std::uint32_t bits[kPhiloxBlockCols];
+  for (std::size_t base = 0; base < n; base += kPhiloxBlockCols) {
+    const std::size_t end = std::min(n, base + kPhiloxBlockCols);
+    float block_max = -std::numeric_limits<float>::infinity();
+    for (std::size_t c = base; c < end; ++c) {
+      block_max = std::max(block_max, row[c]);
+    }
+    // Шум ограничен сверху: блок, который не может победить, пропускается
+    if (block_max * inv_temperature + kGumbelNoiseMax <= best) continue;
+
+    philox_block(seed, kSamplingStream, row_id, base / kPhiloxBlockCols,
+                 bits);
+    for (std::size_t c = base; c < end; ++c) {
+      const float u = bits_to_open_unit(bits[c - base]);
+      const float score = row[c] * inv_temperature - std::log(-std::log(u));
+      if (score > best) {
+        best = score;
+        best_index = static_cast<std::int32_t>(c);
+      }
+    }
+  }
+  return best_index;
+}
+
+/**
+ * @brief Argmax строки с шумом Гумбеля (векторизованная версия)
+ *
+ * Один вызов Philox даёт шум для 32 столбцов; лучшее значение и его индекс
+ * ведутся по дорожкам и сводятся в конце (при равенстве - меньший индекс).
+ * Шум не превосходит kGumbelNoiseMax, поэтому для блока, максимум которого
+ * даже с этим шумом не больше текущего лучшего значения, генератор и
+ * логарифмы не вычисляются: при типичном для словаря разбросе логитов это
+ * почти все блоки. Пропуск точен - выбор от него не меняется. Логарифм
+ * считается полиномом log256_ps, поэтому при почти равных значениях выбор
+ * может отличаться от скалярной версии.
+ */
+inline std::int32_t GumbelArgmaxRowSimd(const float* row, std::size_t n,
+                                        float inv_temperature,
+                                        std::uint64_t seed,
+                                        std::uint64_t row_id) {
+  const __m256 inv_t = _mm256_set1_ps(inv_temperature);
+  const __m256i lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256 best_vec = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+  __m256i best_idx = _mm256_set1_epi32(-1);
+  float best = -std::numeric_limits<float>::infinity();
+  std::int32_t best_index = -1;
+  // Нижняя оценка лучшего значения по всем дорожкам для отсечения блоков
+  float bound = -std::numeric_limits<float>::infinity();
+
+  for (std::size_t base = 0; base < n; base += kPhiloxBlockCols) {
+    if (base + kPhiloxBlockCols <= n) {
+      const __m256 block_max = _mm256_max_ps(
+          _mm256_max_ps(loadu256_ps(row + base), loadu256_ps(row + base + 8)),
+          _mm256_max_ps(loadu256_ps(row + base + 16),
+                        loadu256_ps(row + base + 24)));
+      if (hmax256_ps(block_max) * inv_temperature + kGumbelNoiseMax <= bound) {
+        continue;
+      }
+    }
+
+    __m256i bits[4];
+    philox_block_avx2(seed, kSamplingStream, row_id, base / kPhiloxBlockCols,
+                      bits);
+    for (std::size_t j = 0; j < 4; ++j) {
+      const std::size_t c = base + j * 8;
+      if (c >= n) break;
+      // g = -log(-log(u))
+      const __m256 u = bits_to_open_unit_ps(bits[j]);
+      const __m256 gumbel = _mm256_sub_ps(
+          _mm256_setzero_ps(),
+          log256_ps(_mm256_sub_ps(_mm256_setzero_ps(), log256_ps(u))));
+      if (c + 8 <= n) {
+        const __m256 score = _mm256_add_ps(
+            _mm256_mul_ps(loadu256_ps(row + c), inv_t), gumbel);
+        const __m256 better = _mm256_cmp_ps(score, best_vec, _CMP_GT_OQ);
+        best_vec = _mm256_blendv_ps(best_vec, score, better);
+        best_idx = _mm256_castps_si256(_mm256_blendv_ps(
+            _mm256_castsi256_ps(best_idx),
+            _mm256_castsi256_ps(_mm256_add_epi32(
+                _mm256_set1_epi32(static_cast<int>(c)), lane_ids)),
+            better));
+        continue;
+      }
+      // Хвост строки: шум уже посчитан, логиты - поэлементно
+      alignas(32) float noise[8];
+      _mm256_store_ps(noise, gumbel);
+      for (std::size_t t = c; t < n; ++t) {
+        const float score = row[t] * inv_temperature + noise[t - c];
+        if (score > best) {
+          best = score;
+          best_index = static_cast<std::int32_t>(t);
+        }
+      }
+    }
+    bound = hmax256_ps(best_vec);
+  }
+
+  alignas(32) float values[8];
+  alignas(32) std::int32_t index[8];
+  _mm256_store_ps(values, best_vec);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(index), best_idx);
+  for (int lane = 0; lane < 8; ++lane) {
+    if (index[lane] < 0) continue;
+    if (values[lane] > best ||
+        (values[lane] == best && index[lane] < best_index)) {
+      best = values[lane];
+      best_index = index[lane];
+    }
+  }
+  return best_index;
+}
+
+// Максимум и сумма exp(x / T - max) блока логитов; NaN пропускаются
+inline void CdfBlockStats(const float* block, std::size_t n,
+                          float inv_temperature, float& max, float& sum,
+                          bool simd) {
+  max = -std::numeric_limits<float>::infinity();
+  std::size_t i = 0;
+  if (simd) {
+    __m256 max_vec = _mm256_set1_ps(max);
+    for (; i + 7 < n; i += 8) {
+      // При NaN в первом операнде vmaxps возвращает второй
+      max_vec = _mm256_max_ps(loadu256_ps(block + i), max_vec);
+    }
+    max = hmax256_ps(max_vec);
+  }
+  for (; i < n; ++i) {
+    if (block[i] > max) max = block[i];
+  }
+  max *= inv_temperature;
+  sum = 0.0f;
+  if (std::isinf(max)) return;
+
+  i = 0;
+  if (simd) {
+    const __m256 inv_t = _mm256_set1_ps(inv_temperature);
+    const __m256 shift = _mm256_set1_ps(max);
+    __m256 sum_vec = _mm256_setzero_ps();
+    for (; i + 7 < n; i += 8) {
+      const __m256 x = loadu256_ps(block + i);
+      const __m256 e =
+          exp256_ps(_mm256_sub_ps(_mm256_mul_ps(x, inv_t), shift));
+      sum_vec = _mm256_add_ps(
+          sum_vec, _mm256_and_ps(e, _mm256_cmp_ps(x, x, _CMP_ORD_Q)));
+    }
+    sum = hsum256_ps(sum_vec);
+  }
+  for (; i < n; ++i) {
+    if (block[i] == block[i]) sum += std::exp(block[i] * inv_temperature - max);
+  }
+}
+
+/**
+ * @brief Выбор индекса обратной функцией распределения за одно чтение строки
+ *
+ * Для каждого блока из kCdfBlockCols логитов запоминаются его максимум m_b и
+ * сумма exp(x / T - m_b): блок читается из памяти один раз, второй проход
+ * по нему идёт из L1. Веса блоков приводятся к общему максимуму, по ним
+ * выбирается блок, в котором накопленная сумма переходит u * S, и только
+ * он читается повторно. Вероятности в память не пишутся. Логит +inf
+ * выбирается с вероятностью 1 (первый из таких).
+ *
+ * @param block_max, block_sum Буферы потока на ceil(n / kCdfBlockCols)
+ * значений
+ */
+inline std::int32_t InverseCdfRow(const float* row, std::size_t n,
+                                  float inv_temperature, float u,
+                                  std::vector<float>& block_max,
+                                  std::vector<float>& block_sum, bool simd) {
+  const std::size_t blocks = (n + kCdfBlockCols - 1) / kCdfBlockCols;
+  block_max.resize(blocks);
+  block_sum.resize(blocks);
+  float max = -std::numeric_limits<float>::infinity();
+  for (std::size_t b = 0; b < blocks; ++b) {
+    const std::size_t begin = b * kCdfBlockCols;
+    CdfBlockStats(row + begin, std::min(kCdfBlockCols, n - begin),
+                  inv_temperature, block_max[b], block_sum[b], simd);
+    max = std::max(max, block_max[b]);
+  }
+  if (max == std::numeric_limits<float>::infinity()) {
+    return static_cast<std::int32_t>(std::find(row, row + n, max) - row);
+  }
+
+  float total = 0.0f;
+  for (std::size_t b = 0; b < blocks; ++b) {
+    if (block_sum[b] > 0.0f) {
+      block_sum[b] *= std::exp(block_max[b] - max);
+      total += block_sum[b];
+    }
+  }
+  if (!(total > 0.0f)) return -1;
+
+  // Блок, в котором накопленная сумма переходит u * total; при округлении
+  // до конца строки - последний блок с ненулевым весом
+  float target = u * total;
+  std::size_t chosen = blocks;
+  for (std::size_t b = 0; b < blocks; ++b) {
+    if (!(block_sum[b] > 0.0f)) continue;
+    chosen = b;
+    if (target < block_sum[b]) break;
+    target -= block_sum[b];
+  }
+  target = std::min(target, block_sum[chosen]) / block_sum[chosen];
+
+  // Повторное чтение одного блока: доля target его собственной суммы
+  const std::size_t begin = chosen * kCdfBlockCols;
+  const std::size_t end = std::min(n, begin + kCdfBlockCols);
+  float local_sum = 0.0f;
+  for (std::size_t c = begin; c < end; ++c) {
+    if (row[c] == row[c]) {
+      local_sum += std::exp(row[c] * inv_temperature - block_max[chosen]);
+    }
+  }
+  target *= local_sum;
+  std::int32_t last = -1;
+  float cdf = 0.0f;
+  for (std::size_t c = begin; c < end; ++c) {
+    if (!(row[c] == row[c])) continue;
+    const float e = std::exp(row[c] * inv_temperature - block_max[chosen]);
+    if (e > 0.0f) last = static_cast<std::int32_t>(c);
+    cdf += e;
+    if (cdf > target && e > 0.0f) return last;
+  }
+  return last;
+}
+
+// Способ сэмплирования строки логитов
+enum class SamplingMethod {
+  kGumbel,      // argmax(x / T + g), шум на каждый элемент
+  kInverseCdf,  // одна равномерная величина на строку, блочная сумма
+};
+
+/**
+ * @brief Сэмплирование индекса из softmax(x / T) для каждой строки
+ *
+ * @param temperature Температура T > 0
+ * @param seed Ключ генератора; результат зависит только от (seed, строка,
+ * логиты) и не зависит от числа потоков
+ * @param samples Выбранный столбец для каждой строки (rows() элементов);
+ * -1, если все логиты строки - NaN или -inf
+ * @param sampling kGumbel не требует ни одной экспоненты и подходит для
+ * argmax-подобных строк с большим разбросом логитов (почти все блоки
+ * отсекаются); kInverseCdf дешевле на плоских распределениях
+ */
+inline void sample_softmax(TensorView<const float> logits, float temperature,
+                           std::uint64_t seed, std::int32_t* samples,
+                           SoftmaxMethod method,
+                           SamplingMethod sampling = SamplingMethod::kGumbel) {
+  if (!(temperature > 0.0f)) {
+    throw std::invalid_argument("Temperature must be positive");
+  }
+  const TensorShape& shape = logits.shape;
+  if (shape.numel() == 0) return;
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const auto gumbel_kernel = simd ? GumbelArgmaxRowSimd : GumbelArgmaxRow;
+  const std::size_t rows = shape.rows();
+  const std::size_t cols = shape.last_dim();
+  const std::size_t rs = shape.row_stride();
+  const float inv_temperature = 1.0f / temperature;
+
+#pragma omp parallel if (parallel)
+  {
+    std::vector<float> block_max, block_sum;
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      const float* row = logits.data + r * rs;
+      if (sampling == SamplingMethod::kGumbel) {
+        samples[r] = gumbel_kernel(row, cols, inv_temperature, seed, r);
+      } else {
+        const float u =
+            bits_to_open_unit(philox_bits(seed, kSamplingStream, r, 0));
+        samples[r] = InverseCdfRow(row, cols, inv_temperature, u, block_max,
+                                   block_sum, simd);
+      }
+    }
+  }
+}
+
+#endif  // !SOFTMAX_SAMPLING_H
@@ -0,0 +1,263 @@
+/**
+ * @file softmax_segmented.h
+ * @brief Softmax по сегментам разной длины в одном буфере (CSR)
+ *
+ * Сегмент s занимает values[offsets[s], offsets[s + 1]) - так хранятся
+ * рёбра графового внимания и батчи последовательностей разной длины. Ядро
+ * выбирается по длине сегмента:
+ *  - короткие (< kSegmentSmall): по 8 сегментов в регистрах, суммы и
+ *    нормировки - по дорожке на сегмент;
+ *  - средние: построчное ядро SoftmaxRowSimd;
+ *  - огромные (>= kSegmentParallel): сумма и нормализация одного сегмента
+ *    делятся между всеми потоками; в воспроизводимом режиме - кусками по
+ *    kSegmentReproducibleChunk, суммы которых складываются по порядку.
+ * Остальная работа нарезается на задачи примерно равного объёма, которые
+ * раздаются динамически от самых длинных к коротким: несколько длинных
+ * сегментов не задерживают завершение региона.
+ */
+
+#ifndef SOFTMAX_SEGMENTED_H
+#define SOFTMAX_SEGMENTED_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+
+// Сегменты короче этой длины обрабатываются по 8 в дорожках AVX2
+constexpr std::size_t kSegmentSmall = 8;
+
+// Сегменты не короче этой длины делятся между потоками
+constexpr std::size_t kSegmentParallel = 64 * 1024;
+
+// Кусок огромного сегмента в воспроизводимом режиме (элементов)
+constexpr std::size_t kSegmentReproducibleChunk = 16 * 1024;
+
+// Объём задачи динамического расписания (элементов)
+constexpr std::size_t kSegmentTaskElements = 16 * 1024;
+
+/**
+ * @brief Softmax восьми коротких сегментов
+ *
+ * ids - номера count <= 8 сегментов длины < kSegmentSmall. Каждый сегмент
+ * читается в свой регистр маскированной загрузкой (без ветвлений по длине
+ * и без чтения за концом сегмента), а суммы восьми сегментов сводятся
+ * деревом vhaddps в один вектор - по дорожке на сегмент (структура
+ * массивов). Деление на сумму и выбор 1/n при нулевой сумме, как в
+ * SoftmaxRow, выполняются сразу для всех восьми.
+ */
+inline void SoftmaxSegmentsSoA(const float* values, float* output,
+                               const std::size_t* offsets,
+                               const std::size_t* ids, std::size_t count) {
+  __m256 exps[8];
+  __m256i masks[8];
+  alignas(32) float lengths[8];
+  for (std::size_t k = 0; k < 8; ++k) {
+    const std::size_t begin = k < count ? offsets[ids[k]] : 0;
+    const std::size_t len = k < count ? offsets[ids[k] + 1] - begin : 0;
+    masks[k] = first_lanes_mask(len);
+    lengths[k] = static_cast<float>(len);
+    exps[k] = _mm256_and_ps(
+        exp256_ps(_mm256_maskload_ps(values + begin, masks[k])),
+        _mm256_castsi256_ps(masks[k]));
+  }
+
+  // Суммы: дорожка k - сумма сегмента k
+  const __m256 h0 = _mm256_hadd_ps(_mm256_hadd_ps(exps[0], exps[1]),
+                                   _mm256_hadd_ps(exps[2], exps[3]));
+  const __m256 h1 = _mm256_hadd_ps(_mm256_hadd_ps(exps[4], exps[5]),
+                                   _mm256_hadd_ps(exps[6], exps[7]));
+  const __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(h0, h1, 0x20),
+                                   _mm256_permute2f128_ps(h0, h1, 0x31));
+
+  const __m256 zero_sum = _mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_EQ_OQ);
+  alignas(32) float scale[8];
+  _mm256_store_ps(scale, _mm256_div_ps(_mm256_set1_ps(1.0f), sum));
+  alignas(32) float uniform[8];
+  _mm256_store_ps(uniform,
+                  _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_load_ps(lengths)));
+  alignas(32) float zero[8];
+  _mm256_store_ps(zero, zero_sum);
+
+  for (std::size_t k = 0; k < count; ++k) {
+    const __m256 probs =
+        zero[k] != 0.0f
+            ? _mm256_set1_ps(uniform[k])
+            : _mm256_mul_ps(exps[k], _mm256_set1_ps(scale[k]));
+    _mm256_maskstore_ps(output + offsets[ids[k]], masks[k], probs);
+  }
+}
+
+// Задача расписания: сегменты с номерами [begin, end), кроме огромных
+struct SegmentTask {
+  std::size_t begin;
+  std::size_t end;
+  std::size_t elements;
+};
+
+/**
+ * @brief Softmax каждого сегмента values[offsets[s], offsets[s + 1])
+ *
+ * @param offsets segments + 1 неубывающих смещений (CSR); offsets[0] не
+ * обязан быть нулём
+ * @param output Буфер той же разметки, что values
+ * @param order kReproducible - огромные сегменты режутся независимо от
+ * числа потоков
+ */
+inline void softmax_segments(const float* values, float* output,
+                             const std::size_t* offsets,
+                             std::size_t segments, SoftmaxMethod method,
+                             DenormalMode mode = DenormalMode::kPreserve,
+                             ReductionOrder order = ReductionOrder::kFast) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const bool reproducible = order == ReductionOrder::kReproducible;
+  const auto length = [&](std::size_t s) {
+    return offsets[s + 1] - offsets[s];
+  };
+  // Воспроизводимый режим режет огромные сегменты и без потоков: так
+  // kOpenMPSimd совпадает с kSimd
+  const auto is_huge = [&](std::size_t len) {
+    return (parallel || reproducible) && len >= kSegmentParallel;
+  };
+
+  // Один проход по смещениям: проверка, огромные сегменты - в список,
+  // остальные - подряд идущими диапазонами номеров в задачи
+  std::vector<std::size_t> huge;
+  std::vector<SegmentTask> tasks;
+  SegmentTask task{0, 0, 0};
+  for (std::size_t s = 0; s < segments; ++s) {
+    if (offsets[s + 1] < offsets[s]) {
+      throw std::invalid_argument("Segment offsets must be non-decreasing");
+    }
+    const std::size_t len = length(s);
+    if (is_huge(len)) {
+      huge.push_back(s);
+    } else {
+      task.elements += len;
+    }
+    if (task.elements >= kSegmentTaskElements || s + 1 == segments) {
+      task.end = s + 1;
+      if (task.elements > 0) tasks.push_back(task);
+      task = {s + 1, s + 1, 0};
+    }
+  }
+  // Самые объёмные задачи - первыми (жадное расписание LPT)
+  std::stable_sort(tasks.begin(), tasks.end(),
+                   [](const SegmentTask& a, const SegmentTask& b) {
+                     return a.elements > b.elements;
+                   });
+
+  std::size_t max_parts =
+      parallel ? static_cast<std::size_t>(omp_get_max_threads()) : 1;
+  if (reproducible) {
+    for (std::size_t s : huge) {
+      const std::size_t chunks = (length(s) + kSegmentReproducibleChunk - 1) /
+                                 kSegmentReproducibleChunk;
+      max_parts = std::max(max_parts, chunks);
+    }
+  }
+  std::vector<float> partial(max_parts);
+  float total = 0.0f;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+
+    // Огромные сегменты: все потоки на один сегмент
+    for (std::size_t s : huge) {
+      const std::size_t begin = offsets[s];
+      const std::size_t len = length(s);
+      // Части: по одной на поток или куски, заданные только длиной
+      const std::size_t parts =
+          reproducible ? (len + kSegmentReproducibleChunk - 1) /
+                             kSegmentReproducibleChunk
+                       : static_cast<std::size_t>(omp_get_num_threads());
+      const auto part_begin = [&](std::size_t t) {
+        return begin + (reproducible
+                            ? std::min(len, t * kSegmentReproducibleChunk)
+                            : len * t / parts);
+      };
+#pragma omp for schedule(static)
+      for (std::size_t t = 0; t < parts; ++t) {
+        const std::size_t lo = part_begin(t);
+        const std::size_t hi = part_begin(t + 1);
+        float sum = 0.0f;
+        if (simd) {
+          // Попарная сумма блоками, как в построчном ядре
+          RowReduceSimd(SoftmaxOp{}, values + lo, output + lo, hi - lo, &sum);
+        } else {
+          for (std::size_t j = lo; j < hi; ++j) {
+            output[j] = std::exp(values[j]);
+            sum += output[j];
+          }
+        }
+        partial[t] = sum;
+      }
+      // Сумма частей по порядку в double: результат не зависит от
+      // расписания, а сотни кусков не копят ошибку float
+#pragma omp single
+      {
+        double parts_sum = 0.0;
+        for (std::size_t t = 0; t < parts; ++t) parts_sum += partial[t];
+        total = static_cast<float>(parts_sum);
+      }
+      const bool zero = total == 0.0f;
+      const float scale = zero ? 1.0f / len : 1.0f / total;
+#pragma omp for schedule(static)
+      for (std::size_t t = 0; t < parts; ++t) {
+        const std::size_t lo = part_begin(t);
+        const std::size_t hi = part_begin(t + 1);
+        std::size_t j = lo;
+        if (simd) {
+          const __m256 scale_vec = _mm256_set1_ps(scale);
+          for (; j + 7 < hi; j += 8) {
+            storeu256_ps(output + j,
+                         zero ? scale_vec
+                              : _mm256_mul_ps(loadu256_ps(output + j),
+                                              scale_vec));
+          }
+        }
+        for (; j < hi; ++j) output[j] = zero ? scale : output[j] * scale;
+      }
+    }
+
+#pragma omp for schedule(dynamic, 1)
+    for (std::size_t t = 0; t < tasks.size(); ++t) {
+      // Короткие сегменты копятся по 8 в порядке обхода памяти
+      std::size_t pending[8];
+      std::size_t pending_count = 0;
+      for (std::size_t s = tasks[t].begin; s < tasks[t].end; ++s) {
+        const std::size_t len = length(s);
+        if (len == 0 || is_huge(len)) continue;
+        if (simd && len < kSegmentSmall) {
+          pending[pending_count++] = s;
+          if (pending_count == 8) {
+            SoftmaxSegmentsSoA(values, output, offsets, pending, 8);
+            pending_count = 0;
+          }
+        } else if (simd) {
+          // Прямые вызовы: ядро встраивается, что заметно на коротких строках
+          SoftmaxRowSimd(values + offsets[s], output + offsets[s], len);
+        } else {
+          SoftmaxRow(values + offsets[s], output + offsets[s], len);
+        }
+      }
+      if (pending_count > 0) {
+        SoftmaxSegmentsSoA(values, output, offsets, pending, pending_count);
+      }
+    }
+  }
+}
+
+#endif  // !SOFTMAX_SEGMENTED_H
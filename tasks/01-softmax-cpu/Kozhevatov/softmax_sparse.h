@@ -0,0 +1,323 @@
+/**
+ * @file softmax_sparse.h
+ * @brief Sparsemax и entmax-1.5: разреженные аналоги Softmax по строкам
+ *
+ * sparsemax(x) = [x - τ]_+, entmax-1.5(x) = [x/2 - τ]_+^2; порог τ
+ * подбирается так, чтобы сумма строки была 1, и малые логиты получают
+ * точный ноль. Вместо сортировки строки (O(n log n)) порог ищется
+ * проходами по строке, которая после первого чтения лежит в кэше. Оба
+ * отображения делят пополам отрезок, содержащий порог, - не больше
+ * kSparseMaxPasses проходов, то есть O(n) при любой строке:
+ *  - sparsemax: отрезок [max - 1, max - 1/n]; на каждом проходе по носителю
+ *    нижней границы вычисляется шаг Michelot τ = (Σ_S x - 1) / |S|. Он не
+ *    больше порога и поднимает нижнюю границу, а если согласован с
+ *    носителем - порог точен (на обычных строках - за несколько проходов);
+ *  - entmax-1.5: отрезок [max/2 - 1, max/2 - 1/√n]; на каждом проходе по
+ *    носителю нижней границы решается квадратное уравнение Σ (z - τ)^2 = 1,
+ *    и как только решение согласовано с носителем, порог точен.
+ * Все значения сдвигаются на максимум строки: носитель лежит в пределах
+ * 1 (для z = x/2) от максимума, и суммы квадратов не теряют точность.
+ */
+
+#ifndef SOFTMAX_SPARSE_H
+#define SOFTMAX_SPARSE_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+
+#include "simd_utils.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Разреженное отображение строки
+enum class SparseMapping {
+  kSparsemax,  // [x - τ]_+
+  kEntmax15,   // [x/2 - τ]_+^2
+};
+
+// Предел проходов поиска порога (деление пополам float отрезка длины < 1
+// сходится раньше)
+constexpr int kSparseMaxPasses = 64;
+
+// Статистики носителя {d > tau} одного прохода по строке
+struct SparseSupport {
+  std::size_t count = 0;
+  float sum = 0.0f;       // Σ d
+  float sum_sq = 0.0f;    // Σ d^2
+  float min = std::numeric_limits<float>::infinity();  // min d
+  float excess = 0.0f;    // Σ [d - probe]_+ или Σ [d - probe]_+^2
+};
+
+/**
+ * @brief Один проход по строке: статистики носителя d > tau и сумма
+ * [d - probe]_+ (с kSquares - [d - probe]_+^2), где d = scale * x - shift
+ *
+ * Сумма квадратов носителя нужна только entmax-1.5 (kSquares).
+ */
+template <bool kSquares>
+inline SparseSupport SparseSupportPass(const float* row, std::size_t n,
+                                       float scale, float shift, float tau,
+                                       float probe, bool simd) {
+  SparseSupport support;
+  std::size_t i = 0;
+  if (simd) {
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    const __m256 shift_vec = _mm256_set1_ps(shift);
+    const __m256 tau_vec = _mm256_set1_ps(tau);
+    const __m256 probe_vec = _mm256_set1_ps(probe);
+    const __m256 ones = _mm256_set1_ps(1.0f);
+    __m256 count_vec = _mm256_setzero_ps();
+    __m256 sum_vec = _mm256_setzero_ps();
+    __m256 sq_vec = _mm256_setzero_ps();
+    const __m256 outside = _mm256_set1_ps(support.min);
+    __m256 min_vec = outside;
+    __m256 excess_vec = _mm256_setzero_ps();
+    for (; i + 7 < n; i += 8) {
+      const __m256 d = _mm256_sub_ps(
+          _mm256_mul_ps(loadu256_ps(row + i), scale_vec), shift_vec);
+      const __m256 in = _mm256_cmp_ps(d, tau_vec, _CMP_GT_OQ);
+      const __m256 kept = _mm256_and_ps(d, in);
+      count_vec = _mm256_add_ps(count_vec, _mm256_and_ps(ones, in));
+      sum_vec = _mm256_add_ps(sum_vec, kept);
+      min_vec = _mm256_min_ps(min_vec, _mm256_blendv_ps(outside, d, in));
+      const __m256 over = _mm256_max_ps(_mm256_sub_ps(d, probe_vec),
+                                        _mm256_setzero_ps());
+      if (kSquares) {
+        sq_vec = _mm256_add_ps(sq_vec, _mm256_mul_ps(kept, kept));
+        excess_vec = _mm256_add_ps(excess_vec, _mm256_mul_ps(over, over));
+      } else {
+        excess_vec = _mm256_add_ps(excess_vec, over);
+      }
+    }
+    support.count = static_cast<std::size_t>(hsum256_ps(count_vec));
+    support.sum = hsum256_ps(sum_vec);
+    support.min = -hmax256_ps(_mm256_sub_ps(_mm256_setzero_ps(), min_vec));
+    support.excess = hsum256_ps(excess_vec);
+    if (kSquares) support.sum_sq = hsum256_ps(sq_vec);
+  }
+  for (; i < n; ++i) {
+    const float d = row[i] * scale - shift;
+    if (d > tau) {
+      ++support.count;
+      support.sum += d;
+      support.min = std::min(support.min, d);
+      if (kSquares) support.sum_sq += d * d;
+    }
+    if (d > probe) {
+      support.excess += kSquares ? (d - probe) * (d - probe) : d - probe;
+    }
+  }
+  return support;
+}
+
+// Запись результата: out = [d - tau]_+ или [d - tau]_+^2. Порог
+// вычитается из уже сдвинутого d: при max + tau малые p теряли бы точность
+template <bool kSquare>
+inline void SparseRowOutput(const float* row, float* out, std::size_t n,
+                            float scale, float shift, float tau, bool simd) {
+  std::size_t i = 0;
+  if (simd) {
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    const __m256 shift_vec = _mm256_set1_ps(shift);
+    const __m256 tau_vec = _mm256_set1_ps(tau);
+    for (; i + 7 < n; i += 8) {
+      const __m256 d = _mm256_sub_ps(
+          _mm256_mul_ps(loadu256_ps(row + i), scale_vec), shift_vec);
+      const __m256 p =
+          _mm256_max_ps(_mm256_sub_ps(d, tau_vec), _mm256_setzero_ps());
+      storeu256_ps(out + i, kSquare ? _mm256_mul_ps(p, p) : p);
+    }
+  }
+  for (; i < n; ++i) {
+    const float p = std::max((row[i] * scale - shift) - tau, 0.0f);
+    out[i] = kSquare ? p * p : p;
+  }
+}
+
+// Строка из одних -inf: как и в SoftmaxRow, равномерное распределение
+inline bool SparseRowDegenerate(float max, float* out, std::size_t n) {
+  if (max != -std::numeric_limits<float>::infinity()) return false;
+  std::fill(out, out + n, 1.0f / n);
+  return true;
+}
+
+// Порог строки (в сдвинутых значениях) и число проходов его поиска
+struct SparseThreshold {
+  float tau;
+  int passes;
+};
+
+/**
+ * @brief Порог sparsemax строки с максимумом max
+ *
+ * Отрезок [lo, hi] = [-1, -1/n] (в сдвинутых на максимум значениях) всегда
+ * содержит порог: Σ [d - lo]_+ >= 1 >= Σ [d - hi]_+. На проходе с носителем
+ * S = {d > lo} шаг Michelot τ = (Σ_S d - 1) / |S| не больше порога: если
+ * τ < min S, носитель верен и τ точен, иначе τ - новая нижняя граница.
+ * Отрезок делится пополам по сумме в его середине (тем же проходом), так
+ * что проходов не больше kSparseMaxPasses, а не O(n), как у итерации
+ * Michelot, когда носитель сжимается по одному элементу. Если отрезок
+ * сошёлся без точного совпадения, порог даёт ещё один проход по носителю
+ * нижней границы.
+ */
+inline SparseThreshold SparsemaxThreshold(const float* row, std::size_t n,
+                                          float max, bool simd) {
+  float lo = -1.0f;
+  float hi = -1.0f / static_cast<float>(n);
+  int pass = 0;
+  while (pass < kSparseMaxPasses) {
+    ++pass;
+    const float mid = 0.5f * (lo + hi);
+    const SparseSupport support =
+        SparseSupportPass<false>(row, n, 1.0f, max, lo, mid, simd);
+    const float candidate = (support.sum - 1.0f) / support.count;
+    if (candidate >= lo && candidate < support.min) return {candidate, pass};
+    // Отрезок сжался до соседних float
+    if (!(lo < mid && mid < hi)) break;
+    if (support.excess >= 1.0f) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+    lo = std::max(lo, std::min(candidate, hi));
+  }
+  const SparseSupport support =
+      SparseSupportPass<false>(row, n, 1.0f, max, lo, lo, simd);
+  const float tau = std::clamp((support.sum - 1.0f) / support.count, lo, hi);
+  return {tau, pass + 1};
+}
+
+// Sparsemax строки
+inline void SparsemaxRow(const float* row, float* out, std::size_t n,
+                         bool simd) {
+  if (n == 0) return;
+  const float max = RowMax(row, n, simd);
+  if (SparseRowDegenerate(max, out, n)) return;
+  const float tau = SparsemaxThreshold(row, n, max, simd).tau;
+  SparseRowOutput<false>(row, out, n, 1.0f, max, tau, simd);
+}
+
+/**
+ * @brief entmax-1.5 строки: p = [x/2 - τ]_+^2
+ *
+ * Отрезок [lo, hi] всегда содержит порог: сумма при lo не меньше 1, при hi
+ * не больше. На проходе с носителем S = {d > lo} решается
+ * Σ_S (d - τ)^2 = 1: τ = m - sqrt(1/k - var), где m и var - среднее и
+ * дисперсия S. Если lo <= τ < min S, носитель S верен и τ точен; иначе
+ * отрезок делится пополам по сумме в его середине (тем же проходом).
+ */
+inline void Entmax15Row(const float* row, float* out, std::size_t n,
+                        bool simd) {
+  if (n == 0) return;
+  const float row_max = RowMax(row, n, simd);
+  if (SparseRowDegenerate(row_max, out, n)) return;
+  const float max = 0.5f * row_max;
+  float lo = -1.0f;
+  float hi = -1.0f / std::sqrt(static_cast<float>(n));
+  float tau = 0.5f * (lo + hi);
+  for (int pass = 0; pass < kSparseMaxPasses; ++pass) {
+    const float mid = 0.5f * (lo + hi);
+    const SparseSupport support =
+        SparseSupportPass<true>(row, n, 0.5f, max, lo, mid, simd);
+    const float k = static_cast<float>(support.count);
+    const float mean = support.sum / k;
+    const float var = std::max(support.sum_sq / k - mean * mean, 0.0f);
+    const float disc = 1.0f / k - var;
+    if (disc >= 0.0f) {
+      const float candidate = mean - std::sqrt(disc);
+      if (candidate >= lo && candidate < support.min) {
+        tau = candidate;
+        break;
+      }
+    }
+    // Отрезок сжался до соседних float: порог - его середина
+    if (!(lo < mid && mid < hi)) break;
+    if (support.excess >= 1.0f) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+    tau = 0.5f * (lo + hi);
+  }
+  SparseRowOutput<true>(row, out, n, 0.5f, max, tau, simd);
+}
+
+/**
+ * @brief Sparsemax или entmax-1.5 для rows строк длины cols
+ *
+ * Тот же запуск, что у softmax_rows: строки с шагами, распределение строк
+ * между потоками и режим денормалов в каждом потоке.
+ */
+inline void sparse_rows(const float* input, std::size_t input_stride,
+                        float* output, std::size_t output_stride,
+                        std::size_t rows, std::size_t cols,
+                        SparseMapping mapping, SoftmaxMethod method,
+                        DenormalMode mode = DenormalMode::kPreserve) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const auto row_kernel =
+      mapping == SparseMapping::kSparsemax ? SparsemaxRow : Entmax15Row;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t i = 0; i < rows; ++i) {
+      row_kernel(input + i * input_stride, output + i * output_stride, cols,
+                 simd);
+    }
+  }
+}
+
+// Sparsemax или entmax-1.5 по последней оси тензора; последняя ось должна
+// быть непрерывной, ведущие оси - любые (смещение строки по шагам)
+inline void sparse_last_axis(TensorView<const float> input,
+                             TensorView<float> output, SparseMapping mapping,
+                             SoftmaxMethod method,
+                             DenormalMode mode = DenormalMode::kPreserve) {
+  const TensorShape& in_shape = input.shape;
+  const TensorShape& out_shape = output.shape;
+  if (in_shape.dims != out_shape.dims) {
+    throw std::invalid_argument("Input and output shapes differ");
+  }
+  if (!in_shape.last_axis_contiguous() || !out_shape.last_axis_contiguous()) {
+    throw std::invalid_argument("Sparse mapping rows must be contiguous");
+  }
+  if (in_shape.numel() == 0) return;
+  if (in_shape.rows_collapsible() && out_shape.rows_collapsible()) {
+    sparse_rows(input.data, in_shape.row_stride(), output.data,
+                out_shape.row_stride(), in_shape.rows(), in_shape.last_dim(),
+                mapping, method, mode);
+    return;
+  }
+
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const auto row_kernel =
+      mapping == SparseMapping::kSparsemax ? SparsemaxRow : Entmax15Row;
+  const std::size_t rows = in_shape.rows();
+  const std::size_t cols = in_shape.last_dim();
+  const std::size_t lead = in_shape.rank() - 1;
+
+#pragma omp parallel if (parallel)
+  {
+    ScopedDenormalMode denormals(mode);
+#pragma omp for
+    for (std::size_t r = 0; r < rows; ++r) {
+      row_kernel(input.data + in_shape.offset_of(r, lead),
+                 output.data + out_shape.offset_of(r, lead), cols, simd);
+    }
+  }
+}
+
+#endif  // !SOFTMAX_SPARSE_H
@@ -0,0 +1,288 @@
+/**
+ * @file softmax_state.h
+ * @brief Потоковое состояние Softmax: текущий максимум и сумма экспонент
+ *
+ * При авторегрессионном декодировании строка внимания растёт на один элемент
+ * за шаг, и пересчёт Softmax всей строки стоит O(длина строки). Состояние
+ * (max, Σ exp(x - max)) обновляется за O(новых элементов): при появлении
+ * большего максимума сумма домножается на exp(старый max - новый max).
+ * Состояния соседних кусков строки объединяются тем же правилом, поэтому
+ * длинную строку можно разрезать между потоками и слить результаты.
+ * Состояния кусков сливаются попарно (PairwiseSum), как суммы блоков в
+ * row_reduce.h: ошибка суммы растёт как log(кусков), а не линейно.
+ */
+
+#ifndef SOFTMAX_STATE_H
+#define SOFTMAX_STATE_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "row_reduce.h"
+#include "simd_utils.h"
+#include "simd_vec.h"
+#include "softmax_kernels.h"
+
+// Кусок строки, который добавляется за два прохода из L1 (максимум, затем
+// сумма): 4 КиБ логитов
+constexpr std::size_t kStateChunk = 1024;
+
+/**
+ * @brief Состояние Softmax по уже добавленным логитам
+ *
+ * softmax(x)_j = exp(x_j - max) / sum. Пустое состояние и состояние только
+ * из -inf имеют max = -inf и sum = 0; для них, как и в SoftmaxRow,
+ * вероятности равномерны (1 / count).
+ */
+struct SoftmaxState {
+  float max = -std::numeric_limits<float>::infinity();
+  float sum = 0.0f;       // Σ exp(x - max)
+  std::size_t count = 0;  // число добавленных логитов
+
+  static SoftmaxState zero() { return {}; }
+
+  // Объединение с состоянием другого куска строки (порядок не важен)
+  void merge(const SoftmaxState& other) {
+    count += other.count;
+    if (other.sum == 0.0f) return;
+    if (sum == 0.0f) {
+      max = other.max;
+      sum = other.sum;
+      return;
+    }
+    const float new_max = std::max(max, other.max);
+    sum = sum * std::exp(max - new_max) +
+          other.sum * std::exp(other.max - new_max);
+    max = new_max;
+  }
+
+  // Добавление одного логита: O(1)
+  void append(float x) {
+    ++count;
+    if (x == -std::numeric_limits<float>::infinity()) return;
+    if (x > max) {
+      sum = sum * std::exp(max - x) + 1.0f;
+      max = x;
+    } else {
+      sum += std::exp(x - max);
+    }
+  }
+
+  // Добавление n логитов кусками по kStateChunk
+  void append(const float* x, std::size_t n, bool simd = true);
+
+  // log Σ exp(x) по всем добавленным логитам
+  float log_normalizer() const {
+    return sum == 0.0f ? max : max + std::log(sum);
+  }
+
+  // Вероятность логита x относительно текущего состояния
+  float probability(float x) const {
+    if (sum == 0.0f) return 1.0f / count;
+    return std::exp(x - max) / sum;
+  }
+
+  /**
+   * @brief Вероятности логитов [begin, end) строки logits
+   *
+   * logits - та же строка, по которой накоплено состояние; out получает
+   * end - begin значений. Стоит O(end - begin), а не O(длины строки).
+   */
+  void materialize(const float* logits, std::size_t begin, std::size_t end,
+                   float* out, bool simd = true) const;
+};
+
+// Слияние состояний для PairwiseSum
+inline SoftmaxState operator+(SoftmaxState a, const SoftmaxState& b) {
+  a.merge(b);
+  return a;
+}
+
+// Состояние куска строки: максимум, затем сумма из кэша
+inline SoftmaxState SoftmaxStateChunk(const float* x, std::size_t n,
+                                      bool simd) {
+  SoftmaxState state;
+  state.count = n;
+  state.max = RowMax(x, n, simd);
+  if (state.max == -std::numeric_limits<float>::infinity()) return state;
+
+  if (simd) {
+    RowReduceSimd(ShiftedExpOp<>{state.max}, x, nullptr, n, &state.sum);
+  } else {
+    RowReduce(ShiftedExpOp<>{state.max}, x, nullptr, n, &state.sum);
+  }
+  return state;
+}
+
+/**
+ * @brief Состояние Softmax в каждой из 8 дорожек AVX2 для одного чтения
+ *
+ * Дорожка хранит свой максимум и Σ exp(x - max). Сумма домножается на
+ * exp(старый max - новый max) только в векторах, где максимум какой-то
+ * дорожки вырос, поэтому на вектор приходится одна экспонента. Дорожки
+ * сливаются правилом SoftmaxState::merge; operator+ сливает два набора
+ * дорожек, так что блоки строки складываются через PairwiseSum.
+ */
+struct SoftmaxLanes {
+  __m256 max = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+  __m256 sum = _mm256_setzero_ps();
+
+  static SoftmaxLanes zero() { return {}; }
+
+  // Сумма, приведённая к максимуму new_max >= max; пустые дорожки
+  // (max = -inf) дают 0, а не NaN, а сумма NaN остаётся NaN
+  __m256 rescaled(__m256 new_max) const {
+    const __m256 same = _mm256_cmp_ps(max, new_max, _CMP_EQ_OQ);
+    if (_mm256_movemask_ps(same) == 0xFF) return sum;
+    const __m256 nonempty =
+        _mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+    return _mm256_and_ps(
+        nonempty, _mm256_mul_ps(sum, exp256_ps(_mm256_sub_ps(max, new_max))));
+  }
+
+  void append(__m256 x) {
+    const __m256 grown = _mm256_cmp_ps(x, max, _CMP_GT_OQ);
+    if (_mm256_movemask_ps(grown) != 0) {
+      // max_ps возвращает второй операнд при NaN: NaN не попадает в max,
+      // как и в скалярном append
+      const __m256 new_max = _mm256_max_ps(x, max);
+      const __m256 rescaled =
+          _mm256_mul_ps(sum, exp256_ps(_mm256_sub_ps(max, new_max)));
+      sum = _mm256_blendv_ps(sum, rescaled, grown);
+      max = new_max;
+    }
+    // -inf пропускается: при max = -inf разность - NaN, а не -inf
+    const __m256 finite_below = _mm256_cmp_ps(
+        x, _mm256_set1_ps(-std::numeric_limits<float>::infinity()),
+        _CMP_NEQ_OQ);
+    sum = _mm256_add_ps(
+        sum, _mm256_and_ps(finite_below,
+                           exp256_ps(_mm256_sub_ps(x, max))));
+    // exp256_ps обрезает NaN до конечного значения: сумма дорожки
+    // становится NaN явно, и log Σ exp - NaN, как у LogitStatsRow
+    sum = _mm256_or_ps(sum, _mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+  }
+
+  // Слияние дорожек в одно состояние из count логитов
+  SoftmaxState reduce(std::size_t count) const {
+    alignas(32) float maxes[8];
+    alignas(32) float sums[8];
+    _mm256_store_ps(maxes, max);
+    _mm256_store_ps(sums, sum);
+    SoftmaxState state;
+    for (int k = 0; k < 8; ++k) {
+      SoftmaxState lane;
+      lane.max = maxes[k];
+      lane.sum = sums[k];
+      state.merge(lane);
+    }
+    state.count = count;
+    return state;
+  }
+};
+
+inline SoftmaxLanes operator+(const SoftmaxLanes& a, const SoftmaxLanes& b) {
+  SoftmaxLanes lanes;
+  lanes.max = _mm256_max_ps(a.max, b.max);
+  lanes.sum = _mm256_add_ps(a.rescaled(lanes.max), b.rescaled(lanes.max));
+  return lanes;
+}
+
+inline void SoftmaxState::append(const float* x, std::size_t n, bool simd) {
+  PairwiseSum<SoftmaxState> chunks;
+  for (std::size_t begin = 0; begin < n; begin += kStateChunk) {
+    const SoftmaxState chunk =
+        SoftmaxStateChunk(x + begin, std::min(kStateChunk, n - begin), simd);
+    chunks.push(&chunk);
+  }
+  SoftmaxState total;
+  chunks.total(&total);
+  merge(total);
+}
+
+inline void SoftmaxState::materialize(const float* logits, std::size_t begin,
+                                      std::size_t end, float* out,
+                                      bool simd) const {
+  const std::size_t n = end - begin;
+  if (sum == 0.0f) {
+    std::fill(out, out + n, 1.0f / count);
+    return;
+  }
+  const float* x = logits + begin;
+  const float inv_sum = 1.0f / sum;
+  std::size_t i = 0;
+  if (simd) {
+    const __m256 shift = _mm256_set1_ps(max);
+    const __m256 inv_vec = _mm256_set1_ps(inv_sum);
+    for (; i + 7 < n; i += 8) {
+      storeu256_ps(out + i,
+                   _mm256_mul_ps(exp256_ps(_mm256_sub_ps(loadu256_ps(x + i),
+                                                         shift)),
+                                 inv_vec));
+    }
+  }
+  for (; i < n; ++i) out[i] = std::exp(x[i] - max) * inv_sum;
+}
+
+/**
+ * @brief Состояние Softmax длинной строки, посчитанное несколькими потоками
+ *
+ * Каждый поток попарно сливает состояния кусков своего непрерывного
+ * диапазона, затем состояния потоков сливаются в порядке номеров. В
+ * воспроизводимом режиме сохраняется состояние каждого куска kStateChunk, и
+ * куски сливаются попарно по порядку - ровно как при добавлении строки
+ * одним потоком.
+ */
+inline SoftmaxState softmax_state(
+    const float* row, std::size_t n, SoftmaxMethod method,
+    ReductionOrder order = ReductionOrder::kFast) {
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t chunks = (n + kStateChunk - 1) / kStateChunk;
+
+  if (order == ReductionOrder::kReproducible) {
+    std::vector<SoftmaxState> chunk_states(chunks);
+#pragma omp parallel for schedule(static) if (parallel)
+    for (std::size_t c = 0; c < chunks; ++c) {
+      const std::size_t begin = c * kStateChunk;
+      chunk_states[c] =
+          SoftmaxStateChunk(row + begin, std::min(kStateChunk, n - begin),
+                            simd);
+    }
+    PairwiseSum<SoftmaxState> pairwise;
+    for (const SoftmaxState& chunk : chunk_states) pairwise.push(&chunk);
+    SoftmaxState state;
+    pairwise.total(&state);
+    return state;
+  }
+
+  std::vector<SoftmaxState> partial(
+      parallel ? static_cast<std::size_t>(omp_get_max_threads()) : 1);
+
+#pragma omp parallel if (parallel)
+  {
+    PairwiseSum<SoftmaxState> local;
+#pragma omp for schedule(static) nowait
+    for (std::size_t c = 0; c < chunks; ++c) {
+      const std::size_t begin = c * kStateChunk;
+      const SoftmaxState chunk = SoftmaxStateChunk(
+          row + begin, std::min(kStateChunk, n - begin), simd);
+      local.push(&chunk);
+    }
+    local.total(&partial[parallel ? omp_get_thread_num() : 0]);
+  }
+
+  SoftmaxState state;
+  for (const SoftmaxState& p : partial) state.merge(p);
+  return state;
+}
+
+#endif  // !SOFTMAX_STATE_H
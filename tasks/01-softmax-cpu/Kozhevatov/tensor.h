@@ -0,0 +1,234 @@
+/**
+ * @file tensor.h
+ * @brief Форма тензора и невладеющее представление (view) его данных
+ *
+ * Тензор произвольной размерности [d0, d1, ..., dk] рассматривается как
+ * d0*d1*...*d(k-1) строк длины dk: ведущие оси "сворачиваются" в число строк,
+ * и работа уходит в те же построчные ядра, что и для матрицы n×n.
+ *
+ * TensorView не владеет памятью: срезы, подматрицы и чужие буферы передаются
+ * в ядра без копирования в std::vector.
+ */
+
+#ifndef TENSOR_H
+#define TENSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Форма тензора с шагами (в элементах) по каждой оси
+ *
+ * Если шаги не заданы, тензор считается плотным (row-major).
+ */
+struct TensorShape {
+  std::vector<std::size_t> dims;
+  std::vector<std::size_t> strides;
+
+  TensorShape() = default;
+  TensorShape(std::vector<std::size_t> dims_)
+      : dims(std::move(dims_)), strides(contiguous_strides(dims)) {}
+  TensorShape(std::vector<std::size_t> dims_,
+              std::vector<std::size_t> strides_)
+      : dims(std::move(dims_)), strides(std::move(strides_)) {
+    if (strides.size() != dims.size()) {
+      throw std::invalid_argument("Shape and strides rank mismatch");
+    }
+  }
+
+  static std::vector<std::size_t> contiguous_strides(
+      const std::vector<std::size_t>& dims) {
+    std::vector<std::size_t> strides(dims.size());
+    std::size_t stride = 1;
+    for (std::size_t i = dims.size(); i-- > 0;) {
+      strides[i] = stride;
+      stride *= dims[i];
+    }
+    return strides;
+  }
+
+  std::size_t rank() const { return dims.size(); }
+
+  std::size_t numel() const {
+    std::size_t count = 1;
+    for (std::size_t d : dims) count *= d;
+    return count;
+  }
+
+  // Длина последней оси (длина строки Softmax)
+  std::size_t last_dim() const { return dims.empty() ? 1 : dims.back(); }
+
+  // Число строк: произведение всех ведущих осей
+  std::size_t rows() const {
+    std::size_t count = 1;
+    for (std::size_t i = 0; i + 1 < dims.size(); ++i) count *= dims[i];
+    return count;
+  }
+
+  // Последняя ось лежит в памяти непрерывно
+  bool last_axis_contiguous() const {
+    return dims.empty() || dims.back() <= 1 || strides.back() == 1;
+  }
+
+  // Ведущие оси сворачиваются в одну ось строк с постоянным шагом
+  bool rows_collapsible() const {
+    for (std::size_t i = 0; i + 2 < dims.size(); ++i) {
+      if (dims[i] > 1 && strides[i] != strides[i + 1] * dims[i + 1]) {
+        return false;
+      }
+    }
+    return last_axis_contiguous();
+  }
+
+  // Оси начиная с first лежат плотно (row-major без зазоров)
+  bool contiguous_from(std::size_t first) const {
+    std::size_t expected = 1;
+    for (std::size_t i = dims.size(); i-- > first;) {
+      if (dims[i] > 1 && strides[i] != expected) return false;
+      expected *= dims[i];
+    }
+    return true;
+  }
+
+  bool is_contiguous() const { return contiguous_from(0); }
+
+  // Шаг между соседними строками. Требует, чтобы последняя ось была
+  // непрерывной, а ведущие оси сворачивались в одну ось с постоянным шагом.
+  std::size_t row_stride() const {
+    if (dims.empty()) return 1;
+    if (!last_axis_contiguous()) {
+      throw std::invalid_argument("Last axis must be contiguous");
+    }
+    if (dims.size() == 1) return dims.back();
+    if (!rows_collapsible()) {
+      throw std::invalid_argument(
+          "Leading axes cannot be collapsed into rows without a copy");
+    }
+    return strides[dims.size() - 2];
+  }
+
+  // Смещение (в элементах) элемента с линейным индексом linear по первым
+  // count осям; остальные индексы равны нулю
+  std::size_t offset_of(std::size_t linear, std::size_t count) const {
+    std::size_t offset = 0;
+    for (std::size_t i = count; i-- > 0;) {
+      offset += (linear % dims[i]) * strides[i];
+      linear /= dims[i];
+    }
+    return offset;
+  }
+
+  // Количество элементов буфера, покрываемого тензором
+  std::size_t span() const {
+    if (numel() == 0) return 0;
+    std::size_t last = 0;
+    for (std::size_t i = 0; i < dims.size(); ++i) {
+      last += (dims[i] - 1) * strides[i];
+    }
+    return last + 1;
+  }
+};
+
+// Хранение 16-битных чисел с плавающей точкой; вычисления - во float
+struct Half {
+  std::uint16_t bits;  // IEEE 754 binary16
+};
+struct BFloat16 {
+  std::uint16_t bits;  // старшие 16 бит float
+};
+
+// Тип элементов тензора
+enum class DType { kFloat32, kFloat16, kBFloat16, kInt8, kUInt8, kInt32 };
+
+template <typename T>
+struct DTypeOf;
+template <>
+struct DTypeOf<float> {
+  static constexpr DType value = DType::kFloat32;
+};
+template <>
+struct DTypeOf<Half> {
+  static constexpr DType value = DType::kFloat16;
+};
+template <>
+struct DTypeOf<BFloat16> {
+  static constexpr DType value = DType::kBFloat16;
+};
+template <>
+struct DTypeOf<std::int8_t> {
+  static constexpr DType value = DType::kInt8;
+};
+template <>
+struct DTypeOf<std::uint8_t> {
+  static constexpr DType value = DType::kUInt8;
+};
+template <>
+struct DTypeOf<std::int32_t> {
+  static constexpr DType value = DType::kInt32;
+};
+
+/**
+ * @brief Невладеющее представление тензора: указатель, форма, шаги, тип
+ *
+ * @tparam T Тип элемента; const T - представление только для чтения.
+ * TensorView<T> неявно приводится к TensorView<const T>.
+ */
+template <typename T>
+struct TensorView {
+  static constexpr DType dtype = DTypeOf<std::remove_const_t<T>>::value;
+
+  T* data = nullptr;
+  TensorShape shape;
+
+  TensorView() = default;
+  TensorView(T* data_, TensorShape shape_)
+      : data(data_), shape(std::move(shape_)) {}
+
+  template <typename U, typename = std::enable_if_t<
+                            std::is_same_v<const U, T> &&
+                            !std::is_same_v<U, T>>>
+  TensorView(const TensorView<U>& other)
+      : data(other.data), shape(other.shape) {}
+
+  std::size_t rank() const { return shape.rank(); }
+  std::size_t numel() const { return shape.numel(); }
+
+  // Подтензор [begin, end) по оси axis: те же шаги, сдвинутый указатель
+  TensorView slice(std::size_t axis, std::size_t begin,
+                   std::size_t end) const {
+    if (axis >= rank() || begin > end || end > shape.dims[axis]) {
+      throw std::out_of_range("Tensor slice is out of bounds");
+    }
+    TensorView view = *this;
+    view.data = data + begin * shape.strides[axis];
+    view.shape.dims[axis] = end - begin;
+    return view;
+  }
+};
+
+// Плотное представление содержимого std::vector
+template <typename T>
+TensorView<T> make_view(std::vector<T>& values, TensorShape shape) {
+  if (values.size() < shape.span()) {
+    throw std::invalid_argument("Buffer of " + std::to_string(values.size()) +
+                                " elements is too small for the tensor");
+  }
+  return TensorView<T>(values.data(), std::move(shape));
+}
+
+template <typename T>
+TensorView<const T> make_view(const std::vector<T>& values,
+                              TensorShape shape) {
+  if (values.size() < shape.span()) {
+    throw std::invalid_argument("Buffer of " + std::to_string(values.size()) +
+                                " elements is too small for the tensor");
+  }
+  return TensorView<const T>(values.data(), std::move(shape));
+}
+
+#endif  // !TENSOR_H
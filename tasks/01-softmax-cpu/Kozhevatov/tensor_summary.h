@@ -0,0 +1,542 @@
+/**
+ * @file tensor_summary.h
+ * @brief Сводка большого тензора вместо печати каждого элемента
+ *
+ * Печать 2048×2048 значений через std::cout и setw занимает минуты и
+ * нечитаема. Сводка - min/max/mean/std по конечным значениям, число NaN и
+ * ±Inf, гистограмма, top-k по модулю и выборка элементов (начало, равномерно
+ * по середине, конец) - считается за два параллельных AVX2 прохода:
+ * первый копит min/max/сумму и маски неконечных значений, второй - сумму
+ * квадратов отклонений, гистограмму и top-k. Top-k отбирается сравнением
+ * вектора с порогом потока; в скалярную кучу попадают только кандидаты.
+ * Типы - все из DType: float, Half, BFloat16, int8, uint8, int32 (значения
+ * расширяются до float в регистрах; int32 больше 2^24 округляются).
+ * Суммы и квадраты отклонений копятся в double: значения порядка FLT_MAX
+ * (маски -FLT_MAX, обрезка +FLT_MAX) переполняют float-сумму блока.
+ */
+
+#ifndef TENSOR_SUMMARY_H
+#define TENSOR_SUMMARY_H
+
+#include <immintrin.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "simd_utils.h"
+#include "softmax_half.h"
+#include "softmax_kernels.h"
+#include "tensor.h"
+
+// Элементов в блоке, который поток обрабатывает за раз
+constexpr std::size_t kSummaryBlock = 4096;
+
+// Загрузка 8 элементов и скалярное преобразование в float; float, Half и
+// BFloat16 - как при хранении Softmax
+template <typename T>
+struct SummaryTraits : StorageTraits<T> {};
+
+template <>
+struct SummaryTraits<std::int8_t> {
+  static __m256 load(const std::int8_t* src) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+  }
+  static float to_float(std::int8_t x) { return x; }
+};
+
+template <>
+struct SummaryTraits<std::uint8_t> {
+  static __m256 load(const std::uint8_t* src) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+  }
+  static float to_float(std::uint8_t x) { return x; }
+};
+
+template <>
+struct SummaryTraits<std::int32_t> {
+  static __m256 load(const std::int32_t* src) {
+    return _mm256_cvtepi32_ps(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+  }
+  static float to_float(std::int32_t x) { return static_cast<float>(x); }
+};
+
+// Параметры сводки
+struct SummaryOptions {
+  std::size_t bins = 10;    // столбцов гистограммы
+  std::size_t top_k = 5;    // значений с наибольшим модулем
+  std::size_t edge = 3;     // элементов в начале и в конце выборки
+  std::size_t samples = 4;  // элементов, равномерно взятых из середины
+};
+
+// Сводка тензора; статистики - только по конечным значениям
+struct TensorSummary {
+  DType dtype = DType::kFloat32;
+  std::size_t count = 0;
+  std::size_t finite = 0;
+  std::size_t nan = 0;
+  std::size_t pos_inf = 0;
+  std::size_t neg_inf = 0;
+  float min = 0.0f;
+  float max = 0.0f;
+  double mean = 0.0;
+  double stddev = 0.0;  // по всей совокупности (делитель finite)
+  std::vector<std::size_t> histogram;  // равные столбцы на [min, max]
+  std::vector<std::pair<std::size_t, float>> top_abs;  // (индекс, значение)
+  std::vector<std::pair<std::size_t, float>> samples;  // по возрастанию
+};
+
+// Частичные результаты одного потока
+struct SummaryPartial {
+  using Candidate = std::pair<float, std::size_t>;  // (|x|, индекс)
+
+  std::size_t finite = 0;
+  std::size_t nan = 0;
+  std::size_t pos_inf = 0;
+  float min = std::numeric_limits<float>::infinity();
+  float max = -std::numeric_limits<float>::infinity();
+  double sum = 0.0;
+  double squares = 0.0;
+  std::vector<std::size_t> histogram;
+  std::vector<Candidate> top;  // куча с худшим кандидатом в вершине
+
+  // Порог входа в top-k: пока куча не полна - любой |x|
+  float top_threshold(std::size_t k) const {
+    if (top.size() < k) return -1.0f;
+    return k == 0 ? std::numeric_limits<float>::infinity() : top.front().first;
+  }
+
+  // Больший модуль, при равенстве - меньший индекс
+  static bool better(const Candidate& a, const Candidate& b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  }
+
+  void offer(float magnitude, std::size_t index, std::size_t k) {
+    const Candidate candidate(magnitude, index);
+    if (top.size() < k) {
+      top.push_back(candidate);
+      std::push_heap(top.begin(), top.end(), better);
+    } else if (k > 0 && better(candidate, top.front())) {
+      std::pop_heap(top.begin(), top.end(), better);
+      top.back() = candidate;
+      std::push_heap(top.begin(), top.end(), better);
+    }
+  }
+};
+
+namespace summary {
+
+// Число установленных дорожек в маске movemask
+inline std::size_t count_lanes(int bits) {
+  return std::bitset<8>(bits).count();
+}
+
+/**
+ * @brief Столбец гистограммы для конечного x
+ *
+ * Если max - min переполняет float (значения около ±FLT_MAX), оба операнда
+ * сначала делятся пополам: разность половин конечна. Индекс обрезается до
+ * [0, bins - 1] ещё во float, поэтому NaN (0 * inf при вырожденном
+ * масштабе) и бесконечность не дают индекс вне гистограммы. Векторный
+ * путь повторяет те же операции.
+ */
+struct HistogramScale {
+  float pre = 1.0f;     // 1 или 0.5, если разность переполняется
+  float offset = 0.0f;  // min * pre
+  float scale = 0.0f;   // bins / (max * pre - min * pre)
+  float last = 0.0f;    // bins - 1
+
+  HistogramScale(float min, float max, std::size_t bins)
+      : pre(std::isinf(max - min) ? 0.5f : 1.0f),
+        offset(min * pre),
+        last(static_cast<float>(bins - 1)) {
+    const float range = max * pre - offset;
+    scale = range > 0.0f ? bins / range : 0.0f;
+  }
+
+  std::size_t bin(float x) const {
+    float t = (x * pre - offset) * scale;
+    t = t > 0.0f ? t : 0.0f;
+    t = t < last ? t : last;
+    return static_cast<std::size_t>(t);
+  }
+
+  __m256i bin(__m256 x) const {
+    const __m256 t = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_mul_ps(x, _mm256_set1_ps(pre)),
+                      _mm256_set1_ps(offset)),
+        _mm256_set1_ps(scale));
+    // max/min_ps возвращают второй операнд при NaN - как скалярный путь
+    return _mm256_cvttps_epi32(_mm256_min_ps(
+        _mm256_max_ps(t, _mm256_setzero_ps()), _mm256_set1_ps(last)));
+  }
+};
+
+// Прибавление 8 float к суммам в двух векторах double
+inline void add_widened(__m256 x, __m256d& lo, __m256d& hi) {
+  lo = _mm256_add_pd(lo, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+  hi = _mm256_add_pd(hi, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+}
+
+// Прибавление (x - mean)^2 в double для дорожек маски keep
+inline void add_squared_deviation(__m256 x, __m256 keep, __m256d mean,
+                                  __m256d& lo, __m256d& hi) {
+  const __m256i mask = _mm256_castps_si256(keep);
+  const __m256d keep_lo = _mm256_castsi256_pd(
+      _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask)));
+  const __m256d keep_hi = _mm256_castsi256_pd(
+      _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1)));
+  const __m256d d_lo = _mm256_and_pd(
+      _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), mean),
+      keep_lo);
+  const __m256d d_hi = _mm256_and_pd(
+      _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), mean),
+      keep_hi);
+  lo = _mm256_add_pd(lo, _mm256_mul_pd(d_lo, d_lo));
+  hi = _mm256_add_pd(hi, _mm256_mul_pd(d_hi, d_hi));
+}
+
+// Сумма двух векторов double
+inline double hsum_widened(__m256d lo, __m256d hi) {
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, _mm256_add_pd(lo, hi));
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// Первый проход по [begin, end): min, max, сумма, NaN и +Inf
+template <typename T>
+inline void accumulate_moments(const T* data, std::size_t begin,
+                               std::size_t end, bool simd,
+                               SummaryPartial& part) {
+  using Traits = SummaryTraits<T>;
+  constexpr bool kIntegral = std::is_integral_v<T>;
+  std::size_t i = begin;
+  if (simd) {
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 vmin = inf;
+    __m256 vmax = _mm256_sub_ps(_mm256_setzero_ps(), inf);
+    __m256d sum_lo = _mm256_setzero_pd(), sum_hi = _mm256_setzero_pd();
+    for (; i + 8 <= end; i += 8) {
+      __m256 x = Traits::load(data + i);
+      if constexpr (!kIntegral) {
+        const __m256 finite =
+            _mm256_cmp_ps(_mm256_andnot_ps(sign, x), inf, _CMP_LT_OQ);
+        const int finite_bits = _mm256_movemask_ps(finite);
+        if (finite_bits != 0xFF) {
+          const __m256 is_nan = _mm256_cmp_ps(x, x, _CMP_UNORD_Q);
+          const __m256 is_pos_inf = _mm256_cmp_ps(x, inf, _CMP_EQ_OQ);
+          part.nan += count_lanes(_mm256_movemask_ps(is_nan));
+          part.pos_inf += count_lanes(_mm256_movemask_ps(is_pos_inf));
+          part.finite += count_lanes(finite_bits);
+          // Неконечные дорожки: ноль в сумме, ±inf не сдвигают min/max
+          x = _mm256_and_ps(x, finite);
+          vmin = _mm256_min_ps(vmin, _mm256_blendv_ps(inf, x, finite));
+          vmax = _mm256_max_ps(
+              vmax, _mm256_blendv_ps(_mm256_sub_ps(_mm256_setzero_ps(), inf),
+                                     x, finite));
+          add_widened(x, sum_lo, sum_hi);
+          continue;
+        }
+      }
+      part.finite += 8;
+      vmin = _mm256_min_ps(vmin, x);
+      vmax = _mm256_max_ps(vmax, x);
+      add_widened(x, sum_lo, sum_hi);
+    }
+    part.min = std::min(part.min, -hmax256_ps(_mm256_xor_ps(vmin, sign)));
+    part.max = std::max(part.max, hmax256_ps(vmax));
+    part.sum += hsum_widened(sum_lo, sum_hi);
+  }
+  double sum = 0.0;
+  for (; i < end; ++i) {
+    const float x = Traits::to_float(data[i]);
+    if (std::isfinite(x)) {
+      ++part.finite;
+      part.min = std::min(part.min, x);
+      part.max = std::max(part.max, x);
+      sum += x;
+    } else if (x != x) {
+      ++part.nan;
+    } else if (x > 0.0f) {
+      ++part.pos_inf;
+    }
+  }
+  part.sum += sum;
+}
+
+// Второй проход по [begin, end): отклонения от mean, гистограмма, top-k
+template <typename T>
+inline void accumulate_spread(const T* data, std::size_t begin,
+                              std::size_t end, bool simd, double mean,
+                              const HistogramScale& histogram,
+                              std::size_t top_k, SummaryPartial& part) {
+  using Traits = SummaryTraits<T>;
+  std::size_t i = begin;
+  if (simd) {
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256d vmean = _mm256_set1_pd(mean);
+    __m256 threshold = _mm256_set1_ps(part.top_threshold(top_k));
+    __m256d squares_lo = _mm256_setzero_pd(), squares_hi = _mm256_setzero_pd();
+    alignas(32) std::int32_t bin[8];
+    for (; i + 8 <= end; i += 8) {
+      const __m256 x = Traits::load(data + i);
+      const __m256 magnitude = _mm256_andnot_ps(sign, x);
+      const __m256 finite = _mm256_cmp_ps(magnitude, inf, _CMP_LT_OQ);
+      const int finite_bits = _mm256_movemask_ps(finite);
+
+      add_squared_deviation(x, finite, vmean, squares_lo, squares_hi);
+
+      // Индекс неконечных дорожек тоже в пределах, но не учитывается
+      _mm256_store_si256(reinterpret_cast<__m256i*>(bin), histogram.bin(x));
+      if (finite_bits == 0xFF) {
+        for (int k = 0; k < 8; ++k) ++part.histogram[bin[k]];
+      } else {
+        for (int k = 0; k < 8; ++k) {
+          if (finite_bits >> k & 1) ++part.histogram[bin[k]];
+        }
+      }
+
+      const int candidates = _mm256_movemask_ps(
+          _mm256_and_ps(_mm256_cmp_ps(magnitude, threshold, _CMP_GT_OQ),
+                        finite));
+      if (candidates == 0) continue;
+      alignas(32) float values[8];
+      _mm256_store_ps(values, magnitude);
+      for (int k = 0; k < 8; ++k) {
+        if (candidates >> k & 1) part.offer(values[k], i + k, top_k);
+      }
+      threshold = _mm256_set1_ps(part.top_threshold(top_k));
+    }
+    part.squares += hsum_widened(squares_lo, squares_hi);
+  }
+  double squares = 0.0;
+  for (; i < end; ++i) {
+    const float x = Traits::to_float(data[i]);
+    if (!std::isfinite(x)) continue;
+    const double d = x - mean;
+    squares += d * d;
+    ++part.histogram[histogram.bin(x)];
+    part.offer(std::abs(x), i, top_k);
+  }
+  part.squares += squares;
+}
+
+// Номера элементов выборки: начало, равномерно по середине, конец
+inline std::vector<std::size_t> sample_indices(std::size_t count,
+                                               const SummaryOptions& options) {
+  std::vector<std::size_t> indices;
+  for (std::size_t i = 0; i < std::min(options.edge, count); ++i) {
+    indices.push_back(i);
+    indices.push_back(count - 1 - i);
+  }
+  for (std::size_t s = 1; s <= options.samples && count > 0; ++s) {
+    indices.push_back(count * s / (options.samples + 1));
+  }
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  return indices;
+}
+
+}  // namespace summary
+
+/**
+ * @brief Сводка count элементов data
+ *
+ * @param method Векторный проход (kSimd, kOpenMPSimd) и распределение
+ * блоков между потоками (kOpenMP, kOpenMPSimd); результат не зависит от
+ * метода, кроме последних знаков mean и stddev
+ */
+template <typename T>
+inline TensorSummary summarize_tensor(
+    const T* data, std::size_t count, const SummaryOptions& options = {},
+    SoftmaxMethod method = SoftmaxMethod::kOpenMPSimd) {
+  if (options.bins == 0) {
+    throw std::invalid_argument("Histogram needs at least one bin");
+  }
+  const bool simd = method == SoftmaxMethod::kSimd ||
+                    method == SoftmaxMethod::kOpenMPSimd;
+  const bool parallel = method == SoftmaxMethod::kOpenMP ||
+                        method == SoftmaxMethod::kOpenMPSimd;
+  const std::size_t blocks = (count + kSummaryBlock - 1) / kSummaryBlock;
+
+  TensorSummary summary;
+  summary.dtype = DTypeOf<T>::value;
+  summary.count = count;
+  summary.histogram.assign(options.bins, 0);
+
+  SummaryPartial total;
+#pragma omp parallel if (parallel)
+  {
+    SummaryPartial part;
+#pragma omp for
+    for (std::size_t b = 0; b < blocks; ++b) {
+      summary::accumulate_moments(
+          data, b * kSummaryBlock,
+          std::min(count, (b + 1) * kSummaryBlock), simd, part);
+    }
+#pragma omp critical
+    {
+      total.finite += part.finite;
+      total.nan += part.nan;
+      total.pos_inf += part.pos_inf;
+      total.min = std::min(total.min, part.min);
+      total.max = std::max(total.max, part.max);
+      total.sum += part.sum;
+    }
+  }
+  summary.finite = total.finite;
+  summary.nan = total.nan;
+  summary.pos_inf = total.pos_inf;
+  summary.neg_inf = count - total.finite - total.nan - total.pos_inf;
+  if (total.finite > 0) {
+    summary.min = total.min;
+    summary.max = total.max;
+    summary.mean = total.sum / total.finite;
+  }
+
+  // Второй проход нужен, только если есть конечные значения
+  if (total.finite > 0) {
+    const summary::HistogramScale histogram(summary.min, summary.max,
+                                            options.bins);
+#pragma omp parallel if (parallel)
+    {
+      SummaryPartial part;
+      part.histogram.assign(options.bins, 0);
+#pragma omp for
+      for (std::size_t b = 0; b < blocks; ++b) {
+        summary::accumulate_spread(
+            data, b * kSummaryBlock,
+            std::min(count, (b + 1) * kSummaryBlock), simd, summary.mean,
+            histogram, options.top_k, part);
+      }
+#pragma omp critical
+      {
+        total.squares += part.squares;
+        for (std::size_t k = 0; k < options.bins; ++k) {
+          summary.histogram[k] += part.histogram[k];
+        }
+        for (const auto& [magnitude, index] : part.top) {
+          total.offer(magnitude, index, options.top_k);
+        }
+      }
+    }
+    summary.stddev = std::sqrt(total.squares / total.finite);
+
+    // По убыванию модуля, при равенстве - по индексу
+    std::sort(total.top.begin(), total.top.end(), SummaryPartial::better);
+    for (const auto& candidate : total.top) {
+      summary.top_abs.emplace_back(
+          candidate.second,
+          SummaryTraits<T>::to_float(data[candidate.second]));
+    }
+  }
+
+  for (std::size_t index : summary::sample_indices(count, options)) {
+    summary.samples.emplace_back(index,
+                                 SummaryTraits<T>::to_float(data[index]));
+  }
+  return summary;
+}
+
+// Сводка плотного тензора, заданного представлением
+template <typename T>
+inline TensorSummary summarize_tensor(
+    TensorView<const T> view, const SummaryOptions& options = {},
+    SoftmaxMethod method = SoftmaxMethod::kOpenMPSimd) {
+  if (!view.shape.is_contiguous()) {
+    throw std::invalid_argument("Tensor summary needs a contiguous tensor");
+  }
+  return summarize_tensor(view.data, view.numel(), options, method);
+}
+
+// Сводка буфера, тип которого известен только во время выполнения
+inline TensorSummary summarize_tensor(
+    const void* data, std::size_t count, DType dtype,
+    const SummaryOptions& options = {},
+    SoftmaxMethod method = SoftmaxMethod::kOpenMPSimd) {
+  switch (dtype) {
+    case DType::kFloat32:
+      return summarize_tensor(static_cast<const float*>(data), count, options,
+                              method);
+    case DType::kFloat16:
+      return summarize_tensor(static_cast<const Half*>(data), count, options,
+                              method);
+    case DType::kBFloat16:
+      return summarize_tensor(static_cast<const BFloat16*>(data), count,
+                              options, method);
+    case DType::kInt8:
+      return summarize_tensor(static_cast<const std::int8_t*>(data), count,
+                              options, method);
+    case DType::kUInt8:
+      return summarize_tensor(static_cast<const std::uint8_t*>(data), count,
+                              options, method);
+    case DType::kInt32:
+      return summarize_tensor(static_cast<const std::int32_t*>(data), count,
+                              options, method);
+  }
+  throw std::invalid_argument("Unknown tensor element type");
+}
+
+// Название типа элементов
+inline const char* dtype_name(DType dtype) {
+  switch (dtype) {
+    case DType::kFloat32:
+      return "float32";
+    case DType::kFloat16:
+      return "float16";
+    case DType::kBFloat16:
+      return "bfloat16";
+    case DType::kInt8:
+      return "int8";
+    case DType::kUInt8:
+      return "uint8";
+    case DType::kInt32:
+      return "int32";
+  }
+  return "unknown";
+}
+
+// Сводка текстом в несколько строк вместо печати всех элементов
+inline std::string format_summary(const TensorSummary& summary) {
+  std::ostringstream out;
+  out << std::setprecision(6);
+  out << dtype_name(summary.dtype) << "[" << summary.count << "]: min "
+      << summary.min << ", max " << summary.max << ", mean " << summary.mean
+      << ", std " << summary.stddev << "\n";
+  out << "  finite " << summary.finite << ", NaN " << summary.nan << ", +Inf "
+      << summary.pos_inf << ", -Inf " << summary.neg_inf << "\n";
+  out << "  histogram [" << summary.min << ", " << summary.max << "]:";
+  for (std::size_t bin : summary.histogram) out << " " << bin;
+  out << "\n  top |x|:";
+  for (const auto& [index, value] : summary.top_abs) {
+    out << " [" << index << "]=" << value;
+  }
+  out << "\n  values:";
+  std::size_t next = 0;  // индекс после последнего выведенного
+  for (const auto& [index, value] : summary.samples) {
+    if (index > next) out << " ...";
+    out << " [" << index << "]=" << value;
+    next = index + 1;
+  }
+  if (next < summary.count) out << " ...";
+  out << "\n";
+  return out.str();
+}
+
+#endif  // !TENSOR_SUMMARY_H